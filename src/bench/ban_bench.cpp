@@ -0,0 +1,108 @@
+/**
+ * Offline benchmark of the ban index - loading of ban.txt and lookups of HWIDs on connect.
+ * It links the same code as the server (ban_index.cpp), and compares it with the engine that parses whole ban.txt on every connect.
+ *
+ * Usage:
+ *   ban_bench [options]
+ *
+ * Options:
+ *   -count <n>                 number of lines of generated ban.txt and number of lookups (default 1000000)
+ *   -scans <n>                 number of full scans of ban.txt as done by the engine (default 10)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bench.h"
+#include "ban_index.h"
+
+static void bench_printUsage() {
+    printf("Usage:\n");
+    printf("  ban_bench [-count <n>] [-scans <n>]\n");
+}
+
+
+int main(int argc, char** argv) {
+
+    int count = 1000000;
+    int scans = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-count") == 0 && i + 1 < argc && bench_parseCount(argv[i + 1], &count)) {
+            i++;
+        } else if (strcmp(argv[i], "-scans") == 0 && i + 1 < argc && bench_parseCount(argv[i + 1], &scans)) {
+            i++;
+        } else {
+            bench_printUsage();
+            return 1;
+        }
+    }
+
+    uint32_t seed = BENCH_SEED;
+
+    // ban.txt with given number of lines in the engine format
+    size_t size = (size_t)count * 32 + 1;
+    char* text = (char*)malloc(size);
+    int* hwids = (int*)malloc(count * sizeof(int));
+    if (text == NULL || hwids == NULL) {
+        fprintf(stderr, "Failed to allocate ban.txt with %i lines\n", count);
+        return 1;
+    }
+    size_t len = 0;
+    for (int n = 0; n < count; n++) {
+        hwids[n] = (int)(bench_xorshift(&seed) & 0x7fffffff);
+        len += snprintf(text + len, size - len, "%i Player%i\n", hwids[n], n);
+    }
+
+    banTable_t table;
+    memset(&table, 0, sizeof(table));
+
+    uint64_t start = bench_ticks_ns();
+    ban_parseFile(&table, text);
+    uint64_t parse = bench_ticks_ns() - start;
+
+    int found = 0;
+    start = bench_ticks_ns();
+    for (int n = 0; n < count; n++) {
+        if (ban_tableFind(&table, hwids[bench_xorshift(&seed) % count]) != NULL)
+            found++;
+    }
+    uint64_t hit = bench_ticks_ns() - start;
+
+    // Negative HWIDs are never generated, so the lookups miss
+    start = bench_ticks_ns();
+    for (int n = 0; n < count; n++) {
+        if (ban_tableFind(&table, (int)(bench_xorshift(&seed) | 0x80000000)) != NULL)
+            found++;
+    }
+    uint64_t miss = bench_ticks_ns() - start;
+
+    // Engine parses the whole file on every connect
+    start = bench_ticks_ns();
+    for (int n = 0; n < scans; n++) {
+        int hwid = (int)(bench_xorshift(&seed) | 0x80000000);
+        for (const char* line = text; *line; ) {
+            char* end;
+            if (strtol(line, &end, 10) == hwid)
+                found++;
+            const char* next = strchr(end, '\n');
+            line = next ? next + 1 : end + strlen(end);
+        }
+    }
+    uint64_t scan = bench_ticks_ns() - start;
+
+    printf("Ban index with %u entries, capacity %u (%u KB)\n", table.count, table.capacity, (unsigned)(table.capacity * sizeof(banEntry_t) / 1024));
+    printf("  load ban.txt:   %.2f ms\n", parse / 1e6);
+    printf("  lookup hit:     %.1f ns\n", (double)hit / count);
+    printf("  lookup miss:    %.1f ns\n", (double)miss / count);
+    printf("  file scan:      %.2f ms per connect\n", scan / 1e6 / scans);
+    printf("  found:          %i of %i\n", found, count);
+
+    ban_tableFree(&table);
+    free(text);
+    free(hwids);
+
+    return 0;
+}
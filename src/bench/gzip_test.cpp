@@ -0,0 +1,489 @@
+/**
+ * Offline test of gzip.cpp - compression of request bodies and streaming decompression of responses.
+ * It links the same code as the game (gzip.cpp) and checks:
+ *   - vectors compressed by zlib in gzip, zlib and raw deflate format with stored, fixed and dynamic blocks
+ *   - round trip of gzip_compress with all levels
+ *   - input written in chunks of any size
+ *   - truncated streams are never done, corrupted streams are never done with wrong data
+ *   - incomplete and over-subscribed Huffman codes and the limit of decoded size
+ * When CMake finds zlib, the output of gzip_compress is also decoded by zlib and data compressed by zlib
+ * with all levels and strategies is decoded by GzipDecoder.
+ *
+ * Usage:
+ *   gzip_test
+ *
+ * Returns 0 when all checks passed, it is registered to CTest.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#if GZIP_TEST_ZLIB
+    #include <zlib.h>
+#endif
+
+#include "bench.h"
+#include "gzip.h"
+
+// Vectors compressed by zlib 1.2.13 (Python), the gzip vector has the file name set in the header
+static const char test_text[] =
+    "{\"round\":1,\"players\":[{\"name\":\"player0\",\"kills\":0,\"deaths\":5},{\"name\":\"player1\",\"kills\":7,\"deaths\":5"
+    "},{\"name\":\"player2\",\"kills\":1,\"deaths\":5},{\"name\":\"player3\",\"kills\":8,\"deaths\":5},{\"name\":\"player4\","
+    "\"kills\":2,\"deaths\":5},{\"name\":\"player5\",\"kills\":9,\"deaths\":5},{\"name\":\"player6\",\"kills\":3,\"deaths\":5"
+    "},{\"name\":\"player7\",\"kills\":10,\"deaths\":5},{\"name\":\"player8\",\"kills\":4,\"deaths\":5},{\"name\":\"player9\""
+    ",\"kills\":11,\"deaths\":5},{\"name\":\"player10\",\"kills\":5,\"deaths\":5},{\"name\":\"player11\",\"kills\":12,\"deat"
+    "hs\":5}]}";
+
+static const uint8_t test_gzip_dynamic[] = {
+    0x1f, 0x8b, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0x72, 0x6f, 0x75, 0x6e, 0x64, 0x2e,
+    0x6a, 0x73, 0x6f, 0x6e, 0x00, 0x7d, 0xd1, 0x4d, 0x0a, 0x83, 0x40, 0x0c, 0x05, 0xe0, 0xbb, 0xbc,
+    0xf5, 0x2c, 0x8c, 0x3a, 0xfe, 0xcc, 0x55, 0xc4, 0xc5, 0x80, 0x03, 0x4a, 0xa7, 0xb6, 0xd8, 0xba,
+    0x10, 0xf1, 0xee, 0xba, 0x28, 0x64, 0xea, 0xe2, 0xed, 0x42, 0xf2, 0x11, 0xc8, 0xcb, 0x8e, 0xe5,
+    0xb5, 0xce, 0x03, 0x9c, 0x18, 0xbc, 0xa3, 0xdf, 0xc2, 0xf2, 0x81, 0xeb, 0x76, 0xcc, 0xfe, 0x19,
+    0xe0, 0x7e, 0xad, 0x0c, 0x06, 0x8f, 0x29, 0xc6, 0x6b, 0x94, 0x19, 0x0c, 0xc1, 0x7f, 0xc7, 0xab,
+    0xb4, 0x87, 0xb9, 0x39, 0x51, 0x57, 0x33, 0x97, 0xab, 0x13, 0xe6, 0x0a, 0x75, 0x0d, 0x73, 0xa5,
+    0xba, 0x9c, 0x39, 0xab, 0xae, 0x65, 0xae, 0x52, 0x57, 0x30, 0x57, 0x27, 0x77, 0xd0, 0x60, 0x1a,
+    0x85, 0x25, 0x73, 0x6d, 0xb2, 0x90, 0x26, 0x23, 0xc9, 0x4b, 0x2c, 0x85, 0xc9, 0x4f, 0xe4, 0x2f,
+    0x9c, 0xfe, 0x38, 0x01, 0xcd, 0xa8, 0xdc, 0x6f, 0xfc, 0x01, 0x00, 0x00,
+};
+
+static const uint8_t test_zlib_dynamic[] = {
+    0x78, 0xda, 0x7d, 0xd1, 0x4d, 0x0a, 0x83, 0x40, 0x0c, 0x05, 0xe0, 0xbb, 0xbc, 0xf5, 0x2c, 0x8c,
+    0x3a, 0xfe, 0xcc, 0x55, 0xc4, 0xc5, 0x80, 0x03, 0x4a, 0xa7, 0xb6, 0xd8, 0xba, 0x10, 0xf1, 0xee,
+    0xba, 0x28, 0x64, 0xea, 0xe2, 0xed, 0x42, 0xf2, 0x11, 0xc8, 0xcb, 0x8e, 0xe5, 0xb5, 0xce, 0x03,
+    0x9c, 0x18, 0xbc, 0xa3, 0xdf, 0xc2, 0xf2, 0x81, 0xeb, 0x76, 0xcc, 0xfe, 0x19, 0xe0, 0x7e, 0xad,
+    0x0c, 0x06, 0x8f, 0x29, 0xc6, 0x6b, 0x94, 0x19, 0x0c, 0xc1, 0x7f, 0xc7, 0xab, 0xb4, 0x87, 0xb9,
+    0x39, 0x51, 0x57, 0x33, 0x97, 0xab, 0x13, 0xe6, 0x0a, 0x75, 0x0d, 0x73, 0xa5, 0xba, 0x9c, 0x39,
+    0xab, 0xae, 0x65, 0xae, 0x52, 0x57, 0x30, 0x57, 0x27, 0x77, 0xd0, 0x60, 0x1a, 0x85, 0x25, 0x73,
+    0x6d, 0xb2, 0x90, 0x26, 0x23, 0xc9, 0x4b, 0x2c, 0x85, 0xc9, 0x4f, 0xe4, 0x2f, 0x9c, 0xfe, 0x38,
+    0x01, 0x21, 0xd7, 0xa0, 0x4f,
+};
+
+static const uint8_t test_raw_dynamic[] = {
+    0x7d, 0xd1, 0x4d, 0x0a, 0x83, 0x40, 0x0c, 0x05, 0xe0, 0xbb, 0xbc, 0xf5, 0x2c, 0x8c, 0x3a, 0xfe,
+    0xcc, 0x55, 0xc4, 0xc5, 0x80, 0x03, 0x4a, 0xa7, 0xb6, 0xd8, 0xba, 0x10, 0xf1, 0xee, 0xba, 0x28,
+    0x64, 0xea, 0xe2, 0xed, 0x42, 0xf2, 0x11, 0xc8, 0xcb, 0x8e, 0xe5, 0xb5, 0xce, 0x03, 0x9c, 0x18,
+    0xbc, 0xa3, 0xdf, 0xc2, 0xf2, 0x81, 0xeb, 0x76, 0xcc, 0xfe, 0x19, 0xe0, 0x7e, 0xad, 0x0c, 0x06,
+    0x8f, 0x29, 0xc6, 0x6b, 0x94, 0x19, 0x0c, 0xc1, 0x7f, 0xc7, 0xab, 0xb4, 0x87, 0xb9, 0x39, 0x51,
+    0x57, 0x33, 0x97, 0xab, 0x13, 0xe6, 0x0a, 0x75, 0x0d, 0x73, 0xa5, 0xba, 0x9c, 0x39, 0xab, 0xae,
+    0x65, 0xae, 0x52, 0x57, 0x30, 0x57, 0x27, 0x77, 0xd0, 0x60, 0x1a, 0x85, 0x25, 0x73, 0x6d, 0xb2,
+    0x90, 0x26, 0x23, 0xc9, 0x4b, 0x2c, 0x85, 0xc9, 0x4f, 0xe4, 0x2f, 0x9c, 0xfe, 0x38, 0x01,
+};
+
+static const uint8_t test_zlib_stored[] = {
+    0x78, 0x01, 0x01, 0xfc, 0x01, 0x03, 0xfe, 0x7b, 0x22, 0x72, 0x6f, 0x75, 0x6e, 0x64, 0x22, 0x3a,
+    0x31, 0x2c, 0x22, 0x70, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x73, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x6e,
+    0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x30, 0x22, 0x2c, 0x22,
+    0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73,
+    0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22, 0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c,
+    0x61, 0x79, 0x65, 0x72, 0x31, 0x22, 0x2c, 0x22, 0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x37,
+    0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73, 0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22, 0x6e,
+    0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x32, 0x22, 0x2c, 0x22,
+    0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73,
+    0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22, 0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c,
+    0x61, 0x79, 0x65, 0x72, 0x33, 0x22, 0x2c, 0x22, 0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x38,
+    0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73, 0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22, 0x6e,
+    0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x34, 0x22, 0x2c, 0x22,
+    0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x32, 0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73,
+    0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22, 0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c,
+    0x61, 0x79, 0x65, 0x72, 0x35, 0x22, 0x2c, 0x22, 0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x39,
+    0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73, 0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22, 0x6e,
+    0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x36, 0x22, 0x2c, 0x22,
+    0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x33, 0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73,
+    0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22, 0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c,
+    0x61, 0x79, 0x65, 0x72, 0x37, 0x22, 0x2c, 0x22, 0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x31,
+    0x30, 0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73, 0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22,
+    0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x38, 0x22, 0x2c,
+    0x22, 0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x34, 0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68,
+    0x73, 0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22, 0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70,
+    0x6c, 0x61, 0x79, 0x65, 0x72, 0x39, 0x22, 0x2c, 0x22, 0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a,
+    0x31, 0x31, 0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73, 0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b,
+    0x22, 0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x70, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x31, 0x30,
+    0x22, 0x2c, 0x22, 0x6b, 0x69, 0x6c, 0x6c, 0x73, 0x22, 0x3a, 0x35, 0x2c, 0x22, 0x64, 0x65, 0x61,
+    0x74, 0x68, 0x73, 0x22, 0x3a, 0x35, 0x7d, 0x2c, 0x7b, 0x22, 0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a,
+    0x22, 0x70, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x31, 0x31, 0x22, 0x2c, 0x22, 0x6b, 0x69, 0x6c, 0x6c,
+    0x73, 0x22, 0x3a, 0x31, 0x32, 0x2c, 0x22, 0x64, 0x65, 0x61, 0x74, 0x68, 0x73, 0x22, 0x3a, 0x35,
+    0x7d, 0x5d, 0x7d, 0x21, 0xd7, 0xa0, 0x4f,
+};
+
+static const uint8_t test_raw_fixed[] = {
+    0xab, 0x56, 0x2a, 0xca, 0x2f, 0xcd, 0x4b, 0x51, 0xb2, 0x32, 0xd4, 0x51, 0x2a, 0xc8, 0x49, 0xac,
+    0x4c, 0x2d, 0x2a, 0x56, 0xb2, 0x8a, 0xae, 0x56, 0xca, 0x4b, 0xcc, 0x4d, 0x55, 0xb2, 0x82, 0x0a,
+    0x19, 0x28, 0xe9, 0x28, 0x65, 0x67, 0xe6, 0xe4, 0x00, 0xa5, 0x0c, 0x74, 0x94, 0x52, 0x52, 0x13,
+    0x4b, 0x32, 0x80, 0x4c, 0xd3, 0x5a, 0x1d, 0x34, 0x75, 0x86, 0x08, 0x75, 0xe6, 0xf8, 0xd4, 0x19,
+    0x21, 0xd4, 0x19, 0xe2, 0x53, 0x67, 0x8c, 0x50, 0x67, 0x81, 0x4f, 0x9d, 0x09, 0x42, 0x9d, 0x11,
+    0x3e, 0x75, 0xa6, 0x08, 0x75, 0x96, 0xf8, 0xd4, 0x99, 0x21, 0xd4, 0x19, 0xe3, 0x53, 0x67, 0x8e,
+    0xe4, 0x0f, 0xbc, 0x01, 0x63, 0x81, 0x50, 0x68, 0x82, 0x4f, 0x9d, 0x25, 0x92, 0x81, 0x78, 0x43,
+    0xc6, 0x10, 0x29, 0x4a, 0x4c, 0xf1, 0x2a, 0x44, 0x8a, 0x13, 0x43, 0x94, 0xc0, 0x89, 0xad, 0x05,
+    0x00,
+};
+
+static const uint8_t test_gzip_empty[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+
+static int test_checks = 0;
+static int test_failed = 0;
+
+static void test_check(bool ok, const char* format, ...) {
+    test_checks++;
+    if (ok)
+        return;
+    test_failed++;
+    va_list args;
+    va_start(args, format);
+    printf("FAILED: ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+
+typedef struct {
+    bool valid;                 // all writes succeeded
+    bool done;                  // whole stream was decoded
+    const char* error;
+    std::string out;
+} testResult_t;
+
+// Decode the stream written in chunks of given size
+static testResult_t test_decode(const void* data, size_t length, size_t chunk, uint64_t maxTotal = UINT64_MAX) {
+    testResult_t result = {true, false, nullptr, std::string()};
+    GzipDecoder decoder;
+    for (size_t pos = 0; pos < length && result.valid; pos += chunk)
+        result.valid = decoder.write((const char*)data + pos, std::min(chunk, length - pos), result.out, maxTotal);
+    result.done = decoder.is_done();
+    result.error = decoder.get_error();
+    return result;
+}
+
+static bool test_isError(const testResult_t& result, const char* error) {
+    return !result.valid && !result.done && result.error != nullptr && strcmp(result.error, error) == 0;
+}
+
+// Data similar to the HTTP bodies - repeated JSON with random numbers, random bytes or long runs
+static std::string test_data(const char* kind, size_t size, uint32_t* seed) {
+    std::string data;
+    data.reserve(size + 64);
+    if (strcmp(kind, "text") == 0) {
+        while (data.size() < size) {
+            char item[64];
+            snprintf(item, sizeof(item), "{\"name\":\"player%u\",\"kills\":%u},", bench_xorshift(seed) % 64, bench_xorshift(seed) % 100);
+            data += item;
+        }
+    } else if (strcmp(kind, "random") == 0) {
+        while (data.size() < size)
+            data.push_back((char)bench_xorshift(seed));
+    } else {
+        while (data.size() < size)
+            data.append(1 + bench_xorshift(seed) % 1000, (char)('a' + bench_xorshift(seed) % 3));
+    }
+    data.resize(size);
+    return data;
+}
+
+
+static void test_vectors() {
+    static const struct { const char* name; const uint8_t* data; size_t length; bool empty; } vectors[] = {
+        { "gzip dynamic",   test_gzip_dynamic,  sizeof(test_gzip_dynamic),  false },
+        { "zlib dynamic",   test_zlib_dynamic,  sizeof(test_zlib_dynamic),  false },
+        { "raw dynamic",    test_raw_dynamic,   sizeof(test_raw_dynamic),   false },
+        { "zlib stored",    test_zlib_stored,   sizeof(test_zlib_stored),   false },
+        { "raw fixed",      test_raw_fixed,     sizeof(test_raw_fixed),     false },
+        { "gzip empty",     test_gzip_empty,    sizeof(test_gzip_empty),    true },
+    };
+    std::string text = test_text;
+
+    for (const auto& v : vectors) {
+        const std::string& expected = v.empty ? std::string() : text;
+
+        for (size_t chunk : {v.length, (size_t)1, (size_t)3, (size_t)64}) {
+            testResult_t result = test_decode(v.data, v.length, chunk);
+            test_check(result.valid && result.done && result.out == expected, "vector %s, chunk %zu: %s", v.name, chunk, result.error ? result.error : "wrong output");
+        }
+
+        // Truncated stream waits for more input
+        for (size_t length = 0; length < v.length; length++) {
+            testResult_t result = test_decode(v.data, length, v.length);
+            test_check(result.valid && !result.done, "vector %s truncated to %zu bytes: %s", v.name, length, result.done ? "done" : result.error);
+        }
+
+        // Data after the stream is ignored
+        std::vector<uint8_t> padded(v.data, v.data + v.length);
+        padded.insert(padded.end(), 16, 0xaa);
+        testResult_t result = test_decode(padded.data(), padded.size(), 7);
+        test_check(result.valid && result.done && result.out == expected, "vector %s with trailing data", v.name);
+    }
+}
+
+// Every single bit error is detected by the checksum or by the decoder, or the output is the same (e.g. gzip header time)
+static void test_corrupted(const char* name, const uint8_t* data, size_t length, const std::string& expected) {
+    std::vector<uint8_t> corrupted(data, data + length);
+    int detected = 0;
+    for (size_t bit = 0; bit < length * 8; bit++) {
+        corrupted[bit >> 3] ^= 1 << (bit & 7);
+        testResult_t result = test_decode(corrupted.data(), corrupted.size(), corrupted.size());
+        test_check(!result.done || result.out == expected, "%s with bit %zu flipped was decoded with wrong data", name, bit);
+        detected += !result.done;
+        corrupted[bit >> 3] ^= 1 << (bit & 7);
+    }
+    printf("  %-24s %zu bits flipped, %i detected\n", name, length * 8, detected);
+}
+
+static void test_checksums() {
+    std::string text = test_text;
+    std::vector<uint8_t> gzip(test_gzip_dynamic, test_gzip_dynamic + sizeof(test_gzip_dynamic));
+    std::vector<uint8_t> zlib(test_zlib_dynamic, test_zlib_dynamic + sizeof(test_zlib_dynamic));
+
+    gzip[gzip.size() - 8] ^= 1;
+    test_check(test_isError(test_decode(gzip.data(), gzip.size(), 5), "Invalid gzip checksum"), "gzip with wrong CRC");
+    gzip[gzip.size() - 8] ^= 1;
+    gzip[gzip.size() - 4] ^= 1;
+    test_check(test_isError(test_decode(gzip.data(), gzip.size(), 5), "Invalid gzip checksum"), "gzip with wrong size");
+    zlib[zlib.size() - 1] ^= 1;
+    test_check(test_isError(test_decode(zlib.data(), zlib.size(), 5), "Invalid zlib checksum"), "zlib with wrong Adler-32");
+
+    test_corrupted("gzip dynamic", test_gzip_dynamic, sizeof(test_gzip_dynamic), text);
+    test_corrupted("zlib dynamic", test_zlib_dynamic, sizeof(test_zlib_dynamic), text);
+    test_corrupted("zlib stored", test_zlib_stored, sizeof(test_zlib_stored), text);
+}
+
+
+static void test_roundTrip() {
+    uint32_t seed = BENCH_SEED;
+    static const struct { const char* kind; size_t size; } inputs[] = {
+        { "text", 0 }, { "text", 1 }, { "text", 1000 }, { "text", 200000 }, { "random", 70000 }, { "runs", 300000 },
+    };
+
+    for (const auto& input : inputs) {
+        std::string data = test_data(input.kind, input.size, &seed);
+        size_t sizes[10] = {0};
+
+        for (int level = 1; level <= 9; level++) {
+            std::vector<char> compressed;
+            test_check(gzip_compress(data.data(), data.size(), level, compressed), "gzip_compress level %i", level);
+            sizes[level] = compressed.size();
+
+            for (size_t chunk : {compressed.size(), (size_t)1, (size_t)1000}) {
+                testResult_t result = test_decode(compressed.data(), compressed.size(), chunk);
+                test_check(result.valid && result.done && result.out == data, "round trip %s %zu bytes, level %i, chunk %zu: %s",
+                    input.kind, input.size, level, chunk, result.error ? result.error : "wrong output");
+            }
+
+            #if GZIP_TEST_ZLIB
+                std::string inflated(data.size() + 1, '\0');
+                z_stream z;
+                memset(&z, 0, sizeof(z));
+                inflateInit2(&z, 16 + MAX_WBITS);
+                z.next_in = (Bytef*)compressed.data();
+                z.avail_in = (uInt)compressed.size();
+                z.next_out = (Bytef*)&inflated[0];
+                z.avail_out = (uInt)inflated.size();
+                int status = inflate(&z, Z_FINISH);
+                inflated.resize(z.total_out);
+                inflateEnd(&z);
+                test_check(status == Z_STREAM_END && inflated == data, "zlib inflate of %s %zu bytes, level %i", input.kind, input.size, level);
+            #endif
+        }
+
+        // Compression of the first round trip is checked by the decoder of the test vectors
+        std::vector<char> compressed;
+        test_check(!gzip_compress(data.data(), data.size(), 0, compressed) && !gzip_compress(data.data(), data.size(), 10, compressed), "gzip_compress invalid level");
+
+        printf("  %-6s %6zu bytes, level 1 %6zu, level 6 %6zu, level 9 %6zu\n", input.kind, input.size, sizes[1], sizes[6], sizes[9]);
+    }
+
+    std::string text = test_text;
+    std::vector<char> compressed;
+    gzip_compress(text.data(), text.size(), 6, compressed);
+    test_corrupted("gzip_compress level 6", (const uint8_t*)compressed.data(), compressed.size(), text);
+}
+
+
+#if GZIP_TEST_ZLIB
+static void test_zlib() {
+    uint32_t seed = BENCH_SEED;
+    static const int strategies[] = {Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED};
+    static const int windowBits[] = {16 + MAX_WBITS, MAX_WBITS, -MAX_WBITS, 16 + 9}; // gzip, zlib, raw, gzip with small window
+
+    for (const char* kind : {"text", "random", "runs"}) {
+        std::string data = test_data(kind, 100000, &seed);
+        for (int level = 0; level <= 9; level++) {
+            for (int strategy : strategies) {
+                for (int bits : windowBits) {
+                    z_stream z;
+                    memset(&z, 0, sizeof(z));
+                    deflateInit2(&z, level, Z_DEFLATED, bits, 8, strategy);
+                    std::string compressed(deflateBound(&z, data.size()), '\0');
+                    z.next_in = (Bytef*)data.data();
+                    z.avail_in = (uInt)data.size();
+                    z.next_out = (Bytef*)&compressed[0];
+                    z.avail_out = (uInt)compressed.size();
+                    deflate(&z, Z_FINISH);
+                    compressed.resize(z.total_out);
+                    deflateEnd(&z);
+
+                    for (size_t chunk : {compressed.size(), (size_t)17}) {
+                        testResult_t result = test_decode(compressed.data(), compressed.size(), chunk);
+                        test_check(result.valid && result.done && result.out == data, "zlib %s, level %i, strategy %i, window bits %i, chunk %zu: %s",
+                            kind, level, strategy, bits, chunk, result.error ? result.error : "wrong output");
+                    }
+                }
+            }
+        }
+    }
+}
+#endif
+
+
+// Writer of hand-made deflate streams, Huffman codes are packed starting with the most significant bit
+typedef struct {
+    std::vector<uint8_t> data;
+    size_t bit;
+} testBits_t;
+
+static void test_putBits(testBits_t* w, uint32_t value, int count) {
+    for (int i = 0; i < count; i++, w->bit++) {
+        if ((w->bit & 7) == 0)
+            w->data.push_back(0);
+        w->data.back() |= ((value >> i) & 1) << (w->bit & 7);
+    }
+}
+
+static void test_putCode(testBits_t* w, uint32_t code, int length) {
+    for (int i = length - 1; i >= 0; i--)
+        test_putBits(w, (code >> i) & 1, 1);
+}
+
+/**
+ * Raw deflate stream of one dynamic block with given code lengths of 257 literal/length codes and ndist distance codes.
+ * Code lengths are written with the code length code where first clcodes symbols have 4 bits, so 16 makes it complete.
+ */
+static std::vector<uint8_t> test_dynamicBlock(const uint8_t* litLengths, const uint8_t* distLengths, int ndist, int clcodes, const int* symbols, int count) {
+    static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    testBits_t w = {std::vector<uint8_t>(), 0};
+
+    test_putBits(&w, 1, 1); // last block
+    test_putBits(&w, 2, 2); // dynamic
+    test_putBits(&w, 257 - 257, 5);
+    test_putBits(&w, ndist - 1, 5);
+    test_putBits(&w, 19 - 4, 4);
+    for (int i = 0; i < 19; i++)
+        test_putBits(&w, order[i] < clcodes ? 4 : 0, 3);
+    for (int i = 0; i < 257; i++)
+        test_putCode(&w, litLengths[i], 4);
+    for (int i = 0; i < ndist; i++)
+        test_putCode(&w, distLengths[i], 4);
+
+    // Canonical codes of literals (RFC 1951 3.2.2)
+    int lengthCount[16] = {0};
+    for (int i = 0; i < 257; i++)
+        lengthCount[litLengths[i]]++;
+    lengthCount[0] = 0;
+    int next[16] = {0};
+    for (int len = 1, code = 0; len < 16; len++) {
+        code = (code + lengthCount[len - 1]) << 1;
+        next[len] = code;
+    }
+    int codes[257];
+    for (int i = 0; i < 257; i++)
+        codes[i] = litLengths[i] ? next[litLengths[i]]++ : 0;
+
+    for (int i = 0; i < count; i++)
+        test_putCode(&w, codes[symbols[i]], litLengths[symbols[i]]);
+    return w.data;
+}
+
+static void test_codes() {
+    uint8_t lit[257], dist[30];
+    static const int symbols[] = {'A', 256};
+    static const int endOnly[] = {256};
+    std::vector<uint8_t> stream;
+    testResult_t result;
+
+    // Complete literal code, single distance code is allowed to be incomplete
+    memset(lit, 0, sizeof(lit)); memset(dist, 0, sizeof(dist));
+    lit['A'] = 1; lit[256] = 1; dist[0] = 1;
+    stream = test_dynamicBlock(lit, dist, 1, 16, symbols, 2);
+    result = test_decode(stream.data(), stream.size(), stream.size());
+    test_check(result.valid && result.done && result.out == "A", "single distance code: %s", result.error ? result.error : "wrong output");
+
+    // Code length code must be complete
+    stream = test_dynamicBlock(lit, dist, 1, 15, symbols, 2);
+    test_check(test_isError(test_decode(stream.data(), stream.size(), 1), "Invalid code length code"), "incomplete code length code");
+
+    // Two distance codes of 2 bits leave two codes unused
+    dist[0] = 2; dist[1] = 2;
+    stream = test_dynamicBlock(lit, dist, 2, 16, symbols, 2);
+    test_check(test_isError(test_decode(stream.data(), stream.size(), 1), "Invalid distance code lengths"), "incomplete distance code");
+
+    // Two literal codes of 2 bits leave two codes unused
+    memset(dist, 0, sizeof(dist));
+    dist[0] = 1; lit['A'] = 2; lit[256] = 2;
+    stream = test_dynamicBlock(lit, dist, 1, 16, symbols, 2);
+    test_check(test_isError(test_decode(stream.data(), stream.size(), 1), "Invalid literal/length code lengths"), "incomplete literal/length code");
+
+    // Three codes of 1 bit
+    lit['A'] = 1; lit['B'] = 1; lit[256] = 1;
+    stream = test_dynamicBlock(lit, dist, 1, 16, symbols, 2);
+    test_check(test_isError(test_decode(stream.data(), stream.size(), 1), "Invalid literal/length code lengths"), "over-subscribed literal/length code");
+
+    // Single end of block code without distance codes
+    memset(lit, 0, sizeof(lit)); memset(dist, 0, sizeof(dist));
+    lit[256] = 1;
+    stream = test_dynamicBlock(lit, dist, 1, 16, endOnly, 1);
+    result = test_decode(stream.data(), stream.size(), stream.size());
+    test_check(result.valid && result.done && result.out.empty(), "single end of block code: %s", result.error ? result.error : "wrong output");
+}
+
+
+static void test_limit() {
+    uint32_t seed = BENCH_SEED;
+    std::string data = test_data("runs", 1 << 20, &seed);
+    std::vector<char> compressed;
+    gzip_compress(data.data(), data.size(), 6, compressed);
+
+    for (size_t chunk : {compressed.size(), (size_t)100}) {
+        testResult_t result = test_decode(compressed.data(), compressed.size(), chunk, data.size());
+        test_check(result.valid && result.done && result.out == data, "decoded size equal to the limit, chunk %zu", chunk);
+        result = test_decode(compressed.data(), compressed.size(), chunk, data.size() - 1);
+        test_check(test_isError(result, GzipDecoder::ERROR_TOO_LARGE) && result.out.size() < data.size(), "decoded size over the limit, chunk %zu", chunk);
+    }
+
+    // Stored block is limited too
+    testResult_t result = test_decode(test_zlib_stored, sizeof(test_zlib_stored), 1, 100);
+    test_check(test_isError(result, GzipDecoder::ERROR_TOO_LARGE) && result.out.size() <= 100, "stored block over the limit");
+}
+
+
+int main(int argc, char** argv) {
+
+    if (argc > 1) {
+        printf("Usage:\n");
+        printf("  gzip_test\n");
+        return 1;
+    }
+
+    printf("Vectors of zlib\n");
+    test_vectors();
+    printf("Corrupted streams\n");
+    test_checksums();
+    printf("Round trip of gzip_compress\n");
+    test_roundTrip();
+    #if GZIP_TEST_ZLIB
+        printf("Streams compressed by zlib %s\n", zlibVersion());
+        test_zlib();
+    #endif
+    test_codes();
+    test_limit();
+
+    printf("%i checks, %i failed\n", test_checks, test_failed);
+    return test_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * Offline benchmark of the HTTP client - allocations and time per request.
+ * It links the same code as the game (http_client.h, reactor.h, gzip.cpp, mongoose), but it runs as native process,
+ * so the global allocator can be replaced to count allocations without touching the allocator of the game.
+ *
+ * Usage:
+ *   http_bench [options]
+ *
+ * Options:
+ *   -count <n>                 number of sequential POST requests of each run (default 1000)
+ *   -threaded                  network I/O runs on background thread, same as net_ioThread 1
+ *   -compress <level>          gzip level of request bodies, same as net_httpCompression (default 0)
+ *
+ * Requests are sent to a local listener on the shared reactor. Each run is done twice - response read through
+ * the views and response copied, as by a caller that keeps the response.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <algorithm>
+
+#include "bench.h"
+#include "http_client.h"
+
+// Allocations of the whole process, not inlined so the compiler does not pair the inlined malloc with operator delete
+static std::atomic<size_t> bench_allocs{0};
+static std::atomic<size_t> bench_bytes{0};
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    bench_allocs.fetch_add(1, std::memory_order_relaxed);
+    bench_bytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept { free(p); }
+
+
+// Response similar to a stats API
+static void bench_server(struct mg_connection* c, int ev, void* ev_data) {
+    if (ev == MG_EV_HTTP_MSG) {
+        mg_http_reply(c, 200, "Content-Type: application/json\r\nCache-Control: no-cache\r\nX-Request-Id: 0123456789abcdef0123456789abcdef\r\n",
+            "{\"players\":[%s]}", "{\"name\":\"player\",\"kills\":10,\"deaths\":5,\"score\":100},{\"name\":\"player\",\"kills\":10,\"deaths\":5,\"score\":100}");
+    }
+}
+
+static void bench_printUsage() {
+    printf("Usage:\n");
+    printf("  http_bench [-count <n>] [-threaded] [-compress <level>]\n");
+}
+
+
+int main(int argc, char** argv) {
+
+    int count = 1000;
+    bool threaded = false;
+    int compress = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-count") == 0 && i + 1 < argc && bench_parseCount(argv[i + 1], &count)) {
+            i++;
+        } else if (strcmp(argv[i], "-threaded") == 0) {
+            threaded = true;
+        } else if (strcmp(argv[i], "-compress") == 0 && i + 1 < argc) {
+            compress = std::min(9, std::max(0, atoi(argv[++i])));
+        } else {
+            bench_printUsage();
+            return 1;
+        }
+    }
+
+    NetReactor& reactor = NetReactor::instance();
+    if (threaded && !reactor.set_threaded(true)) {
+        fprintf(stderr, "Failed to start network I/O thread\n");
+        return 1;
+    }
+    HttpClient::compress_level = compress;
+
+    struct mg_connection* listener = NULL;
+    reactor.run_sync([&]() { listener = mg_http_listen(reactor.get_mgr(), "http://127.0.0.1:0", bench_server, NULL); });
+    if (listener == NULL) {
+        fprintf(stderr, "Failed to listen on local port\n");
+        return 1;
+    }
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/api/match", (unsigned)mg_ntohs(listener->loc.port));
+
+    // Body of a round report, big enough to be compressed with the default net_httpCompressionMinSize
+    std::string body = "{\"round\":1,\"players\":[";
+    for (int i = 0; i < 20; i++)
+        body += std::string(i ? "," : "") + "{\"name\":\"player\",\"kills\":10,\"deaths\":5,\"score\":100}";
+    body += "]}";
+
+    HttpClient* client = new HttpClient();
+    size_t received = 0;
+    int errors = 0;
+
+    for (int copy = 0; copy < 2; copy++) {
+        size_t allocs = bench_allocs.load();
+        size_t bytes = bench_bytes.load();
+        uint64_t start = bench_ticks_ns();
+
+        for (int n = 0; n < count; n++) {
+            bool done = false;
+            client->post(url, body.c_str(), "Content-Type: application/json",
+                [&](const HttpClient::Response& res) {
+                    if (copy) {
+                        HttpClient::Response kept = res;
+                        received += kept.body.size();
+                    } else {
+                        received += res.body.size();
+                    }
+                    done = true;
+                },
+                [&](const std::string& error) { errors++; done = true; });
+            while (!done)
+                reactor.poll(1);
+        }
+
+        uint64_t time = bench_ticks_ns() - start;
+        printf("HTTP %s, %s reactor, compression %i:\n", copy ? "response copied" : "response views", threaded ? "threaded" : "main thread", compress);
+        printf("  allocations:    %.1f per request\n", (double)(bench_allocs.load() - allocs) / count);
+        printf("  allocated:      %.0f bytes per request\n", (double)(bench_bytes.load() - bytes) / count);
+        printf("  time:           %.1f us per request\n", time / 1000.0 / count);
+    }
+
+    HttpClient::Stats stats = client->get_stats();
+    printf("\n");
+    printf("Requests:        %u, new connections %u, reused %u, compressed %u (saved %llu bytes)\n",
+        stats.requests, stats.connections, stats.reused, stats.compressed, (unsigned long long)stats.compressed_saved);
+    printf("Received:        %zu bytes, %i errors\n", received, errors);
+
+    delete client;
+    reactor.run_sync([listener]() { listener->is_closing = 1; });
+    reactor.set_threaded(false);
+
+    return errors > 0 ? 1 : 0;
+}
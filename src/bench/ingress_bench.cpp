@@ -0,0 +1,419 @@
+/**
+ * Offline benchmark of connection-less packet handling - command parsing, rate limiter and dispatch decision.
+ * It links the same code as the server (connless.cpp, ratelimit.cpp), so changes of the rate limiter can be measured
+ * without flooding a live server.
+ *
+ * Usage:
+ *   ingress_bench <file.pcap> [options]            replay packets captured by net_capture or tcpdump
+ *   ingress_bench -synthetic <mode> [options]      generated traffic, mode is random, hot or mixed
+ *
+ * Options:
+ *   -port <port>               replay only packets sent to this UDP port (server port)
+ *   -loops <n>                 replay the packets n times (default 1)
+ *   -count <n>                 number of generated packets (default 1000000)
+ *   -rate <pps>                packets per second of generated traffic (default 50000)
+ *   -policy <command> <value>  rate limit policy of command, same format as sv_rl_<command>
+ *   -outbound <value>          outbound byte budget, same format as sv_rl_outbound
+ *   -reply <bytes>             size of reply charged to outbound budget for each accepted request (default 0)
+ *
+ * Time of the rate limiter is taken from packet timestamps, so results do not depend on speed of the machine.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "bench.h"
+#include "connless.h"
+
+#define BENCH_MAX_PACKET        2048
+
+typedef struct {
+    uint64_t time;              // microseconds since first packet
+    unsigned char ip[4];
+    int length;
+    uint8_t data[BENCH_MAX_PACKET];
+} benchPacket_t;
+
+typedef struct {
+    const char* name;
+    const char* rateLimit;      // default value of sv_rl_<name>, NULL if not rate limited
+} benchCommand_t;
+
+// Must be the same as commands registered in server_init
+static const benchCommand_t bench_commands[] = {
+    { "v",              NULL },
+    { "getstatus",      "10 1000 20 250 10 100" },
+    { "getinfo",        "10 1000 20 250 10 100" },
+    { "getchallenge",   "10 1000 20 250 10 100" },
+    { "connect",        NULL },
+    { "ipAuthorize",    NULL },
+    { "rcon",           "10 1000 20 1000 10 1000" },
+    { "updateResponse", NULL },
+    { "getIpResponse",  NULL },
+    { "disconnect",     NULL },
+};
+#define BENCH_COMMANDS_COUNT    (int)(sizeof(bench_commands) / sizeof(bench_commands[0]))
+
+static std::vector<benchPacket_t> bench_packets;
+static uint32_t bench_seed = 0x12345678;
+
+
+static uint32_t bench_rand() {
+    return bench_xorshift(&bench_seed);
+}
+
+// Same ranges as Sys_IsLANAddress
+static bool bench_isLanAddress(const unsigned char* ip) {
+    return ip[0] == 127 || ip[0] == 10 || (ip[0] == 172 && (ip[1] & 0xf0) == 16) || (ip[0] == 192 && ip[1] == 168);
+}
+
+
+
+/**
+ * Read pcap file with raw IPv4 (as written by net_capture), Ethernet or Linux cooked link layer.
+ * Only UDP packets over IPv4 are used.
+ */
+static bool bench_loadPcap(const char* fileName, int port) {
+    FILE* file = fopen(fileName, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open '%s'\n", fileName);
+        return false;
+    }
+
+    uint32_t header[6];
+    if (fread(header, sizeof(header), 1, file) != 1) {
+        fprintf(stderr, "Failed to read pcap header\n");
+        fclose(file);
+        return false;
+    }
+
+    bool swapped = false;
+    bool nanoseconds = false;
+    switch (header[0]) {
+        case 0xa1b2c3d4: break;
+        case 0xa1b23c4d: nanoseconds = true; break;
+        case 0xd4c3b2a1: swapped = true; break;
+        case 0x4d3cb2a1: swapped = true; nanoseconds = true; break;
+        default:
+            fprintf(stderr, "'%s' is not a pcap file\n", fileName);
+            fclose(file);
+            return false;
+    }
+
+    #define BENCH_SWAP(x) (swapped ? __builtin_bswap32(x) : (x))
+
+    uint32_t linkType = BENCH_SWAP(header[5]);
+    int linkHeader;
+    switch (linkType) {
+        case 101: linkHeader = 0; break;    // raw IPv4
+        case 1:   linkHeader = 14; break;   // Ethernet
+        case 113: linkHeader = 16; break;   // Linux cooked capture
+        default:
+            fprintf(stderr, "Unsupported pcap link type %u\n", linkType);
+            fclose(file);
+            return false;
+    }
+
+    static uint8_t buffer[65536];
+    uint64_t firstTime = 0;
+    int skipped = 0;
+
+    while (true) {
+        uint32_t record[4];
+        if (fread(record, sizeof(record), 1, file) != 1)
+            break;
+
+        uint32_t captured = BENCH_SWAP(record[2]);
+        if (captured > sizeof(buffer) || fread(buffer, captured, 1, file) != 1)
+            break;
+
+        uint64_t time = (uint64_t)BENCH_SWAP(record[0]) * 1000000 + BENCH_SWAP(record[1]) / (nanoseconds ? 1000 : 1);
+
+        uint8_t* ip = buffer + linkHeader;
+        int ipLength = (int)captured - linkHeader;
+
+        // IPv4 with UDP, fragments are skipped
+        if (ipLength < 20 || (ip[0] >> 4) != 4 || ip[9] != 17 || ((ip[6] & 0x3f) | ip[7]) != 0) {
+            skipped++;
+            continue;
+        }
+        int ipHeader = (ip[0] & 0x0f) * 4;
+        if (ipLength < ipHeader + 8) {
+            skipped++;
+            continue;
+        }
+
+        uint8_t* udp = ip + ipHeader;
+        if (port != 0 && ((udp[2] << 8) | udp[3]) != port) {
+            skipped++;
+            continue;
+        }
+
+        int length = ipLength - ipHeader - 8;
+        if (length > BENCH_MAX_PACKET)
+            length = BENCH_MAX_PACKET;
+
+        if (bench_packets.empty())
+            firstTime = time;
+
+        bench_packets.emplace_back();
+        benchPacket_t& packet = bench_packets.back();
+        packet.time = time >= firstTime ? time - firstTime : 0;
+        memcpy(packet.ip, ip + 12, 4);
+        packet.length = length;
+        memcpy(packet.data, udp + 8, length);
+    }
+
+    #undef BENCH_SWAP
+
+    fclose(file);
+
+    printf("Loaded %i packets from '%s', skipped %i\n", (int)bench_packets.size(), fileName, skipped);
+
+    return true;
+}
+
+
+
+static void bench_addPacket(uint64_t time, uint32_t ip, const char* text) {
+    bench_packets.emplace_back();
+    benchPacket_t& packet = bench_packets.back();
+    packet.time = time;
+    memcpy(packet.ip, &ip, 4);
+    memset(packet.data, 0xff, 4);
+    packet.length = 4 + snprintf((char*)packet.data + 4, BENCH_MAX_PACKET - 4, "%s", text);
+}
+
+/**
+ * Generate traffic:
+ *   random - flood of getstatus from random spoofed addresses
+ *   hot    - flood of getstatus and getinfo from few addresses in few /24 prefixes
+ *   mixed  - both floods together with legitimate traffic of server browsers and players
+ */
+static bool bench_generate(const char* mode, int count, int rate) {
+    bool random = strcmp(mode, "random") == 0;
+    bool hot = strcmp(mode, "hot") == 0;
+    bool mixed = strcmp(mode, "mixed") == 0;
+
+    if (!random && !hot && !mixed) {
+        fprintf(stderr, "Unknown synthetic mode '%s', expected random, hot or mixed\n", mode);
+        return false;
+    }
+
+    bench_packets.reserve(count);
+
+    for (int i = 0; i < count; i++) {
+        uint64_t time = (uint64_t)i * 1000000 / rate;
+        uint32_t r = bench_rand();
+        int kind = mixed ? (int)(r % 10) : random ? 0 : 5;
+
+        if (kind < 5) {
+            // Random source address, each address is seen only few times
+            bench_addPacket(time, bench_rand(), "getstatus xxx");
+        } else if (kind < 8) {
+            // 64 hot addresses from 4 prefixes
+            uint32_t n = bench_rand() % 64;
+            unsigned char ip[4] = { 45, 13, (unsigned char)(100 + n % 4), (unsigned char)(n / 4 + 1) };
+            uint32_t addr;
+            memcpy(&addr, ip, 4);
+            bench_addPacket(time, addr, (n & 1) ? "getinfo xxx" : "getstatus xxx");
+        } else {
+            // Legitimate clients, each client sends request from time to time
+            static const char* requests[] = { "getinfo xxx", "getstatus xxx", "getchallenge", "connect \"\\name\\player\"", "ipAuthorize 1 accept", "foo" };
+            uint32_t client = bench_rand() % 5000;
+            unsigned char ip[4] = { (unsigned char)(80 + client % 50), (unsigned char)(client / 50), (unsigned char)(client % 200), 7 };
+            uint32_t addr;
+            memcpy(&addr, ip, 4);
+            bench_addPacket(time, addr, requests[bench_rand() % 6]);
+        }
+    }
+
+    printf("Generated %i packets of '%s' traffic at %i packets/s\n", count, mode, rate);
+
+    return true;
+}
+
+
+
+static void bench_printUsage() {
+    printf("Usage:\n");
+    printf("  ingress_bench <file.pcap> [-port <port>] [-loops <n>] [options]\n");
+    printf("  ingress_bench -synthetic <random|hot|mixed> [-count <n>] [-rate <pps>] [options]\n");
+    printf("Options:\n");
+    printf("  -policy <command> \"<addrBurst> <addrPeriod> <prefixBurst> <prefixPeriod> <overallBurst> <overallPeriod>\"\n");
+    printf("  -outbound \"<bytes> <period ms>\"\n");
+    printf("  -reply <bytes>\n");
+}
+
+
+int main(int argc, char** argv) {
+
+    const char* fileName = NULL;
+    const char* synthetic = NULL;
+    const char* outbound = "32768 10000";
+    int port = 0;
+    int loops = 1;
+    int count = 1000000;
+    int rate = 50000;
+    int reply = 0;
+
+    connlessCommand_t* commands[BENCH_COMMANDS_COUNT];
+    for (int i = 0; i < BENCH_COMMANDS_COUNT; i++) {
+        commands[i] = connless_registerCommand(bench_commands[i].name, bench_commands[i].rateLimit != NULL);
+        if (commands[i]->rateLimited)
+            connless_parsePolicy(commands[i], bench_commands[i].rateLimit);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-synthetic") == 0 && i + 1 < argc) {
+            synthetic = argv[++i];
+        } else if (strcmp(argv[i], "-port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-loops") == 0 && i + 1 < argc) {
+            loops = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-count") == 0 && i + 1 < argc) {
+            count = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc) {
+            rate = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-reply") == 0 && i + 1 < argc) {
+            reply = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-outbound") == 0 && i + 1 < argc) {
+            outbound = argv[++i];
+        } else if (strcmp(argv[i], "-policy") == 0 && i + 2 < argc) {
+            connlessCommand_t* command = connless_findCommand(argv[i + 1]);
+            if (command == NULL || !command->rateLimited || !connless_parsePolicy(command, argv[i + 2])) {
+                fprintf(stderr, "Invalid policy '%s' of command '%s'\n", argv[i + 2], argv[i + 1]);
+                return 1;
+            }
+            i += 2;
+        } else if (argv[i][0] != '-' && fileName == NULL) {
+            fileName = argv[i];
+        } else {
+            bench_printUsage();
+            return 1;
+        }
+    }
+
+    if (!connless_parseOutboundPolicy(outbound)) {
+        fprintf(stderr, "Invalid outbound policy '%s'\n", outbound);
+        return 1;
+    }
+
+    if (synthetic != NULL) {
+        if (!bench_generate(synthetic, count, rate))
+            return 1;
+    } else if (fileName != NULL) {
+        if (!bench_loadPcap(fileName, port))
+            return 1;
+    } else {
+        bench_printUsage();
+        return 1;
+    }
+
+    if (bench_packets.empty()) {
+        fprintf(stderr, "No packets to replay\n");
+        return 1;
+    }
+
+    size_t total = bench_packets.size() * loops;
+    std::vector<uint32_t> latencies;
+    latencies.reserve(total);
+
+    uint32_t sequenced = 0;
+    uint32_t unknown = 0;
+    uint32_t accepted[BENCH_COMMANDS_COUNT] = {0};
+
+    // Each loop continues after the end of previous loop, buckets of the previous loop are already expired
+    uint64_t loopTime = bench_packets.back().time + 60000000;
+
+    uint64_t start = bench_ticks_ns();
+
+    for (int loop = 0; loop < loops; loop++) {
+        for (const benchPacket_t& packet : bench_packets) {
+
+            uint64_t packetStart = bench_ticks_ns();
+            uint64_t now = (loop * loopTime + packet.time) / 1000;
+
+            // Same steps as SV_ConnectionlessPacket: read the command, find the handler, apply the rate limiter
+            if (packet.length < 4 || *(const int*)packet.data != -1) {
+                sequenced++;
+            } else {
+                char name[32];
+                connless_readCommand(packet.data, packet.length, name, sizeof(name));
+
+                connlessCommand_t* command = connless_findCommand(name);
+                if (command == NULL) {
+                    unknown++;
+                } else if (command->rateLimited) {
+                    bool isLan = bench_isLanAddress(packet.ip);
+                    svcRateLimit_e result = connless_rateLimit(command, packet.ip, isLan, now);
+                    if (result == SVC_RATELIMIT_OK || result == SVC_RATELIMIT_NONE)
+                        result = connless_rateLimitOutbound(command, packet.ip, isLan, now);
+                    if (result == SVC_RATELIMIT_OK || result == SVC_RATELIMIT_NONE) {
+                        connless_chargeOutbound(packet.ip, isLan, reply, now);
+                        accepted[command->index]++;
+                    }
+                } else {
+                    accepted[command->index]++;
+                }
+            }
+
+            latencies.push_back((uint32_t)(bench_ticks_ns() - packetStart));
+        }
+    }
+
+    double seconds = (bench_ticks_ns() - start) / 1e9;
+
+    printf("\n");
+    printf("Packets:         %zu in %.3f s\n", total, seconds);
+    printf("Throughput:      %.0f packets/s\n", total / seconds);
+    printf("Sequenced:       %u\n", sequenced);
+    printf("Unknown command: %u\n", unknown);
+
+    printf("\n");
+    printf("command          requests  accepted  dropped   drop %%\n");
+    printf("---------------- --------- --------- --------- -------\n");
+    for (int i = 0; i < BENCH_COMMANDS_COUNT; i++) {
+        uint32_t dropped = commands[i]->dropped.load();
+        uint32_t requests = accepted[i] + dropped;
+        if (requests == 0)
+            continue;
+        printf("%-16s %9u %9u %9u %6.2f%%\n", commands[i]->name, requests, accepted[i], dropped, 100.0 * dropped / requests);
+    }
+
+    connlessStats_t stats;
+    connless_getStats(&stats);
+    printf("\n");
+    printf("Buckets used:    %i request, %i prefix, %i outbound (max %i each), %u evicted\n",
+        stats.buckets, stats.prefixBuckets, stats.outboundBuckets, RATELIMIT_MAX_BUCKETS, stats.evicted);
+    printf("Dropped:         %u address, %u prefix, %u overall, %u outbound bytes\n",
+        stats.droppedAddress, stats.droppedPrefix, stats.droppedOverall, stats.droppedOutbound);
+
+    heavyHitter_t items[RATELIMIT_HEAVY_HITTERS];
+    int offenders = connless_topOffenders(items, 5);
+    for (int i = 0; i < offenders; i++) {
+        unsigned char* ip = (unsigned char*)&items[i].prefix;
+        printf("%s%i.%i.%i.0/24 (%u)", i == 0 ? "Top prefixes:    " : ", ", ip[0], ip[1], ip[2], items[i].count);
+    }
+    if (offenders > 0)
+        printf("\n");
+
+    // Latency includes the overhead of reading the clock, which is measured separately
+    uint64_t clockStart = bench_ticks_ns();
+    for (int i = 0; i < 1000; i++)
+        bench_ticks_ns();
+    double clockOverhead = (bench_ticks_ns() - clockStart) / 1000.0;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, (size_t)(p * latencies.size()))]; };
+
+    printf("\n");
+    printf("Latency (ns):    p50 %u, p90 %u, p99 %u, p99.9 %u, max %u (clock overhead %.0f)\n",
+        percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), latencies.back(), clockOverhead);
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "egress.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "shared.h"
+#include "hibernate.h"
+#include "../shared/cod2_common.h"
+#include "../shared/cod2_dvars.h"
+#include "../shared/cod2_net.h"
+
+// Maximum number of packets sent by one sendmmsg call, the queue is flushed when full
+#define EGRESS_QUEUE_SIZE       256
+// Client packets are fragmented by netchan into ~1400 bytes, bigger packets are sent directly
+#define EGRESS_PACKET_SIZE      2048
+
+dvar_t* net_batchSend = NULL;
+dvar_t* net_batchSendSaved = NULL;
+
+static uint8_t egress_buffers[EGRESS_QUEUE_SIZE][EGRESS_PACKET_SIZE];
+static struct sockaddr_in egress_addrs[EGRESS_QUEUE_SIZE];
+static netaddr_s egress_netaddrs[EGRESS_QUEUE_SIZE];
+static struct iovec egress_iovecs[EGRESS_QUEUE_SIZE];
+static struct mmsghdr egress_msgs[EGRESS_QUEUE_SIZE];
+static int egress_count = 0;
+
+// Packets are queued only while SV_Frame is running
+static bool egress_batching = false;
+
+// Statistics for net_batchSendSaved
+static uint32_t egress_packets = 0;
+static uint32_t egress_syscalls = 0;
+static uint32_t egress_droppedWouldBlock = 0;
+static uint64_t egress_nextStatsTime = 0;
+
+
+/**
+ * Add the packet into the send queue.
+ * Returns false if the packet must be sent directly.
+ */
+bool egress_queuePacket(int length, const void* data, netaddr_s to) {
+
+    // Connection-less packets are sent directly, so the replies and errors are sent even if the frame is not finished
+    if (!egress_batching || to.type != NA_IP || length <= 4 || length > EGRESS_PACKET_SIZE || *(int*)data == -1)
+        return false;
+
+    if (egress_count >= EGRESS_QUEUE_SIZE)
+        egress_flush();
+
+    int i = egress_count++;
+
+    memcpy(egress_buffers[i], data, length);
+    egress_netaddrs[i] = to;
+
+    // Same as NetadrToSockadr, port is already in network order
+    memset(&egress_addrs[i], 0, sizeof(egress_addrs[i]));
+    egress_addrs[i].sin_family = AF_INET;
+    memcpy(&egress_addrs[i].sin_addr, to.ip, 4);
+    egress_addrs[i].sin_port = to.port;
+
+    egress_iovecs[i].iov_base = egress_buffers[i];
+    egress_iovecs[i].iov_len = length;
+
+    memset(&egress_msgs[i], 0, sizeof(egress_msgs[i]));
+    egress_msgs[i].msg_hdr.msg_name = &egress_addrs[i];
+    egress_msgs[i].msg_hdr.msg_namelen = sizeof(egress_addrs[i]);
+    egress_msgs[i].msg_hdr.msg_iov = &egress_iovecs[i];
+    egress_msgs[i].msg_hdr.msg_iovlen = 1;
+
+    return true;
+}
+
+
+/**
+ * Send all queued packets by sendmmsg.
+ */
+void egress_flush() {
+
+    int count = egress_count;
+    egress_count = 0;
+
+    if (count == 0)
+        return;
+
+    int sock = ip_socket;
+    if (sock <= 0)
+        return;
+
+    int sent = 0;
+    while (sent < count) {
+        int ret = sendmmsg(sock, egress_msgs + sent, count - sent, 0);
+        egress_syscalls++;
+
+        if (ret > 0) {
+            sent += ret;
+            continue;
+        }
+        if (ret < 0 && errno == EINTR)
+            continue;
+
+        // Send buffer of the socket is full, the rest of the queue is dropped without error like in Sys_SendPacket
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            egress_droppedWouldBlock += count - sent;
+            break;
+        }
+
+        // Skip the packet that failed, the same error is printed by Sys_SendPacket
+        Com_Printf("NET_SendPacket ERROR: %s to %s\n", strerror(errno), NET_AdrToString(egress_netaddrs[sent]));
+        sent++;
+    }
+
+    egress_packets += count;
+}
+
+
+/**
+ * SV_Frame
+ * Is called from Com_Frame. Packets sent to clients during the frame are queued and sent at the end of the frame.
+ */
+static void SV_Frame(int msec) {
+
+    // Packets might be left in the queue if the previous frame was ended by error
+    egress_flush();
+
+    egress_batching = net_batchSend->value.boolean;
+    hibernate_serverFrameBegin();
+
+    ASM_CALL(RETURN_VOID, 0x080969b0, 1, PUSH(msec));
+
+    hibernate_serverFrameEnd();
+    egress_batching = false;
+    egress_flush();
+}
+
+
+/** Called every frame on frame start. */
+void egress_frame() {
+
+    uint64_t now = ticks_ms();
+    if (now >= egress_nextStatsTime) {
+        egress_nextStatsTime = now + 1000;
+
+        // Number of sendto calls that would be called without batching minus actual sendmmsg calls in last second
+        int saved = egress_packets > egress_syscalls ? egress_packets - egress_syscalls : 0;
+        if (saved != net_batchSendSaved->value.integer)
+            Dvar_SetInt(net_batchSendSaved, saved);
+
+        egress_packets = 0;
+        egress_syscalls = 0;
+
+        // Printed once per second, the buffer is usually full for many frames when the server is saturated
+        if (egress_droppedWouldBlock > 0) {
+            Com_DPrintf("Egress: socket send buffer is full, dropped %u packets\n", egress_droppedWouldBlock);
+            egress_droppedWouldBlock = 0;
+        }
+    }
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void egress_init() {
+
+    // Packets sent to clients during server frame are sent together by one sendmmsg call at the end of the frame
+    net_batchSend = Dvar_RegisterBool("net_batchSend", false, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    // Number of send syscalls saved in last second
+    net_batchSendSaved = Dvar_RegisterInt("net_batchSendSaved", 0, 0, 0x7fffffff, (dvarFlags_e)(DVAR_ROM | DVAR_CHANGEABLE_RESET));
+}
+
+/** Called before the entry point is called. Used to patch the memory. */
+void egress_patch() {
+
+    patch_call(0x080627ce, (unsigned int)SV_Frame); // Com_Frame
+}
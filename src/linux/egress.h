@@ -0,0 +1,10 @@
+#ifndef EGRESS_H
+#define EGRESS_H
+
+bool egress_queuePacket(int length, const void* data, struct netaddr_s to);
+void egress_flush();
+void egress_frame();
+void egress_init();
+void egress_patch();
+
+#endif // EGRESS_H
@@ -0,0 +1,163 @@
+#include "hibernate.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "shared.h"
+#include "ingress.h"
+#include "../shared/cod2_common.h"
+#include "../shared/cod2_dvars.h"
+#include "../shared/cod2_server.h"
+
+// How often the connected clients are checked
+#define HIBERNATE_CHECK_MS      1000
+// Ingress thread reads the socket, so the main thread can not wait for the packets and must check the ring regularly
+#define HIBERNATE_THREAD_WAIT_MS 10
+
+dvar_t* sv_hibernateTime = NULL;
+dvar_t* sv_hibernateFps = NULL;
+dvar_t* sv_hibernating = NULL;
+
+static bool hibernate_active = false;
+static uint64_t hibernate_lastHumanTime = 0;
+static uint64_t hibernate_nextCheckTime = 0;
+static uint64_t hibernate_startTime = 0;
+static int hibernate_savedFps = 0;
+
+
+static void hibernate_setActive(bool active) {
+    hibernate_active = active;
+    if (sv_hibernating->value.boolean != active)
+        Dvar_SetBool(sv_hibernating, active);
+}
+
+static bool hibernate_hasHumans() {
+    for (int i = 0; i < sv_maxclients->value.integer && i < MAX_CLIENTS; i++) {
+        client_t* client = &svs_clients[i];
+        if (client->state >= CS_CONNECTED && !client->bIsTestClient)
+            return true;
+    }
+    return false;
+}
+
+
+/**
+ * Returns true if the server runs at sv_hibernateFps because no players were connected for sv_hibernateTime seconds.
+ */
+bool hibernate_isActive() {
+    return hibernate_active;
+}
+
+/**
+ * Leave the hibernation immediately, next server frame runs at full sv_fps.
+ * Is called when a client asks for challenge or connects.
+ */
+void hibernate_wake(const char* reason) {
+
+    // Hibernation is not entered again until the time passes without players
+    hibernate_lastHumanTime = ticks_ms();
+
+    if (!hibernate_active)
+        return;
+
+    hibernate_setActive(false);
+
+    Com_Printf("Server woke up from hibernation after %i seconds (%s)\n", (int)((ticks_ms() - hibernate_startTime) / 1000), reason);
+}
+
+
+/**
+ * Is called in the main loop instead of the sleep before Com_Frame.
+ * While hibernating, the thread waits until a packet is received or next hibernation frame is due.
+ * Returns false if the server is not hibernating and the original sleep should be used.
+ */
+bool hibernate_sleep() {
+
+    if (!hibernate_active)
+        return false;
+
+    int timeout = 1000 / sv_hibernateFps->value.integer;
+    if (ingress_isThreadRunning() && timeout > HIBERNATE_THREAD_WAIT_MS)
+        timeout = HIBERNATE_THREAD_WAIT_MS;
+
+    int sock = ip_socket;
+    if (sock <= 0) {
+        usleep(timeout * 1000);
+        return true;
+    }
+
+    struct pollfd pfd = { sock, POLLIN, 0 };
+    poll(&pfd, 1, timeout);
+
+    return true;
+}
+
+
+/**
+ * Is called before SV_Frame.
+ * While hibernating, the frame time is increased to 1000 / sv_hibernateFps, so the game frame, scripts and snapshots
+ * are run only few times per second. Server time still follows the real time, so the heartbeats and timeouts are not affected.
+ */
+void hibernate_serverFrameBegin() {
+    hibernate_savedFps = 0;
+
+    if (!hibernate_active || sv_fps == NULL || sv_fps->value.integer <= sv_hibernateFps->value.integer)
+        return;
+
+    hibernate_savedFps = sv_fps->value.integer;
+    sv_fps->value.integer = sv_hibernateFps->value.integer;
+}
+
+/** Is called after SV_Frame. */
+void hibernate_serverFrameEnd() {
+    if (hibernate_savedFps == 0)
+        return;
+
+    sv_fps->value.integer = hibernate_savedFps;
+    hibernate_savedFps = 0;
+}
+
+
+/** Called every frame on frame start. */
+void hibernate_frame() {
+
+    uint64_t now = ticks_ms();
+
+    if (!sv_running || !sv_running->value.boolean || sv_hibernateTime->value.integer <= 0) {
+        if (hibernate_active)
+            hibernate_wake(sv_hibernateTime->value.integer <= 0 ? "disabled" : "server stopped");
+        hibernate_lastHumanTime = now;
+        return;
+    }
+
+    if (now < hibernate_nextCheckTime)
+        return;
+    hibernate_nextCheckTime = now + HIBERNATE_CHECK_MS;
+
+    if (hibernate_hasHumans()) {
+        if (hibernate_active)
+            hibernate_wake("player connected");
+        hibernate_lastHumanTime = now;
+        return;
+    }
+
+    if (!hibernate_active && now - hibernate_lastHumanTime >= (uint64_t)sv_hibernateTime->value.integer * 1000) {
+        hibernate_setActive(true);
+        hibernate_startTime = now;
+        Com_Printf("Server is hibernating at %i fps, no players connected for %i seconds\n", sv_hibernateFps->value.integer, sv_hibernateTime->value.integer);
+    }
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void hibernate_init() {
+
+    // Time in seconds without connected players after which the server runs only sv_hibernateFps frames per second, 0 disables it
+    // Server wakes up immediately when a client asks for challenge or connects
+    sv_hibernateTime = Dvar_RegisterInt("sv_hibernateTime", 0, 0, 86400, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    // Frames per second while hibernating
+    sv_hibernateFps = Dvar_RegisterInt("sv_hibernateFps", 4, 1, 20, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    // Is set when the server is hibernating
+    sv_hibernating = Dvar_RegisterBool("sv_hibernating", false, (dvarFlags_e)(DVAR_ROM | DVAR_CHANGEABLE_RESET));
+}
@@ -0,0 +1,12 @@
+#ifndef HIBERNATE_H
+#define HIBERNATE_H
+
+bool hibernate_isActive();
+void hibernate_wake(const char* reason);
+bool hibernate_sleep();
+void hibernate_serverFrameBegin();
+void hibernate_serverFrameEnd();
+void hibernate_frame();
+void hibernate_init();
+
+#endif // HIBERNATE_H
@@ -12,7 +12,22 @@
 #include "../shared/animation.h"
 #include "../shared/gsc.h"
 #include "../shared/match.h"
+#include "../shared/query_cache.h"
+#include "../shared/capture.h"
+#include "../shared/challenge.h"
+#include "../shared/resolver.h"
+#include "../shared/net_reactor.h"
+#include "../shared/ban.h"
+#include "../shared/authorize_cache.h"
+#include "../shared/player_index.h"
+#include "../shared/player_interest.h"
+#include "../shared/netstats.h"
+#include "../shared/adaptive_snaps.h"
 #include "updater.h"
+#include "ingress.h"
+#include "egress.h"
+#include "pacer.h"
+#include "hibernate.h"
 
 
 /**
@@ -21,12 +36,29 @@
  */
 void __cdecl hook_Com_Frame() {
 
+    pacer_frameBegin();
+
     // Call the original function
     ASM_CALL(RETURN_VOID, 0x080626f4);
 
+    pacer_frameEnd();
+
+    resolver_frame();
+    net_reactor_frame();
+    server_frame();
     gsc_frame();
     match_frame();
     iwd_frame();
+    query_cache_frame();
+    ban_frame();
+    authorize_cache_frame();
+    netstats_frame();
+    adaptive_snaps_frame();
+    updater_frame();
+    ingress_frame();
+    egress_frame();
+    pacer_frame();
+    hibernate_frame();
 }
 
 
@@ -42,6 +74,8 @@ void hook_SV_Init() {
 
     // Shared & Server
     common_init();
+    resolver_init();
+    net_reactor_init();
     server_init();
     dvar_init();
     updater_init();
@@ -49,6 +83,19 @@ void hook_SV_Init() {
     animation_init();
     match_init();
     iwd_init();
+    query_cache_init();
+    capture_init();
+    challenge_init();
+    ban_init();
+    authorize_cache_init();
+    player_index_init();
+    player_interest_init();
+    netstats_init();
+    adaptive_snaps_init();
+    ingress_init();
+    egress_init();
+    pacer_init();
+    hibernate_init();
 
     ASM_CALL(RETURN_VOID, 0x08093adc);
 }
@@ -95,6 +142,10 @@ bool hook_patch() {
     gsc_patch();
     match_patch();
     iwd_patch();
+    query_cache_patch();
+    ingress_patch();
+    egress_patch();
+    pacer_patch();
 
     return true;
 }
\ No newline at end of file
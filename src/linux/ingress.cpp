@@ -0,0 +1,310 @@
+#include "ingress.h"
+
+#include <pthread.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+
+#include "shared.h"
+#include "../shared/server.h"
+#include "../shared/cod2_common.h"
+#include "../shared/cod2_dvars.h"
+#include "../shared/cod2_net.h"
+
+// Must be power of 2
+#define INGRESS_RING_SIZE       1024
+// Client packets are fragmented by netchan into ~1400 bytes, bigger packets are dropped
+#define INGRESS_PACKET_SIZE     2048
+// Number of packets received by one recvmmsg call
+#define INGRESS_BATCH_SIZE      32
+// Number of /24 prefixes in LAN cache, must be power of 2
+#define INGRESS_LAN_CACHE_SIZE  256
+
+typedef struct {
+    netaddr_s from;
+    int length;
+    bool filtered; // connection-less command was already checked by the rate limiter
+    uint8_t data[INGRESS_PACKET_SIZE];
+} ingressPacket_t;
+
+dvar_t* sv_netThread = NULL;
+extern dvar_t* sv_rateLimiter;
+
+// Single-producer single-consumer ring, head is written only by the ingress thread, tail only by the main thread
+static ingressPacket_t ingress_ring[INGRESS_RING_SIZE];
+static std::atomic<uint32_t> ingress_head(0);
+static std::atomic<uint32_t> ingress_tail(0);
+
+static pthread_t ingress_thread;
+static bool ingress_threadRunning = false;
+static volatile bool ingress_exitThread = false;
+
+// Statistics updated by the ingress thread
+static std::atomic<uint32_t> ingress_droppedRateLimit(0);
+static std::atomic<uint32_t> ingress_droppedOverflow(0);
+static std::atomic<uint32_t> ingress_droppedOversize(0);
+static uint64_t ingress_nextStatsTime = 0;
+
+// State of the last packet returned by Sys_GetPacket
+static bool ingress_lastPacketFromThread = false;
+static bool ingress_lastPacketFiltered = false;
+
+// /24 prefixes that Sys_IsLANAddress marked as LAN, e.g. subnets of local interfaces
+// Written by the main thread, because Sys_IsLANAddress is engine function, read by the ingress thread
+// Item is prefix in lower 24 bits with bit 24 set, 0 means empty
+static std::atomic<uint32_t> ingress_lanCache[INGRESS_LAN_CACHE_SIZE];
+
+
+static inline uint32_t ingress_lanCacheKey(const unsigned char* ip) {
+    return (ip[0] << 16) | (ip[1] << 8) | ip[2] | (1 << 24);
+}
+
+static inline uint32_t ingress_lanCacheSlot(uint32_t key) {
+    return ((key * 0x9e3779b1) >> 24) & (INGRESS_LAN_CACHE_SIZE - 1);
+}
+
+// Called by main thread for packets from the ingress thread, the next packets from the same prefix are checked by the thread with the result
+static void ingress_updateLanCache(netaddr_s from) {
+    uint32_t key = ingress_lanCacheKey(from.ip);
+    std::atomic<uint32_t>& item = ingress_lanCache[ingress_lanCacheSlot(key)];
+
+    if (Sys_IsLANAddress(from))
+        item.store(key, std::memory_order_relaxed);
+    else if (item.load(std::memory_order_relaxed) == key)
+        item.store(0, std::memory_order_relaxed);
+}
+
+// Private ranges are always LAN, same as in Sys_IsLANAddress, other addresses are LAN only if main thread cached them
+static bool ingress_isLanAddress(const unsigned char* ip) {
+    if (ip[0] == 127 || ip[0] == 10 || (ip[0] == 172 && (ip[1] & 0xf0) == 16) || (ip[0] == 192 && ip[1] == 168))
+        return true;
+
+    uint32_t key = ingress_lanCacheKey(ip);
+    return ingress_lanCache[ingress_lanCacheSlot(key)].load(std::memory_order_relaxed) == key;
+}
+
+
+static void ingress_processPacket(const uint8_t* data, int length, const struct sockaddr_in* addr) {
+
+    netaddr_s from;
+    memset(&from, 0, sizeof(from));
+    from.type = NA_IP;
+    memcpy(from.ip, &addr->sin_addr, 4);
+    from.port = addr->sin_port;
+
+    bool filtered = false;
+
+    // Connection-less packet, apply the rate limiter before the packet gets into the game loop
+    if (length >= 4 && *(int*)data == -1 && sv_rateLimiter->value.boolean) {
+        char command[32];
+        connless_readCommand(data, length, command, sizeof(command));
+
+        // Engine functions are not called from this thread, LAN addresses are checked with the cache
+        svcRateLimit_e result = connless_rateLimit(connless_findCommand(command), from.ip, ingress_isLanAddress(from.ip), ticks_ms());
+        if (result == SVC_RATELIMIT_ADDRESS || result == SVC_RATELIMIT_PREFIX || result == SVC_RATELIMIT_OVERALL) {
+            ingress_droppedRateLimit++;
+            return;
+        }
+        filtered = true;
+    }
+
+    uint32_t head = ingress_head.load(std::memory_order_relaxed);
+    uint32_t tail = ingress_tail.load(std::memory_order_acquire);
+    if (head - tail >= INGRESS_RING_SIZE) {
+        ingress_droppedOverflow++;
+        return;
+    }
+
+    ingressPacket_t* packet = &ingress_ring[head & (INGRESS_RING_SIZE - 1)];
+    packet->from = from;
+    packet->length = length;
+    packet->filtered = filtered;
+    memcpy(packet->data, data, length);
+
+    ingress_head.store(head + 1, std::memory_order_release);
+}
+
+
+static void* ingress_threadProc(void* arg) {
+    (void)arg;
+
+    static uint8_t buffers[INGRESS_BATCH_SIZE][INGRESS_PACKET_SIZE];
+    struct sockaddr_in addrs[INGRESS_BATCH_SIZE];
+    struct iovec iovecs[INGRESS_BATCH_SIZE];
+    struct mmsghdr msgs[INGRESS_BATCH_SIZE];
+
+    while (!ingress_exitThread) {
+
+        // Socket might be reopened by net_restart
+        int sock = ip_socket;
+        if (sock <= 0) {
+            usleep(10000);
+            continue;
+        }
+
+        struct pollfd pfd = { sock, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) <= 0 || !(pfd.revents & POLLIN))
+            continue;
+
+        for (int i = 0; i < INGRESS_BATCH_SIZE; i++) {
+            iovecs[i].iov_base = buffers[i];
+            iovecs[i].iov_len = INGRESS_PACKET_SIZE;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // EAGAIN and ECONNREFUSED are ignored the same way as in original Sys_GetPacket
+        int count = recvmmsg(sock, msgs, INGRESS_BATCH_SIZE, MSG_DONTWAIT, NULL);
+        if (count <= 0)
+            continue;
+
+        for (int i = 0; i < count; i++) {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                ingress_droppedOversize++;
+                continue;
+            }
+            if (addrs[i].sin_family != AF_INET)
+                continue;
+            ingress_processPacket(buffers[i], msgs[i].msg_len, &addrs[i]);
+        }
+    }
+
+    return NULL;
+}
+
+
+static void ingress_startThread() {
+    ingress_exitThread = false;
+    if (pthread_create(&ingress_thread, NULL, ingress_threadProc, NULL) != 0) {
+        Com_Printf("Failed to create network ingress thread\n");
+        return;
+    }
+    ingress_threadRunning = true;
+    Com_Printf("Network ingress thread started\n");
+}
+
+static void ingress_stopThread() {
+    ingress_exitThread = true;
+    pthread_join(ingress_thread, NULL);
+    ingress_threadRunning = false;
+    Com_Printf("Network ingress thread stopped\n");
+}
+
+
+/**
+ * Returns true if the last packet returned by Sys_GetPacket was received by the ingress thread.
+ */
+bool ingress_isPacketFromThread() {
+    return ingress_lastPacketFromThread;
+}
+
+/**
+ * Returns true if the last packet returned by Sys_GetPacket was connection-less packet that passed the rate limiter in the ingress thread.
+ */
+bool ingress_isPacketFiltered() {
+    return ingress_lastPacketFiltered;
+}
+
+/**
+ * Returns true if the packets are read from the socket by the ingress thread.
+ */
+bool ingress_isThreadRunning() {
+    return ingress_threadRunning;
+}
+
+
+/**
+ * Sys_GetPacket
+ * Is called from NET_GetPacket in Com_EventLoop until no packet is returned.
+ * When ingress thread is running, packets are read from the ring instead of the socket.
+ */
+int Sys_GetPacket(netaddr_s* from, msg_t* msg) {
+
+    // Packets left in the ring are processed even if the thread was stopped meanwhile
+    uint32_t tail = ingress_tail.load(std::memory_order_relaxed);
+    uint32_t head = ingress_head.load(std::memory_order_acquire);
+
+    if (tail != head) {
+        ingressPacket_t* packet = &ingress_ring[tail & (INGRESS_RING_SIZE - 1)];
+
+        int length = packet->length;
+        if (length > msg->maxsize)
+            length = msg->maxsize;
+
+        *from = packet->from;
+        memcpy(msg->data, packet->data, length);
+        msg->cursize = length;
+        msg->readcount = 0;
+
+        ingress_lastPacketFromThread = true;
+        ingress_lastPacketFiltered = packet->filtered;
+
+        if (packet->filtered)
+            ingress_updateLanCache(packet->from);
+
+        ingress_tail.store(tail + 1, std::memory_order_release);
+        return 1;
+    }
+
+    ingress_lastPacketFromThread = false;
+    ingress_lastPacketFiltered = false;
+
+    if (ingress_threadRunning)
+        return 0;
+
+    int ret;
+    ASM_CALL(RETURN(ret), 0x080d5330, 2, PUSH(from), PUSH(msg));
+    return ret;
+}
+
+
+/** Called every frame on frame start. */
+void ingress_frame() {
+
+    if (sv_netThread->modified) {
+        sv_netThread->modified = false;
+
+        if (sv_netThread->value.boolean && !ingress_threadRunning)
+            ingress_startThread();
+        else if (!sv_netThread->value.boolean && ingress_threadRunning)
+            ingress_stopThread();
+    }
+
+    // Print the dropped packets once per second, the thread itself cant print anything
+    uint64_t now = ticks_ms();
+    if (ingress_threadRunning && now >= ingress_nextStatsTime) {
+        ingress_nextStatsTime = now + 1000;
+
+        uint32_t rateLimit = ingress_droppedRateLimit.exchange(0);
+        uint32_t overflow = ingress_droppedOverflow.exchange(0);
+        uint32_t oversize = ingress_droppedOversize.exchange(0);
+
+        if (rateLimit > 0)
+            Com_DPrintf("Ingress: rate limit exceeded, dropped %u requests\n", rateLimit);
+        if (overflow > 0)
+            Com_DPrintf("Ingress: queue is full, dropped %u packets\n", overflow);
+        if (oversize > 0)
+            Com_DPrintf("Ingress: dropped %u oversize packets\n", oversize);
+    }
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void ingress_init() {
+
+    // Receive packets in separate thread, connection-less requests are rate limited before they get into the game loop
+    sv_netThread = Dvar_RegisterBool("sv_netThread", false, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    sv_netThread->modified = true; // Force initial setting
+}
+
+/** Called before the entry point is called. Used to patch the memory. */
+void ingress_patch() {
+
+    patch_call(0x0806c5b3, (unsigned int)Sys_GetPacket); // NET_GetPacket
+}
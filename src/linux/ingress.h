@@ -0,0 +1,11 @@
+#ifndef INGRESS_H
+#define INGRESS_H
+
+bool ingress_isPacketFromThread();
+bool ingress_isPacketFiltered();
+bool ingress_isThreadRunning();
+void ingress_frame();
+void ingress_init();
+void ingress_patch();
+
+#endif // INGRESS_H
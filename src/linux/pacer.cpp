@@ -0,0 +1,222 @@
+#include "pacer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/prctl.h>
+
+#include "shared.h"
+#include "hibernate.h"
+#include "../shared/cod2_common.h"
+#include "../shared/cod2_dvars.h"
+#include "../shared/cod2_cmd.h"
+#include "../shared/cod2_server.h"
+
+#define sys_timeBase            (*(int*)0x0860af24)     // seconds of gettimeofday when Sys_Milliseconds was called first time
+#define com_lastFrameTime       (*(int*)0x081a226c)     // Sys_Milliseconds at the start of the last Com_Frame
+#define sv_timeResidual         (*(int*)0x08440210)     // milliseconds accumulated by SV_Frame until next server frame
+
+// Histogram with 25us buckets up to 50ms, longer times are counted in the last bucket
+#define PACER_BUCKET_US         25
+#define PACER_BUCKETS           2000
+// Sys_Milliseconds is based on gettimeofday, the wake up is a bit later so the millisecond is surely changed
+#define PACER_MARGIN_US         50
+// Minimum time left after the original sleep to sleep again, shorter time is slept at once until the frame start
+#define PACER_MIN_SLEEP_US      2000
+
+typedef struct {
+    uint32_t buckets[PACER_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+} pacerHistogram_t;
+
+dvar_t* sv_framePacer = NULL;
+
+// Time when the next server frame can be run by SV_Frame, 0 if the server is not running
+static uint64_t pacer_deadline = 0;
+static uint64_t pacer_frameStartTime = 0;
+static int pacer_frameStartSvsTime = 0;
+
+static pacerHistogram_t pacer_jitter;
+static pacerHistogram_t pacer_duration;
+static uint64_t pacer_statsStartTime = 0;
+static uint64_t pacer_statsFrameTime = 0; // time of the last server frame
+
+
+static void pacer_histogramAdd(pacerHistogram_t* histogram, uint64_t us) {
+    uint64_t bucket = us / PACER_BUCKET_US;
+    histogram->buckets[bucket < PACER_BUCKETS ? bucket : PACER_BUCKETS - 1]++;
+    histogram->count++;
+    if (us > histogram->max)
+        histogram->max = us > 0xffffffff ? 0xffffffff : (uint32_t)us;
+}
+
+// Upper bound of the bucket where the percentile is, never more than the maximum
+static uint32_t pacer_histogramPercentile(const pacerHistogram_t* histogram, int percent) {
+    if (histogram->count == 0)
+        return 0;
+
+    uint64_t rank = ((uint64_t)histogram->count * percent + 99) / 100;
+    uint64_t sum = 0;
+    for (int i = 0; i < PACER_BUCKETS; i++) {
+        sum += histogram->buckets[i];
+        if (sum >= rank) {
+            uint32_t us = (uint32_t)(i + 1) * PACER_BUCKET_US;
+            return us < histogram->max ? us : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+static void pacer_reset() {
+    memset(&pacer_jitter, 0, sizeof(pacer_jitter));
+    memset(&pacer_duration, 0, sizeof(pacer_duration));
+    pacer_statsStartTime = 0;
+    pacer_statsFrameTime = 0;
+}
+
+
+/**
+ * Get the monotonic time when SV_Frame will run next server frame.
+ * Server frame is run when the milliseconds added since last frame reach 1000 / sv_fps, so the deadline is the moment
+ * when Sys_Milliseconds changes to the required value.
+ */
+static uint64_t pacer_getDeadline() {
+    int frameMsec = 1000 / sv_fps->value.integer;
+    if (frameMsec <= 0)
+        frameMsec = 1;
+
+    int target = com_lastFrameTime + frameMsec - sv_timeResidual;
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint64_t now = ticks_us();
+
+    int msec = (tv.tv_sec - sys_timeBase) * 1000 + tv.tv_usec / 1000;
+    int64_t left = (int64_t)(target - msec) * 1000 - tv.tv_usec % 1000 + PACER_MARGIN_US;
+
+    return left > 0 ? now + left : now;
+}
+
+
+/**
+ * usleep
+ * Is called in the main loop before every Com_Frame with 5ms.
+ * When the pacer is enabled, the thread is woken up at the exact time when the next server frame is due.
+ * Packets are still processed at least every 5ms while waiting for the frame.
+ */
+static int pacer_sleep(useconds_t usec) {
+
+    // Empty server waits for packets instead
+    if (hibernate_sleep())
+        return 0;
+
+    if (!sv_framePacer->value.boolean || pacer_deadline == 0)
+        return usleep(usec);
+
+    uint64_t now = ticks_us();
+    if (now >= pacer_deadline)
+        return 0;
+
+    uint64_t wake = pacer_deadline;
+    if (pacer_deadline - now > (uint64_t)usec + PACER_MIN_SLEEP_US)
+        wake = now + usec;
+
+    struct timespec ts;
+    ts.tv_sec = wake / 1000000;
+    ts.tv_nsec = (wake % 1000000) * 1000;
+
+    // ticks_us uses the same clock
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+
+    return 0;
+}
+
+
+/** Called before original Com_Frame. */
+void pacer_frameBegin() {
+    pacer_frameStartTime = ticks_us();
+    pacer_frameStartSvsTime = svs_time;
+}
+
+/** Called after original Com_Frame. */
+void pacer_frameEnd() {
+
+    // Frames are not paced while hibernating
+    if (!sv_running || !sv_running->value.boolean || sv_fps == NULL || sv_fps->value.integer <= 0 || hibernate_isActive()) {
+        pacer_deadline = 0;
+        return;
+    }
+
+    // Server frame was run in this Com_Frame
+    if (svs_time != pacer_frameStartSvsTime && pacer_deadline != 0) {
+        uint64_t now = ticks_us();
+
+        pacer_histogramAdd(&pacer_jitter, pacer_frameStartTime > pacer_deadline ? pacer_frameStartTime - pacer_deadline : 0);
+        pacer_histogramAdd(&pacer_duration, now - pacer_frameStartTime);
+
+        if (pacer_statsStartTime == 0)
+            pacer_statsStartTime = pacer_frameStartTime;
+        pacer_statsFrameTime = pacer_frameStartTime;
+    }
+
+    pacer_deadline = pacer_getDeadline();
+}
+
+
+static void pacer_stats_command() {
+
+    if (Cmd_Argc() == 2 && Q_stricmp(Cmd_Argv(1), "reset") == 0) {
+        pacer_reset();
+        Com_Printf("Frame pacer statistics reset\n");
+        return;
+    }
+
+    int fps = sv_fps ? sv_fps->value.integer : 0;
+    double seconds = (double)(pacer_statsFrameTime - pacer_statsStartTime) / 1000000.0;
+    // Number of intervals between the first and last frame
+    double rate = seconds > 0 && pacer_jitter.count > 1 ? (pacer_jitter.count - 1) / seconds : 0;
+
+    Com_Printf("Frame pacer %s, sv_fps %i, %u frames in %.1f s (%.2f Hz)\n", sv_framePacer->value.boolean ? "enabled" : "disabled",
+        fps, pacer_jitter.count, seconds, rate);
+    Com_Printf("                    p50      p99      max\n");
+    Com_Printf("start jitter   %6u us %6u us %6u us\n",
+        pacer_histogramPercentile(&pacer_jitter, 50), pacer_histogramPercentile(&pacer_jitter, 99), pacer_jitter.max);
+    Com_Printf("frame duration %6u us %6u us %6u us\n",
+        pacer_histogramPercentile(&pacer_duration, 50), pacer_histogramPercentile(&pacer_duration, 99), pacer_duration.max);
+}
+
+
+/** Called every frame on frame start. */
+void pacer_frame() {
+
+    if (sv_framePacer->modified) {
+        sv_framePacer->modified = false;
+
+        // Timer slack of 1ns for the main thread, 0 sets the default 50us back
+        if (prctl(PR_SET_TIMERSLACK, sv_framePacer->value.boolean ? 1 : 0, 0, 0, 0) != 0)
+            Com_Printf("Frame pacer: failed to set timer slack: %s\n", strerror(errno));
+
+        pacer_reset();
+    }
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void pacer_init() {
+
+    // Main loop sleeps until the exact time of next server frame instead of fixed 5ms
+    sv_framePacer = Dvar_RegisterBool("sv_framePacer", false, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+    sv_framePacer->modified = true;
+
+    Cmd_AddCommand("framePacerStats", pacer_stats_command);
+}
+
+/** Called before the entry point is called. Used to patch the memory. */
+void pacer_patch() {
+
+    patch_call(0x080d510e, (unsigned int)pacer_sleep); // main
+}
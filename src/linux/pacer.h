@@ -0,0 +1,10 @@
+#ifndef PACER_H
+#define PACER_H
+
+void pacer_frameBegin();
+void pacer_frameEnd();
+void pacer_frame();
+void pacer_init();
+void pacer_patch();
+
+#endif // PACER_H
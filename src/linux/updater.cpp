@@ -14,9 +14,11 @@
 #include "../shared/cod2_dvars.h"
 #include "../shared/cod2_net.h"
 #include "../shared/cod2_cmd.h"
+#include "../shared/resolver.h"
 
 
 struct netaddr_s updater_address;
+bool updater_requestPending = false; // request is sent when the address is resolved
 
 dvar_t* sv_update;
 
@@ -68,15 +70,16 @@ void updater_downloadFile(const char* updateFile, const char* newVersionString)
 
 
 bool updater_sendRequest() {
-    Com_DPrintf("Resolving AutoUpdate Server %s...\n", SERVER_UPDATE_URI);
-    if (!NET_StringToAdr(SERVER_UPDATE_URI, &updater_address))
+    // Address is resolved in background, the request is sent from updater_frame when its resolved
+    resolverStatus_e resolved = resolver_lookup(SERVER_UPDATE_URI, SERVER_UPDATE_PORT, &updater_address);
+    updater_requestPending = (resolved == RESOLVER_PENDING);
+    if (resolved != RESOLVER_OK)
     {
-        Com_Printf("\nFailed to resolve AutoUpdate server %s.\n", SERVER_UPDATE_URI);
+        if (resolved == RESOLVER_FAILED)
+            Com_Printf("\nFailed to resolve AutoUpdate server %s.\n", SERVER_UPDATE_URI);
         return 0;
     }
 
-    updater_address.port = BigShort(SERVER_UPDATE_PORT); // Swap the port bytes
-
     Com_DPrintf("AutoUpdate resolved to %s\n", NET_AdrToString(updater_address));
 
     Com_Printf("Checking for updates...\n");
@@ -138,6 +141,14 @@ void updater_checkForUpdate() {
 }
 
 
+/** Called every frame on frame start. */
+void updater_frame() {
+    if (updater_requestPending) {
+        updater_checkForUpdate();
+    }
+}
+
+
 /** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
 void updater_init() {
     sv_update = Dvar_RegisterBool("sv_update", true, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
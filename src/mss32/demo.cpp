@@ -458,9 +458,6 @@ void demo_frame() {
         Dvar_SetString(cl_demoAutoRecordUploadUrl, ""); // Clear upload URL dvar
     }
 
-    if (demo_httpClient != nullptr)
-        demo_httpClient->poll();
-
     // Close the game if scheduled after upload is complete
     if (demo_isScheduledToCloseAfterUpload && !demo_isUploading && ticks_ms() > demo_uploadingHideAtTime) {
         Com_Printf("Demo upload complete, closing the game now.\n");
@@ -36,6 +36,17 @@
 #include "../shared/cod2_dvars.h"
 #include "../shared/gsc.h"
 #include "../shared/match.h"
+#include "../shared/query_cache.h"
+#include "../shared/capture.h"
+#include "../shared/challenge.h"
+#include "../shared/resolver.h"
+#include "../shared/net_reactor.h"
+#include "../shared/ban.h"
+#include "../shared/authorize_cache.h"
+#include "../shared/player_index.h"
+#include "../shared/player_interest.h"
+#include "../shared/netstats.h"
+#include "../shared/adaptive_snaps.h"
 
 HMODULE hModule;
 unsigned int gfx_module_addr;
@@ -82,6 +93,9 @@ void hook_Com_Frame()
             common_unload();
             radar_unload();
             demo_unload();
+            net_reactor_unload();
+            resolver_unload();
+            capture_unload();
 
             hotreload_loadDLL();
             return;
@@ -98,14 +112,22 @@ void hook_Com_Frame()
     // Shared & Server
     debug_frame();
     freeze_frame();
+    resolver_frame();
+    net_reactor_frame();
     updater_frame();
     hwid_frame();
     window_frame();
+    server_frame();
     gsc_frame();
     match_frame();
     registry_frame();      // called as last so other modules can handle version changes
     drawing_frame();
     iwd_frame();
+    query_cache_frame();
+    ban_frame();
+    authorize_cache_frame();
+    netstats_frame();
+    adaptive_snaps_frame();
     radar_frame();
     demo_frame();
     vmix_frame();
@@ -216,6 +238,8 @@ void hook_SV_Init() {
     // Shared & Server 
     freeze_init();
     common_init();
+    resolver_init();
+    net_reactor_init();
     server_init();
     dvar_init();
     updater_init();
@@ -223,6 +247,15 @@ void hook_SV_Init() {
     animation_init();
     match_init();
     iwd_init();
+    query_cache_init();
+    capture_init();
+    challenge_init();
+    ban_init();
+    authorize_cache_init();
+    player_index_init();
+    player_interest_init();
+    netstats_init();
+    adaptive_snaps_init();
 
     if (!DLL_HOTRELOAD) {
         ASM_CALL(RETURN_VOID, 0x004596d0);
@@ -312,6 +345,7 @@ bool hook_patch() {
     animation_patch();
     gsc_patch();
     iwd_patch();
+    query_cache_patch();
 
     
     // Patch black screen / long loading on game startup
@@ -11,6 +11,7 @@
 #include "../shared/cod2_net.h"
 #include "../shared/cod2_cmd.h"
 #include "../shared/cod2_shared.h"
+#include "../shared/resolver.h"
 
 
 #define cl_updateAvailable (*(dvar_t **)(0x0096b644))
@@ -205,21 +206,8 @@ bool updater_downloadAndReplaceDllFile(const char *url, char *errorBuffer, size_
 
 
 bool updater_resolveServerAddress() {
-    // Resolve the Auto-Update server address if not already resolved
-    if (updater_address.type == NA_INIT) 
-    {
-        Com_DPrintf("Resolving AutoUpdate Server %s...\n", SERVER_UPDATE_URI);
-        if (!NET_StringToAdr(SERVER_UPDATE_URI, &updater_address))
-        {
-            Com_Printf("\nFailed to resolve AutoUpdate server %s.\n", SERVER_UPDATE_URI);
-            return false;
-        }
-
-        updater_address.port = BigShort(SERVER_UPDATE_PORT); // Swap the port bytes
-
-        Com_DPrintf("AutoUpdate resolved to %s\n", NET_AdrToString(updater_address));
-    }
-    return true;
+    // Resolve the Auto-Update server address in background, the address type is NA_BAD until its resolved
+    return resolver_lookup(SERVER_UPDATE_URI, SERVER_UPDATE_PORT, &updater_address) == RESOLVER_OK;
 }
 
 
@@ -229,7 +217,12 @@ bool updater_resolveServerAddress() {
 bool updater_sendRequest() {
 
     // Resolve the Auto-Update server address if not already resolved
-    updater_resolveServerAddress();
+    // If its not resolved yet, the request is sent again after the response timeout in updater_frame
+    if (!updater_resolveServerAddress()) {
+        updater_waitingForResponse = true;
+        updater_waitingForResponseTime = GetTickCount();
+        return false;
+    }
 
     Com_Printf("Auto-Updater: Checking for updates...\n");
 
@@ -34,11 +34,11 @@ void vmix_send_command(std::string url) {
         url.c_str(),
         [url](const HttpClient::Response& res) {
             if (res.status != 200 && res.status != 201) {
-                Com_Printf("^1VMix %s failed, invalid status: %d\n%s\n", url.c_str(), res.status, res.body.c_str());
+                Com_Printf("^1VMix %s failed, invalid status: %d\n%s\n", url.c_str(), res.status, res.body.data());
                 return;
             }
             if (cl_vmix_debug->value.boolean) {
-                Com_Printf("^2VMix %s response: %d, %s\n", url.c_str(), res.status, res.body.c_str());
+                Com_Printf("^2VMix %s response: %d, %s\n", url.c_str(), res.status, res.body.data());
             }
         },
         [url](const std::string& error) {
@@ -71,8 +71,6 @@ void vmix_frame() {
             vmix_httpClient = new HttpClient();
         }
 
-        vmix_httpClient->poll();
-
         if (!cl_vmix_scr_spectatedUserId->modified && !cl_vmix_scr_spectatedHWID->modified) {
             return; // No change
         }
@@ -0,0 +1,216 @@
+#include "adaptive_snaps.h"
+
+#include <algorithm>
+
+#include "shared.h"
+#include "cod2_common.h"
+#include "cod2_cmd.h"
+#include "cod2_dvars.h"
+#include "cod2_server.h"
+#include "player_index.h"
+#include "netstats.h"
+
+#define ADAPTIVE_SNAPS_INTERVAL_MS  2000
+#define ADAPTIVE_SNAPS_MAX_RATE     90000   // same limit as in SV_UserinfoChanged
+#define ADAPTIVE_SNAPS_MAX_SNAPS    40
+#define ADAPTIVE_SNAPS_RATE_STEP    5000
+#define ADAPTIVE_SNAPS_SNAPS_STEP   5
+
+// Limits in percent, loss is measured on packets from client, choke is the part of snapshots delayed by rate
+#define ADAPTIVE_SNAPS_RAISE_LOSS   2
+#define ADAPTIVE_SNAPS_RAISE_CHOKE  5
+#define ADAPTIVE_SNAPS_LOWER_LOSS   5
+#define ADAPTIVE_SNAPS_LOWER_CHOKE  20
+
+typedef struct {
+    bool active;
+    // Values set by client in userinfo, the controller never goes below them
+    int baseRate;
+    int baseSnaps;
+    // Values set by controller
+    int rate;
+    int snaps;
+    // Measurement of last interval
+    int loss;
+    int choke;
+    int lastDropped;
+    int lastIncomingSequence;
+    char decision[32];
+} adaptiveSnapsClient_t;
+
+dvar_t* sv_adaptiveSnaps;
+
+static adaptiveSnapsClient_t adaptive_snaps_clients[MAX_CLIENTS];
+static uint64_t adaptive_snaps_nextTime = 0;
+
+
+/** Called from SV_UserinfoChanged when client changes rate or snaps, the controller starts again from client's values. */
+void adaptive_snaps_reset(int clientNum) {
+    if (!sv_adaptiveSnaps->value.boolean)
+        return;
+
+    adaptiveSnapsClient_t* state = &adaptive_snaps_clients[clientNum];
+    client_t* client = &svs_clients[clientNum];
+
+    int snaps = client->snapshotMsec > 0 ? 1000 / client->snapshotMsec : 20;
+
+    // Userinfo was changed but not rate or snaps, controlled values are kept (state is free on connect)
+    if (state->active && state->baseRate == client->rate && state->baseSnaps == snaps && client->state >= CS_CONNECTED) {
+        client->rate = state->rate;
+        client->snapshotMsec = 1000 / state->snaps;
+        return;
+    }
+
+    memset(state, 0, sizeof(*state));
+    state->active = true;
+    state->baseRate = state->rate = client->rate;
+    state->baseSnaps = state->snaps = snaps;
+    state->lastDropped = netstats_getDropped(clientNum);
+    state->lastIncomingSequence = client->netchan.incomingSequence;
+    Q_strncpyz(state->decision, "start", sizeof(state->decision));
+}
+
+static int adaptive_snaps_maxSnaps() {
+    #if COD2X_WIN32
+        dvar_t* sv_fps = Dvar_GetDvarByName("sv_fps");
+    #endif
+    int snaps = sv_fps ? sv_fps->value.integer : 20;
+    return snaps < ADAPTIVE_SNAPS_MAX_SNAPS ? snaps : ADAPTIVE_SNAPS_MAX_SNAPS;
+}
+
+static int adaptive_snaps_maxRate() {
+    dvar_t* sv_maxRate = Dvar_GetDvarByName("sv_maxRate");
+    if (sv_maxRate && sv_maxRate->value.integer > 0 && sv_maxRate->value.integer < ADAPTIVE_SNAPS_MAX_RATE)
+        return sv_maxRate->value.integer;
+    return ADAPTIVE_SNAPS_MAX_RATE;
+}
+
+static void adaptive_snaps_update(int clientNum, int maxRate, int maxSnaps) {
+    adaptiveSnapsClient_t* state = &adaptive_snaps_clients[clientNum];
+    client_t* client = &svs_clients[clientNum];
+
+    if (!state->active)
+        adaptive_snaps_reset(clientNum);
+
+    // Loss of packets from client, the sequence counts also the dropped packets
+    // Counters might be reset meanwhile by reconnect, the interval is skipped then
+    int droppedTotal = netstats_getDropped(clientNum);
+    int dropped = droppedTotal - state->lastDropped;
+    int sequences = client->netchan.incomingSequence - state->lastIncomingSequence;
+    state->lastDropped = droppedTotal;
+    state->lastIncomingSequence = client->netchan.incomingSequence;
+    state->loss = dropped > 0 && sequences > 0 ? std::min(100, dropped * 100 / sequences) : 0;
+
+    const netstatsValues_t* stats = netstats_get(clientNum);
+    state->choke = stats->snapshots > 0 ? stats->rateDelayed * 100 / stats->snapshots : 0;
+
+    int rate = state->rate;
+    int snaps = state->snaps;
+
+    if (state->loss >= ADAPTIVE_SNAPS_LOWER_LOSS || state->choke >= ADAPTIVE_SNAPS_LOWER_CHOKE) {
+        // Back off, the snapshots are lowered first as they cause the most of the traffic
+        if (snaps > state->baseSnaps)
+            snaps = std::max(state->baseSnaps, snaps - ADAPTIVE_SNAPS_SNAPS_STEP);
+        else
+            rate = std::max(state->baseRate, rate - ADAPTIVE_SNAPS_RATE_STEP);
+        Q_strncpyz(state->decision, "lower", sizeof(state->decision));
+
+    } else if (state->loss < ADAPTIVE_SNAPS_RAISE_LOSS && state->choke < ADAPTIVE_SNAPS_RAISE_CHOKE) {
+        // Rate is raised first so there is the budget for more snapshots
+        if (rate < maxRate && (stats->rateDelayed > 0 || snaps >= maxSnaps))
+            rate = std::min(maxRate, rate + ADAPTIVE_SNAPS_RATE_STEP);
+        else if (snaps < maxSnaps)
+            snaps = std::min(maxSnaps, snaps + ADAPTIVE_SNAPS_SNAPS_STEP);
+        else if (rate < maxRate)
+            rate = std::min(maxRate, rate + ADAPTIVE_SNAPS_RATE_STEP);
+        Q_strncpyz(state->decision, "raise", sizeof(state->decision));
+
+    } else {
+        Q_strncpyz(state->decision, "hold", sizeof(state->decision));
+    }
+
+    // Server limits might be lowered meanwhile
+    rate = std::min(rate, std::max(maxRate, state->baseRate));
+    snaps = std::min(snaps, std::max(maxSnaps, state->baseSnaps));
+
+    if (rate != state->rate || snaps != state->snaps) {
+        Com_DPrintf("Adaptive snaps: client %i %s rate %i -> %i, snaps %i -> %i (loss %i%%, choke %i%%)\n", clientNum, client->name,
+            state->rate, rate, state->snaps, snaps, state->loss, state->choke);
+    }
+
+    state->rate = rate;
+    state->snaps = snaps;
+    client->rate = rate;
+    client->snapshotMsec = 1000 / snaps;
+}
+
+// Restore the values set by clients
+static void adaptive_snaps_disable() {
+    for (int clientNum = 0; clientNum < MAX_CLIENTS; clientNum++) {
+        adaptiveSnapsClient_t* state = &adaptive_snaps_clients[clientNum];
+        if (state->active && svs_clients[clientNum].state >= CS_CONNECTED) {
+            svs_clients[clientNum].rate = state->baseRate;
+            svs_clients[clientNum].snapshotMsec = 1000 / state->baseSnaps;
+        }
+        state->active = false;
+    }
+}
+
+
+static void adaptive_snaps_status_command() {
+    Com_Printf("num name             base rate snaps  rate   snaps loss%% choke%% decision\n");
+    Com_Printf("--- ---------------- --------- ------ ------ ----- ----- ------ --------\n");
+    for (int i = 0; i < player_index_count; i++) {
+        int clientNum = player_index_clients[i];
+        adaptiveSnapsClient_t* state = &adaptive_snaps_clients[clientNum];
+        if (!state->active)
+            continue;
+        Com_Printf("%3i %-16.16s %9i %6i %6i %5i %5i %6i %s\n", clientNum, svs_clients[clientNum].name,
+            state->baseRate, state->baseSnaps, state->rate, state->snaps, state->loss, state->choke, state->decision);
+    }
+}
+
+
+/** Called every frame on frame start. */
+void adaptive_snaps_frame() {
+
+    if (sv_adaptiveSnaps->modified) {
+        sv_adaptiveSnaps->modified = false;
+        if (!sv_adaptiveSnaps->value.boolean && sv_running && sv_running->value.boolean)
+            adaptive_snaps_disable();
+    }
+
+    if (!sv_adaptiveSnaps->value.boolean || !sv_running || !sv_running->value.boolean)
+        return;
+
+    uint64_t now = ticks_ms();
+    if (now < adaptive_snaps_nextTime)
+        return;
+    adaptive_snaps_nextTime = now + ADAPTIVE_SNAPS_INTERVAL_MS;
+
+    int maxRate = adaptive_snaps_maxRate();
+    int maxSnaps = adaptive_snaps_maxSnaps();
+
+    for (int i = 0; i < player_index_count; i++) {
+        int clientNum = player_index_clients[i];
+        client_t* client = &svs_clients[clientNum];
+
+        // Bots and LAN clients without rate limit are not controlled
+        if (client->state != CS_ACTIVE || client->bIsTestClient || client->rate >= 99999) {
+            adaptive_snaps_clients[clientNum].active = false;
+            continue;
+        }
+
+        adaptive_snaps_update(clientNum, maxRate, maxSnaps);
+    }
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void adaptive_snaps_init() {
+
+    // Raise snaps and rate of clients up to the server maximum while their loss and choke are low, lower it when they rise
+    // Values set by the client are used as the minimum
+    sv_adaptiveSnaps = Dvar_RegisterBool("sv_adaptiveSnaps", false, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    Cmd_AddCommand("adaptiveSnapsStatus", adaptive_snaps_status_command);
+}
@@ -0,0 +1,8 @@
+#ifndef ADAPTIVE_SNAPS_H
+#define ADAPTIVE_SNAPS_H
+
+void adaptive_snaps_reset(int clientNum);
+void adaptive_snaps_frame();
+void adaptive_snaps_init();
+
+#endif
@@ -0,0 +1,165 @@
+#include "authorize_cache.h"
+
+#include "shared.h"
+#include "cod2_common.h"
+#include "cod2_shared.h"
+#include "cod2_dvars.h"
+#include "cod2_cmd.h"
+
+#define AUTHORIZE_CACHE_SIZE        1024    // power of 2
+#define AUTHORIZE_CACHE_PROBES      8       // entry is placed in one of following slots after its hash
+#define AUTHORIZE_CACHE_DENY_TTL    60      // deny might be caused by key in use, so it is cached for shorter time
+
+typedef struct {
+    bool used;
+    uint8_t ip[4];
+    uint32_t hash;
+    char PBguid[33];        // CD key hash sent by client in getchallenge
+    char response[16];      // accept, deny, demo
+    char info[64];          // KEY_IS_GOOD, INVALID_CDKEY, BANNED_CDKEY, ...
+    uint64_t expireTime;
+} authorizeCacheEntry_t;
+
+dvar_t* sv_authorizeCache;
+
+static authorizeCacheEntry_t authorize_cache_entries[AUTHORIZE_CACHE_SIZE];
+static uint32_t authorize_cache_hits = 0;
+static uint32_t authorize_cache_misses = 0;
+static uint32_t authorize_cache_stored = 0;
+static uint64_t authorize_cache_statsTime = 0;
+
+
+// FNV-1a of IP and CD key hash
+static uint32_t authorize_cache_hash(const uint8_t* ip, const char* PBguid) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 4; i++) {
+        hash ^= ip[i];
+        hash *= 16777619;
+    }
+    for (const char* c = PBguid; *c; c++) {
+        hash ^= (unsigned char)*c;
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static authorizeCacheEntry_t* authorize_cache_lookup(const uint8_t* ip, const char* PBguid, uint32_t hash) {
+    for (int n = 0; n < AUTHORIZE_CACHE_PROBES; n++) {
+        authorizeCacheEntry_t* entry = &authorize_cache_entries[(hash + n) & (AUTHORIZE_CACHE_SIZE - 1)];
+        if (entry->used && entry->hash == hash && memcmp(entry->ip, ip, 4) == 0 && strcmp(entry->PBguid, PBguid) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+
+/**
+ * Find the result of previous authorization of the client with same IP and CD key hash.
+ * Returns false if the authorize server needs to be asked.
+ */
+bool authorize_cache_find(netaddr_s adr, const char* PBguid, const char** response, const char** info) {
+    if (sv_authorizeCache->value.integer == 0 || adr.type != NA_IP || PBguid == NULL || PBguid[0] == '\0')
+        return false;
+
+    authorizeCacheEntry_t* entry = authorize_cache_lookup(adr.ip, PBguid, authorize_cache_hash(adr.ip, PBguid));
+    if (entry == NULL || ticks_ms() >= entry->expireTime) {
+        authorize_cache_misses++;
+        return false;
+    }
+
+    authorize_cache_hits++;
+    *response = entry->response;
+    *info = entry->info;
+    return true;
+}
+
+/** Save the response of the authorize server. */
+void authorize_cache_store(netaddr_s adr, const char* PBguid, const char* response, const char* info) {
+    if (sv_authorizeCache->value.integer == 0 || adr.type != NA_IP || PBguid == NULL || PBguid[0] == '\0')
+        return;
+
+    int ttl = sv_authorizeCache->value.integer;
+    if (Q_stricmp(response, "deny") == 0) {
+        // Client is waiting for key code authorization, next request might be accepted
+        if (Q_stricmp(info, "CLIENT_UNKNOWN_TO_AUTH") == 0)
+            return;
+        if (ttl > AUTHORIZE_CACHE_DENY_TTL)
+            ttl = AUTHORIZE_CACHE_DENY_TTL;
+    } else if (Q_stricmp(response, "accept") != 0) {
+        return;
+    }
+
+    uint64_t now = ticks_ms();
+    uint32_t hash = authorize_cache_hash(adr.ip, PBguid);
+
+    authorizeCacheEntry_t* entry = authorize_cache_lookup(adr.ip, PBguid, hash);
+    if (entry == NULL) {
+        // Free or expired slot, otherwise the entry that expires first is replaced
+        for (int n = 0; n < AUTHORIZE_CACHE_PROBES; n++) {
+            authorizeCacheEntry_t* slot = &authorize_cache_entries[(hash + n) & (AUTHORIZE_CACHE_SIZE - 1)];
+            if (!slot->used || now >= slot->expireTime) {
+                entry = slot;
+                break;
+            }
+            if (entry == NULL || slot->expireTime < entry->expireTime)
+                entry = slot;
+        }
+    }
+
+    entry->used = true;
+    memcpy(entry->ip, adr.ip, 4);
+    entry->hash = hash;
+    Q_strncpyz(entry->PBguid, PBguid, sizeof(entry->PBguid));
+    Q_strncpyz(entry->response, response, sizeof(entry->response));
+    Q_strncpyz(entry->info, info ? info : "", sizeof(entry->info));
+    entry->expireTime = now + (uint64_t)ttl * 1000;
+
+    authorize_cache_stored++;
+}
+
+void authorize_cache_clear() {
+    memset(authorize_cache_entries, 0, sizeof(authorize_cache_entries));
+}
+
+
+static void authorize_cache_stats_command() {
+    uint64_t now = ticks_ms();
+    double seconds = (now - authorize_cache_statsTime) / 1000.0;
+    authorize_cache_statsTime = now;
+
+    int entries = 0;
+    for (int i = 0; i < AUTHORIZE_CACHE_SIZE; i++) {
+        if (authorize_cache_entries[i].used && now < authorize_cache_entries[i].expireTime)
+            entries++;
+    }
+
+    uint32_t total = authorize_cache_hits + authorize_cache_misses;
+    Com_Printf("Authorize requests avoided: %u of %u (%.1f%%)\n", authorize_cache_hits, total, total > 0 ? authorize_cache_hits * 100.0 / total : 0.0);
+    Com_Printf("Responses stored: %u, cached clients: %i\n", authorize_cache_stored, entries);
+    Com_Printf("Statistics of last %.1f seconds\n", seconds);
+
+    authorize_cache_hits = 0;
+    authorize_cache_misses = 0;
+    authorize_cache_stored = 0;
+}
+
+
+/** Called every frame on frame start. */
+void authorize_cache_frame() {
+
+    if (sv_authorizeCache->modified) {
+        sv_authorizeCache->modified = false;
+        authorize_cache_clear();
+    }
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void authorize_cache_init() {
+
+    // Time in seconds how long the response of authorize server is reused for the same IP and CD key, 0 disables the cache
+    sv_authorizeCache = Dvar_RegisterInt("sv_authorizeCache", 600, 0, 86400, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    authorize_cache_statsTime = ticks_ms();
+
+    Cmd_AddCommand("authorizeCacheStats", authorize_cache_stats_command);
+}
@@ -0,0 +1,12 @@
+#ifndef AUTHORIZE_CACHE_H
+#define AUTHORIZE_CACHE_H
+
+#include "cod2_server.h"
+
+bool authorize_cache_find(netaddr_s adr, const char* PBguid, const char** response, const char** info);
+void authorize_cache_store(netaddr_s adr, const char* PBguid, const char* response, const char* info);
+void authorize_cache_clear();
+void authorize_cache_frame();
+void authorize_cache_init();
+
+#endif
@@ -0,0 +1,465 @@
+#include "ban.h"
+#include "ban_index.h"
+#include "shared.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#if COD2X_WIN32
+    #include <windows.h>
+#endif
+#if COD2X_LINUX
+    #include <unistd.h>
+    #include <sys/inotify.h>
+#endif
+
+#include "cod2_common.h"
+#include "cod2_shared.h"
+#include "cod2_dvars.h"
+#include "cod2_cmd.h"
+#include "cod2_file.h"
+
+#define BAN_FILE                "ban.txt"           // written by engine commands banUser / banClient
+#define BAN_JOURNAL_FILE        "ban_journal.txt"   // bans and unbans made by CoD2x commands
+#define BAN_CHECK_MS            1000                // ban.txt change check interval if inotify is not available
+#define BAN_COMPACT_MS          60000
+#define BAN_COMPACT_MIN_LINES   1024
+
+dvar_t* sv_banIndex;
+
+static banTable_t ban_table;
+static bool ban_loaded = false;
+static char ban_directory[MAX_OSPATH];
+static FILE* ban_journal = NULL;
+static int ban_journalLines = 0;
+static uint64_t ban_nextCheckTime = 0;
+static uint64_t ban_nextCompactTime = 0;
+static time_t ban_fileTime = 0;
+static off_t ban_fileSize = -1;
+
+#if COD2X_LINUX
+static int ban_inotify = -1;
+static int ban_watch = -1;
+#endif
+
+
+static uint32_t ban_now() {
+    return (uint32_t)(time_utc_ms() / 1000);
+}
+
+static char* ban_readFile(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* buffer = (char*)malloc(size + 1);
+    if (buffer != NULL) {
+        size = (long)fread(buffer, 1, size, file);
+        buffer[size] = '\0';
+    }
+    fclose(file);
+    return buffer;
+}
+
+static void ban_path(char* path, const char* filename) {
+    snprintf(path, MAX_OSPATH, "%s/%s", ban_directory, filename);
+}
+
+static void ban_updateFileStat() {
+    char path[MAX_OSPATH];
+    ban_path(path, BAN_FILE);
+
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        ban_fileTime = st.st_mtime;
+        ban_fileSize = st.st_size;
+    } else {
+        ban_fileTime = 0;
+        ban_fileSize = -1;
+    }
+}
+
+static void ban_journalWrite(const char* line);
+
+// Read ban.txt again, bans and unbans from journal are kept
+static void ban_reloadFile() {
+    for (uint32_t n = 0; n < ban_table.capacity; n++) {
+        ban_table.entries[n].wasInFile = ban_table.entries[n].inFile;
+        ban_table.entries[n].inFile = 0;
+    }
+
+    ban_updateFileStat();
+
+    char path[MAX_OSPATH];
+    ban_path(path, BAN_FILE);
+
+    int count = 0;
+    char* buffer = ban_readFile(path);
+    if (buffer != NULL) {
+        count = ban_parseFile(&ban_table, buffer);
+        free(buffer);
+    }
+
+    // HWID that was unbanned is banned again when new line with it is added to ban.txt, e.g. by banClient
+    // Record is written into journal, so the unban is not applied again when the journal is loaded
+    for (uint32_t n = 0; n < ban_table.capacity; n++) {
+        banEntry_t* entry = &ban_table.entries[n];
+        if (entry->state != BAN_SLOT_USED || entry->inFile <= entry->wasInFile || entry->journal != BAN_JOURNAL_UNBANNED)
+            continue;
+        entry->journal = BAN_JOURNAL_NONE;
+
+        char line[64];
+        snprintf(line, sizeof(line), "file %i\n", entry->hwid);
+        ban_journalWrite(line);
+    }
+
+    // Drop the entries that were only in old ban.txt
+    uint32_t capacity = BAN_MIN_CAPACITY;
+    while ((uint64_t)ban_table.count * 10 > (uint64_t)capacity * 5)
+        capacity *= 2;
+    if (!ban_tableRehash(&ban_table, capacity, true, ban_now()))
+        Com_Printf("Failed to allocate ban index with %u entries\n", capacity);
+
+    Com_DPrintf("Loaded %i bans from %s\n", count, BAN_FILE);
+}
+
+
+#if COD2X_LINUX
+static void ban_watchDirectory() {
+    if (ban_inotify == -1)
+        ban_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ban_inotify == -1)
+        return;
+
+    if (ban_watch != -1)
+        inotify_rm_watch(ban_inotify, ban_watch);
+
+    // Engine appends into the file and closes it, external tools usually replace the file by rename
+    ban_watch = inotify_add_watch(ban_inotify, ban_directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+    if (ban_watch == -1)
+        Com_DPrintf("Failed to watch directory %s for ban changes, polling is used\n", ban_directory);
+}
+
+// Read pending inotify events, returns true if ban.txt was changed
+static bool ban_readEvents() {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+
+    while (true) {
+        ssize_t len = read(ban_inotify, buffer, sizeof(buffer));
+        if (len <= 0)
+            break;
+        for (char* ptr = buffer; ptr < buffer + len; ) {
+            struct inotify_event* event = (struct inotify_event*)ptr;
+            if (event->len > 0 && strcmp(event->name, BAN_FILE) == 0)
+                changed = true;
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+#endif
+
+static bool ban_fileChanged() {
+    #if COD2X_LINUX
+        if (ban_watch != -1)
+            return ban_readEvents();
+    #endif
+
+    uint64_t now = ticks_ms();
+    if (now < ban_nextCheckTime)
+        return false;
+    ban_nextCheckTime = now + BAN_CHECK_MS;
+
+    time_t fileTime = ban_fileTime;
+    off_t fileSize = ban_fileSize;
+    ban_updateFileStat();
+    return fileTime != ban_fileTime || fileSize != ban_fileSize;
+}
+
+
+static bool ban_journalOpen(const char* mode) {
+    char path[MAX_OSPATH];
+    ban_path(path, BAN_JOURNAL_FILE);
+
+    if (ban_journal != NULL)
+        fclose(ban_journal);
+    ban_journal = fopen(path, mode);
+    if (ban_journal == NULL)
+        Com_Printf("Failed to open ban journal %s\n", path);
+    return ban_journal != NULL;
+}
+
+static void ban_journalWrite(const char* line) {
+    if (ban_journal == NULL && !ban_journalOpen("ab"))
+        return;
+    fputs(line, ban_journal);
+    fflush(ban_journal);
+    ban_journalLines++;
+}
+
+// Rewrite the journal with current bans only
+static void ban_compact() {
+    uint32_t now = ban_now();
+    char path[MAX_OSPATH];
+    char tempPath[MAX_OSPATH];
+    ban_path(path, BAN_JOURNAL_FILE);
+    ban_path(tempPath, BAN_JOURNAL_FILE ".tmp");
+
+    FILE* file = fopen(tempPath, "wb");
+    if (file == NULL) {
+        Com_Printf("Failed to compact ban journal, cannot write %s\n", tempPath);
+        return;
+    }
+
+    int lines = 0;
+    for (uint32_t n = 0; n < ban_table.capacity; n++) {
+        banEntry_t* entry = &ban_table.entries[n];
+        if (entry->state != BAN_SLOT_USED || ban_entryIsStale(entry, now))
+            continue;
+        if (ban_entryJournalBanned(entry, now)) {
+            fprintf(file, "ban %i %u\n", entry->hwid, entry->expire);
+            lines++;
+        } else if (entry->journal == BAN_JOURNAL_UNBANNED) {
+            fprintf(file, "unban %i\n", entry->hwid);
+            lines++;
+        }
+    }
+    bool ok = fflush(file) == 0;
+    fclose(file);
+
+    if (ban_journal != NULL) {
+        fclose(ban_journal);
+        ban_journal = NULL;
+    }
+
+    #if COD2X_WIN32
+        ok = ok && MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING);
+    #else
+        ok = ok && rename(tempPath, path) == 0;
+    #endif
+    if (!ok) {
+        Com_Printf("Failed to compact ban journal %s\n", path);
+        remove(tempPath);
+        return;
+    }
+
+    Com_DPrintf("Ban journal compacted from %i to %i lines\n", ban_journalLines, lines);
+    ban_journalLines = lines;
+}
+
+// Build the index from ban.txt and journal in current game directory
+static void ban_load() {
+    ban_tableFree(&ban_table);
+    ban_journalLines = 0;
+    ban_loaded = true;
+
+    ban_reloadFile();
+
+    char path[MAX_OSPATH];
+    ban_path(path, BAN_JOURNAL_FILE);
+
+    char* buffer = ban_readFile(path);
+    if (buffer != NULL) {
+        uint32_t now = ban_now();
+        for (char* line = strtok(buffer, "\r\n"); line != NULL; line = strtok(NULL, "\r\n")) {
+            ban_parseJournalLine(&ban_table, line, now);
+            ban_journalLines++;
+        }
+        free(buffer);
+    }
+
+    #if COD2X_LINUX
+        ban_watchDirectory();
+    #endif
+
+    ban_nextCompactTime = ticks_ms() + BAN_COMPACT_MS;
+
+    Com_DPrintf("Ban index loaded with %u entries\n", ban_table.count);
+}
+
+static void ban_unload() {
+    if (ban_journal != NULL) {
+        fclose(ban_journal);
+        ban_journal = NULL;
+    }
+    #if COD2X_LINUX
+        if (ban_inotify != -1 && ban_watch != -1)
+            inotify_rm_watch(ban_inotify, ban_watch);
+        ban_watch = -1;
+    #endif
+    ban_tableFree(&ban_table);
+    ban_loaded = false;
+}
+
+// Directory where the engine writes ban.txt
+static bool ban_updateDirectory() {
+    if (fs_homePath == NULL || fs_gamedir[0] == '\0')
+        return false;
+
+    char directory[MAX_OSPATH];
+    snprintf(directory, sizeof(directory), "%s/%s", fs_homePath->value.string, fs_gamedir);
+    if (strcmp(directory, ban_directory) == 0)
+        return true;
+
+    if (ban_loaded)
+        ban_unload();
+    Q_strncpyz(ban_directory, directory, sizeof(ban_directory));
+    return true;
+}
+
+static bool ban_ensureLoaded() {
+    if (!ban_updateDirectory())
+        return false;
+    if (!ban_loaded)
+        ban_load();
+    return true;
+}
+
+
+/** Bans are checked in memory index instead of reading ban.txt on every connect. */
+bool ban_isEnabled() {
+    return sv_banIndex && sv_banIndex->value.boolean;
+}
+
+/** Get the ban of HWID, engine temporary bans from tempBanUser / tempBanClient are not included. */
+banStatus_e ban_check(int hwid) {
+    if (!ban_ensureLoaded())
+        return BAN_NONE;
+
+    banEntry_t* entry = ban_tableFind(&ban_table, hwid);
+    if (entry == NULL)
+        return BAN_NONE;
+    return ban_entryStatus(entry, ban_now());
+}
+
+/** Ban the HWID, ban is temporary if minutes is positive. */
+bool ban_add(int hwid, int minutes) {
+    if (!ban_ensureLoaded())
+        return false;
+
+    banEntry_t* entry = ban_tableInsert(&ban_table, hwid);
+    if (entry == NULL)
+        return false;
+
+    entry->journal = BAN_JOURNAL_BANNED;
+    entry->expire = minutes > 0 ? ban_now() + (uint32_t)minutes * 60 : 0;
+
+    char line[64];
+    snprintf(line, sizeof(line), "ban %i %u\n", hwid, entry->expire);
+    ban_journalWrite(line);
+    return true;
+}
+
+/** Remove the ban of HWID, returns false if HWID is not banned. */
+bool ban_remove(int hwid) {
+    if (!ban_ensureLoaded())
+        return false;
+
+    banEntry_t* entry = ban_tableFind(&ban_table, hwid);
+    if (entry == NULL || ban_entryStatus(entry, ban_now()) == BAN_NONE)
+        return false;
+
+    // Ban from ban.txt is overridden, so the file does not have to be rewritten
+    entry->journal = BAN_JOURNAL_UNBANNED;
+    if (!entry->inFile)
+        ban_tableDelete(&ban_table, entry);
+
+    char line[64];
+    snprintf(line, sizeof(line), "unban %i\n", hwid);
+    ban_journalWrite(line);
+    return true;
+}
+
+/** Remove all bans made by CoD2x commands, ban.txt is expected to be removed by caller. */
+void ban_clear() {
+    if (!ban_ensureLoaded())
+        return;
+
+    ban_tableFree(&ban_table);
+    if (ban_journalOpen("wb")) {
+        fclose(ban_journal);
+        ban_journal = NULL;
+    }
+    ban_journalLines = 0;
+    ban_reloadFile();
+}
+
+
+static void ban_cmd_banHwid() {
+    if (Cmd_Argc() < 2 || Cmd_Argc() > 3) {
+        Com_Printf("Usage: banHwid <hwid> [minutes]\n");
+        return;
+    }
+
+    char* end;
+    long long hwid = strtoll(Cmd_Argv(1), &end, 10);
+    int minutes = Cmd_Argc() == 3 ? atoi(Cmd_Argv(2)) : 0;
+    if (*end != '\0' || minutes < 0) {
+        Com_Printf("Usage: banHwid <hwid> [minutes]\n");
+        return;
+    }
+
+    if (!ban_add((int)hwid, minutes)) {
+        Com_Printf("Error banning HWID %i\n", (int)hwid);
+        return;
+    }
+
+    if (minutes > 0)
+        Com_Printf("HWID %i banned for %i minutes\n", (int)hwid, minutes);
+    else
+        Com_Printf("HWID %i banned permanently\n", (int)hwid);
+    if (!ban_isEnabled())
+        Com_Printf("Warning: sv_banIndex is disabled, the ban is not applied\n");
+}
+
+static void ban_cmd_unbanHwid() {
+    if (Cmd_Argc() != 2) {
+        Com_Printf("Usage: unbanHwid <hwid>\n");
+        return;
+    }
+
+    int hwid = (int)strtoll(Cmd_Argv(1), NULL, 10);
+    if (ban_remove(hwid))
+        Com_Printf("HWID %i unbanned\n", hwid);
+    else
+        Com_Printf("HWID %i is not banned\n", hwid);
+}
+
+
+
+
+/** Called every frame on frame start. */
+void ban_frame() {
+    if (!ban_loaded)
+        return;
+
+    // Game directory changed, index is loaded again on next use
+    if (!ban_updateDirectory() || !ban_loaded)
+        return;
+
+    if (ban_fileChanged())
+        ban_reloadFile();
+
+    uint64_t now = ticks_ms();
+    if (now >= ban_nextCompactTime) {
+        ban_nextCompactTime = now + BAN_COMPACT_MS;
+        if (ban_journalLines >= BAN_COMPACT_MIN_LINES && (uint32_t)ban_journalLines > ban_table.count * 2)
+            ban_compact();
+    }
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void ban_init() {
+
+    // Bans from ban.txt and CoD2x journal are kept in memory, ban.txt is reloaded when changed
+    sv_banIndex = Dvar_RegisterBool("sv_banIndex", true, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    Cmd_AddCommand("banHwid", ban_cmd_banHwid);
+    Cmd_AddCommand("unbanHwid", ban_cmd_unbanHwid);
+}
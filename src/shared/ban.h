@@ -0,0 +1,18 @@
+#ifndef BAN_H
+#define BAN_H
+
+typedef enum {
+    BAN_NONE,
+    BAN_PERMANENT,
+    BAN_TEMPORARY,
+} banStatus_e;
+
+bool ban_isEnabled();
+banStatus_e ban_check(int hwid);
+bool ban_add(int hwid, int minutes);
+bool ban_remove(int hwid);
+void ban_clear();
+void ban_frame();
+void ban_init();
+
+#endif
@@ -0,0 +1,179 @@
+#include "ban_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static uint32_t ban_hash(int hwid) {
+    uint32_t h = (uint32_t)hwid;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+
+// Ban from journal is active, expired temporary ban falls back to ban.txt
+bool ban_entryJournalBanned(const banEntry_t* entry, uint32_t now) {
+    return entry->journal == BAN_JOURNAL_BANNED && (entry->expire == 0 || now < entry->expire);
+}
+
+banStatus_e ban_entryStatus(const banEntry_t* entry, uint32_t now) {
+    if (ban_entryJournalBanned(entry, now))
+        return entry->expire == 0 ? BAN_PERMANENT : BAN_TEMPORARY;
+    if (entry->journal == BAN_JOURNAL_UNBANNED)
+        return BAN_NONE;
+    return entry->inFile ? BAN_PERMANENT : BAN_NONE;
+}
+
+// Entry has no information that needs to be kept
+bool ban_entryIsStale(const banEntry_t* entry, uint32_t now) {
+    return !entry->inFile && !ban_entryJournalBanned(entry, now);
+}
+
+
+void ban_tableFree(banTable_t* table) {
+    free(table->entries);
+    memset(table, 0, sizeof(*table));
+}
+
+banEntry_t* ban_tableFind(const banTable_t* table, int hwid) {
+    if (table->count == 0)
+        return NULL;
+
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i = ban_hash(hwid) & mask;; i = (i + 1) & mask) {
+        banEntry_t* entry = &table->entries[i];
+        if (entry->state == BAN_SLOT_EMPTY)
+            return NULL;
+        if (entry->state == BAN_SLOT_USED && entry->hwid == hwid)
+            return entry;
+    }
+}
+
+// Move entries into new table, deleted slots are dropped together with stale entries if requested
+bool ban_tableRehash(banTable_t* table, uint32_t capacity, bool dropStale, uint32_t now) {
+    banEntry_t* entries = (banEntry_t*)calloc(capacity, sizeof(banEntry_t));
+    if (entries == NULL)
+        return false;
+
+    uint32_t mask = capacity - 1;
+    uint32_t count = 0;
+    for (uint32_t n = 0; n < table->capacity; n++) {
+        banEntry_t* entry = &table->entries[n];
+        if (entry->state != BAN_SLOT_USED || (dropStale && ban_entryIsStale(entry, now)))
+            continue;
+        uint32_t i = ban_hash(entry->hwid) & mask;
+        while (entries[i].state != BAN_SLOT_EMPTY)
+            i = (i + 1) & mask;
+        entries[i] = *entry;
+        count++;
+    }
+
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    table->count = count;
+    table->filled = count;
+    return true;
+}
+
+// Find the entry of HWID or create new one
+banEntry_t* ban_tableInsert(banTable_t* table, int hwid) {
+    banEntry_t* entry = ban_tableFind(table, hwid);
+    if (entry != NULL)
+        return entry;
+
+    // Keep the load factor under 70%
+    if ((uint64_t)(table->filled + 1) * 10 > (uint64_t)table->capacity * 7) {
+        uint32_t capacity = table->capacity ? table->capacity : BAN_MIN_CAPACITY;
+        while ((uint64_t)(table->count + 1) * 10 > (uint64_t)capacity * 5)
+            capacity *= 2;
+        if (!ban_tableRehash(table, capacity, false, 0))
+            return NULL;
+    }
+
+    uint32_t mask = table->capacity - 1;
+    uint32_t i = ban_hash(hwid) & mask;
+    while (table->entries[i].state == BAN_SLOT_USED)
+        i = (i + 1) & mask;
+
+    entry = &table->entries[i];
+    if (entry->state == BAN_SLOT_EMPTY)
+        table->filled++;
+    table->count++;
+
+    memset(entry, 0, sizeof(*entry));
+    entry->state = BAN_SLOT_USED;
+    entry->hwid = hwid;
+    return entry;
+}
+
+void ban_tableDelete(banTable_t* table, banEntry_t* entry) {
+    entry->state = BAN_SLOT_DELETED;
+    table->count--;
+}
+
+
+// Parse lines in format "<hwid> <name>" as they are written by the engine
+int ban_parseFile(banTable_t* table, const char* buffer) {
+    int count = 0;
+    const char* line = buffer;
+    while (*line) {
+        const char* next = strchr(line, '\n');
+        next = next ? next + 1 : line + strlen(line);
+
+        while (*line == ' ' || *line == '\t')
+            line++;
+
+        char* end;
+        long long hwid = strtoll(line, &end, 10);
+        if (end != line) {
+            banEntry_t* entry = ban_tableInsert(table, (int)hwid);
+            if (entry == NULL)
+                break;
+            if (entry->inFile < 0xffff)
+                entry->inFile++;
+            count++;
+        }
+
+        line = next;
+    }
+    return count;
+}
+
+// Apply one journal line "ban <hwid> <expire>", "unban <hwid>" or "file <hwid>"
+void ban_parseJournalLine(banTable_t* table, const char* line, uint32_t now) {
+    int hwid;
+    unsigned int expire;
+
+    if (sscanf(line, "ban %d %u", &hwid, &expire) == 2) {
+        banEntry_t* entry = ban_tableInsert(table, hwid);
+        if (entry == NULL)
+            return;
+        entry->journal = BAN_JOURNAL_BANNED;
+        entry->expire = expire;
+        if (ban_entryIsStale(entry, now))
+            ban_tableDelete(table, entry);
+
+    } else if (sscanf(line, "unban %d", &hwid) == 1) {
+        banEntry_t* entry = ban_tableFind(table, hwid);
+        if (entry == NULL)
+            return;
+        entry->journal = BAN_JOURNAL_UNBANNED;
+        if (ban_entryIsStale(entry, now))
+            ban_tableDelete(table, entry);
+
+    } else if (sscanf(line, "file %d", &hwid) == 1) {
+        // HWID was added to ban.txt again after unban, ban from ban.txt applies again
+        banEntry_t* entry = ban_tableFind(table, hwid);
+        if (entry == NULL || entry->journal != BAN_JOURNAL_UNBANNED)
+            return;
+        entry->journal = BAN_JOURNAL_NONE;
+        if (ban_entryIsStale(entry, now))
+            ban_tableDelete(table, entry);
+    }
+}
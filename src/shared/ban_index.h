@@ -0,0 +1,55 @@
+#ifndef BAN_INDEX_H
+#define BAN_INDEX_H
+
+#include <cstdint>
+
+#include "ban.h"
+
+// Engine independent part of the ban index - hash table of HWIDs and parsing of ban.txt and journal lines
+// It does not call any engine function, so it can be linked also into the offline benchmark (src/bench)
+
+#define BAN_MIN_CAPACITY        1024
+
+typedef enum {
+    BAN_SLOT_EMPTY,
+    BAN_SLOT_USED,
+    BAN_SLOT_DELETED,
+} banSlotState_e;
+
+typedef enum {
+    BAN_JOURNAL_NONE,       // ban from ban.txt applies
+    BAN_JOURNAL_BANNED,
+    BAN_JOURNAL_UNBANNED,   // ban from ban.txt was removed
+} banJournalState_e;
+
+typedef struct {
+    int hwid;
+    uint8_t state;          // banSlotState_e
+    uint8_t journal;        // banJournalState_e
+    uint16_t inFile;        // number of lines with HWID in ban.txt, banClient appends new line even if HWID is listed
+    uint16_t wasInFile;     // number of lines before reload
+    uint32_t expire;        // unix time when temporary ban from journal expires, 0 for permanent ban
+} banEntry_t;
+
+// Open addressing hash table with linear probing
+typedef struct {
+    banEntry_t* entries;
+    uint32_t capacity;      // power of 2
+    uint32_t count;         // used slots
+    uint32_t filled;        // used and deleted slots
+} banTable_t;
+
+bool ban_entryJournalBanned(const banEntry_t* entry, uint32_t now);
+banStatus_e ban_entryStatus(const banEntry_t* entry, uint32_t now);
+bool ban_entryIsStale(const banEntry_t* entry, uint32_t now);
+
+void ban_tableFree(banTable_t* table);
+banEntry_t* ban_tableFind(const banTable_t* table, int hwid);
+bool ban_tableRehash(banTable_t* table, uint32_t capacity, bool dropStale, uint32_t now);
+banEntry_t* ban_tableInsert(banTable_t* table, int hwid);
+void ban_tableDelete(banTable_t* table, banEntry_t* entry);
+
+int ban_parseFile(banTable_t* table, const char* buffer);
+void ban_parseJournalLine(banTable_t* table, const char* line, uint32_t now);
+
+#endif
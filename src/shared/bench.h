@@ -0,0 +1,35 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+
+// Helpers shared by the offline benchmarks (src/bench) and the DEBUG benchmark commands that need the memory of the game
+// It does not call any engine function
+
+#define BENCH_SEED      0x9e3779b9
+
+// xorshift32, fixed seed so the generated data is the same on each run
+inline uint32_t bench_xorshift(uint32_t* seed) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+inline uint64_t bench_ticks_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Parse the number of iterations, returns false if the value is not a positive number
+inline bool bench_parseCount(const char* value, int* count) {
+    char* end;
+    long long n = strtoll(value, &end, 10);
+    if (end == value || *end != '\0' || n < 1 || n > 0x7fffffff)
+        return false;
+    *count = (int)n;
+    return true;
+}
+
+#endif
@@ -0,0 +1,340 @@
+#include "capture.h"
+#include "shared.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#if COD2X_WIN32
+    #include <windows.h>
+#endif
+#if COD2X_LINUX
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+#include "cod2_common.h"
+#include "cod2_shared.h"
+#include "cod2_cmd.h"
+#include "cod2_dvars.h"
+#include "cod2_net.h"
+
+// Must be power of 2
+#define CAPTURE_RING_SIZE       4096
+// Longer packets are truncated, the original length is still saved in the pcap record
+#define CAPTURE_SNAPLEN         2048
+// pcap link type for raw IPv4 packets without link layer header
+#define CAPTURE_LINKTYPE_RAW    101
+
+typedef struct {
+    uint64_t time;              // UTC time in microseconds
+    netaddr_s addr;             // remote address
+    bool outbound;
+    int length;                 // original length
+    uint8_t data[CAPTURE_SNAPLEN];
+} capturePacket_t;
+
+typedef enum {
+    CAPTURE_FILTER_ALL,
+    CAPTURE_FILTER_OOB,         // only connection-less packets
+    CAPTURE_FILTER_ADDRESS,     // only packets from / to the address
+} captureFilter_e;
+
+volatile bool capture_active = false;
+
+// Single-producer single-consumer ring, head is written only by the main thread, tail only by the writer thread
+static capturePacket_t* capture_ring = NULL;
+static std::atomic<uint32_t> capture_head(0);
+static std::atomic<uint32_t> capture_tail(0);
+static std::atomic<uint32_t> capture_dropped(0);
+static uint32_t capture_written = 0;
+
+static FILE* capture_file = NULL;
+static char capture_fileName[256];
+static captureFilter_e capture_filter = CAPTURE_FILTER_ALL;
+static uint8_t capture_filterAddress[4];
+static uint8_t capture_localIp[4];
+static uint16_t capture_localPort = 0; // network order
+static uint64_t capture_timeBase = 0;  // UTC time in microseconds when ticks_us was capture_ticksBase
+static uint64_t capture_ticksBase = 0;
+static volatile bool capture_exitThread = false;
+
+#if COD2X_WIN32
+static HANDLE capture_thread = NULL;
+#endif
+#if COD2X_LINUX
+static pthread_t capture_thread;
+#endif
+
+
+/**
+ * Copy the packet into the ring, the file is written by the writer thread.
+ * Must be called only from main thread and only when capture_active is set.
+ */
+void capture_packet(bool outbound, netaddr_s addr, const void* data, int length) {
+
+    if (addr.type != NA_IP || length <= 0)
+        return;
+
+    if (capture_filter == CAPTURE_FILTER_OOB && (length < 4 || *(int*)data != -1))
+        return;
+    if (capture_filter == CAPTURE_FILTER_ADDRESS && memcmp(addr.ip, capture_filterAddress, 4) != 0)
+        return;
+
+    uint32_t head = capture_head.load(std::memory_order_relaxed);
+    uint32_t tail = capture_tail.load(std::memory_order_acquire);
+    if (head - tail >= CAPTURE_RING_SIZE) {
+        capture_dropped++;
+        return;
+    }
+
+    capturePacket_t* packet = &capture_ring[head & (CAPTURE_RING_SIZE - 1)];
+    packet->time = capture_timeBase + (ticks_us() - capture_ticksBase);
+    packet->addr = addr;
+    packet->outbound = outbound;
+    packet->length = length;
+    memcpy(packet->data, data, length < CAPTURE_SNAPLEN ? length : CAPTURE_SNAPLEN);
+
+    capture_head.store(head + 1, std::memory_order_release);
+}
+
+
+static uint16_t capture_ipChecksum(const uint8_t* header, int length) {
+    uint32_t sum = 0;
+    for (int i = 0; i < length; i += 2)
+        sum += (header[i] << 8) | header[i + 1];
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// Write pcap record with IPv4 and UDP header, the local address is used as source for outbound packets
+static void capture_writePacket(capturePacket_t* packet) {
+    int captured = packet->length < CAPTURE_SNAPLEN ? packet->length : CAPTURE_SNAPLEN;
+    int ipLength = 20 + 8 + packet->length;
+
+    uint32_t record[4];
+    record[0] = (uint32_t)(packet->time / 1000000);
+    record[1] = (uint32_t)(packet->time % 1000000);
+    record[2] = 20 + 8 + captured;
+    record[3] = ipLength;
+    fwrite(record, sizeof(record), 1, capture_file);
+
+    uint8_t header[28];
+    memset(header, 0, sizeof(header));
+    header[0] = 0x45;                       // IPv4, 20 bytes header
+    header[2] = (uint8_t)(ipLength >> 8);
+    header[3] = (uint8_t)(ipLength);
+    header[8] = 64;                         // TTL
+    header[9] = 17;                         // UDP
+    memcpy(header + 12, packet->outbound ? capture_localIp : packet->addr.ip, 4);
+    memcpy(header + 16, packet->outbound ? packet->addr.ip : capture_localIp, 4);
+    uint16_t checksum = capture_ipChecksum(header, 20);
+    header[10] = (uint8_t)(checksum >> 8);
+    header[11] = (uint8_t)(checksum);
+
+    // Ports are already in network order, UDP checksum is optional for IPv4
+    uint16_t srcPort = packet->outbound ? capture_localPort : packet->addr.port;
+    uint16_t dstPort = packet->outbound ? packet->addr.port : capture_localPort;
+    memcpy(header + 20, &srcPort, 2);
+    memcpy(header + 22, &dstPort, 2);
+    header[24] = (uint8_t)((8 + packet->length) >> 8);
+    header[25] = (uint8_t)(8 + packet->length);
+
+    fwrite(header, sizeof(header), 1, capture_file);
+    fwrite(packet->data, captured, 1, capture_file);
+}
+
+static void capture_writeRing() {
+    uint32_t tail = capture_tail.load(std::memory_order_relaxed);
+    uint32_t head = capture_head.load(std::memory_order_acquire);
+
+    if (tail == head)
+        return;
+
+    for (; tail != head; tail++) {
+        capture_writePacket(&capture_ring[tail & (CAPTURE_RING_SIZE - 1)]);
+        capture_written++;
+    }
+    capture_tail.store(tail, std::memory_order_release);
+
+    fflush(capture_file);
+}
+
+#if COD2X_WIN32
+static DWORD WINAPI capture_threadProc(LPVOID arg) {
+#else
+static void* capture_threadProc(void* arg) {
+#endif
+    (void)arg;
+
+    while (!capture_exitThread) {
+        capture_writeRing();
+        #if COD2X_WIN32
+            Sleep(10);
+        #else
+            usleep(10000);
+        #endif
+    }
+
+    // Write the rest of the packets after the capture was stopped
+    capture_writeRing();
+
+    return 0;
+}
+
+
+static void capture_stop() {
+    capture_active = false;
+
+    capture_exitThread = true;
+    #if COD2X_WIN32
+        WaitForSingleObject(capture_thread, INFINITE);
+        CloseHandle(capture_thread);
+        capture_thread = NULL;
+    #else
+        pthread_join(capture_thread, NULL);
+    #endif
+
+    fclose(capture_file);
+    capture_file = NULL;
+
+    free(capture_ring);
+    capture_ring = NULL;
+
+    Com_Printf("Capture stopped, %u packets written to '%s', %u packets dropped\n", capture_written, capture_fileName, capture_dropped.load());
+}
+
+static bool capture_start(const char* fileName) {
+
+    capture_file = fopen(fileName, "wb");
+    if (capture_file == NULL) {
+        Com_Printf("Failed to open '%s' for writing\n", fileName);
+        return false;
+    }
+
+    // pcap global header
+    uint32_t header[6] = { 0xa1b2c3d4, 0x00040002, 0, 0, 65535, CAPTURE_LINKTYPE_RAW };
+    fwrite(header, sizeof(header), 1, capture_file);
+
+    capture_ring = (capturePacket_t*)malloc(sizeof(capturePacket_t) * CAPTURE_RING_SIZE);
+    if (capture_ring == NULL) {
+        fclose(capture_file);
+        capture_file = NULL;
+        Com_Printf("Failed to allocate capture buffer\n");
+        return false;
+    }
+
+    Q_strncpyz(capture_fileName, fileName, sizeof(capture_fileName));
+    capture_head = 0;
+    capture_tail = 0;
+    capture_dropped = 0;
+    capture_written = 0;
+    capture_exitThread = false;
+
+    // Local address of the server, 0.0.0.0 if its not set
+    const char* ip = Dvar_GetString("net_ip");
+    int a, b, c, d;
+    memset(capture_localIp, 0, 4);
+    if (ip != NULL && sscanf(ip, "%i.%i.%i.%i", &a, &b, &c, &d) == 4) {
+        capture_localIp[0] = a; capture_localIp[1] = b; capture_localIp[2] = c; capture_localIp[3] = d;
+    }
+    uint16_t port = (uint16_t)Dvar_GetInt("net_port");
+    capture_localPort = (uint16_t)((port >> 8) | (port << 8));
+
+    capture_timeBase = time_utc_ms() * 1000;
+    capture_ticksBase = ticks_us();
+
+    #if COD2X_WIN32
+        capture_thread = CreateThread(NULL, 0, capture_threadProc, NULL, 0, NULL);
+        bool threadCreated = capture_thread != NULL;
+    #else
+        bool threadCreated = pthread_create(&capture_thread, NULL, capture_threadProc, NULL) == 0;
+    #endif
+    if (!threadCreated) {
+        fclose(capture_file);
+        capture_file = NULL;
+        free(capture_ring);
+        capture_ring = NULL;
+        Com_Printf("Failed to create capture thread\n");
+        return false;
+    }
+
+    capture_active = true;
+    return true;
+}
+
+
+/**
+ * net_capture <file> [filter]
+ * net_capture stop
+ * Capture game traffic into pcap file. Filter is "oob" for connection-less packets only or IP address.
+ */
+static void capture_command() {
+
+    if (Cmd_Argc() < 2) {
+        if (capture_active)
+            Com_Printf("Capturing into '%s', %u packets written, %u packets dropped\n", capture_fileName, capture_written, capture_dropped.load());
+        Com_Printf("Usage: net_capture <file> [oob | <ip address>]\n");
+        Com_Printf("       net_capture stop\n");
+        return;
+    }
+
+    if (Q_stricmp(Cmd_Argv(1), "stop") == 0) {
+        if (!capture_active) {
+            Com_Printf("Capture is not running\n");
+            return;
+        }
+        capture_stop();
+        return;
+    }
+
+    if (capture_active) {
+        Com_Printf("Capture is already running, use 'net_capture stop' first\n");
+        return;
+    }
+
+    // Only file name in the current directory is allowed, as the command might be called via rcon
+    const char* name = Cmd_Argv(1);
+    if (strchr(name, '/') != NULL || strchr(name, '\\') != NULL || strchr(name, ':') != NULL || strstr(name, "..") != NULL) {
+        Com_Printf("Invalid file name '%s', path is not allowed\n", name);
+        return;
+    }
+    char fileName[256];
+    const char* ext = strrchr(name, '.');
+    if (ext != NULL && Q_stricmp(ext, ".pcap") == 0)
+        snprintf(fileName, sizeof(fileName), "%s", name);
+    else
+        snprintf(fileName, sizeof(fileName), "%s.pcap", name);
+
+    capture_filter = CAPTURE_FILTER_ALL;
+    if (Cmd_Argc() >= 3) {
+        const char* filter = Cmd_Argv(2);
+        int a, b, c, d;
+        if (Q_stricmp(filter, "oob") == 0) {
+            capture_filter = CAPTURE_FILTER_OOB;
+        } else if (sscanf(filter, "%i.%i.%i.%i", &a, &b, &c, &d) == 4) {
+            capture_filter = CAPTURE_FILTER_ADDRESS;
+            capture_filterAddress[0] = a; capture_filterAddress[1] = b; capture_filterAddress[2] = c; capture_filterAddress[3] = d;
+        } else {
+            Com_Printf("Invalid filter '%s', expected 'oob' or IP address\n", filter);
+            return;
+        }
+    }
+
+    if (capture_start(fileName))
+        Com_Printf("Capturing into '%s'\n", fileName);
+}
+
+
+/** Called on game shutdown and when DLL hot-reloading is activated. The capture thread must not run the code of the unloaded DLL. */
+void capture_unload() {
+    if (capture_active)
+        capture_stop();
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void capture_init() {
+
+    Cmd_AddCommand("net_capture", capture_command);
+}
@@ -0,0 +1,12 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <cstdint>
+
+extern volatile bool capture_active;
+
+void capture_packet(bool outbound, struct netaddr_s addr, const void* data, int length);
+void capture_unload();
+void capture_init();
+
+#endif
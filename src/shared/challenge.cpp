@@ -0,0 +1,434 @@
+#include "challenge.h"
+
+#include <openssl/hmac.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <algorithm>
+
+#include "shared.h"
+#include "cod2_common.h"
+#include "cod2_dvars.h"
+#include "cod2_cmd.h"
+#include "cod2_net.h"
+#include "cod2_server.h"
+#include "bench.h"
+
+// Challenge is valid in the time bucket it was generated in and in the next one, so 1 - 2 minutes
+#define CHALLENGE_BUCKET_MS     60000
+#define CHALLENGE_SECRET_SIZE   32
+// Number of chains of the indexes, must be power of 2
+#define CHALLENGE_HASH_SIZE     1024
+
+dvar_t* sv_challengeStateless;
+
+static unsigned char challenge_secret[CHALLENGE_SECRET_SIZE];
+static bool challenge_secretValid = false;
+
+// Indexes of svs_challenges by address and by challenge number, chained by slot, -1 ends the chain
+// Entries are compared with svs_challenges when found, so entries changed by the engine are not returned
+static uint32_t challenge_hashSeed = 0;
+static int16_t challenge_addressHead[CHALLENGE_HASH_SIZE];
+static int16_t challenge_numberHead[CHALLENGE_HASH_SIZE];
+static int16_t challenge_addressNext[MAX_CHALLENGES];
+static int16_t challenge_numberNext[MAX_CHALLENGES];
+static uint16_t challenge_addressChain[MAX_CHALLENGES];
+static uint16_t challenge_numberChain[MAX_CHALLENGES];
+static bool challenge_indexed[MAX_CHALLENGES];
+
+// Slots ordered by time of creation, cleared slots are at the head, so the head is the entry with lowest time
+static int16_t challenge_older[MAX_CHALLENGES];
+static int16_t challenge_newer[MAX_CHALLENGES];
+static int16_t challenge_oldest = -1;
+static int16_t challenge_newest = -1;
+
+
+/**
+ * Returns true if challenges are derived from the client address instead of random numbers.
+ */
+bool challenge_isStateless() {
+    return challenge_secretValid && sv_challengeStateless->value.boolean;
+}
+
+
+static int challenge_hmac(netaddr_s adr, uint32_t bucket) {
+    unsigned char data[11];
+    memcpy(data, adr.ip, 4);
+    memcpy(data + 4, &adr.port, 2);
+    data[6] = (unsigned char)adr.type;
+    memcpy(data + 7, &bucket, 4);
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLength = 0;
+    HMAC(EVP_sha256(), challenge_secret, sizeof(challenge_secret), data, sizeof(data), digest, &digestLength);
+
+    // Zero is the challenge of empty svs_challenges entries, negative numbers are avoided to keep it same as "%i" in all messages
+    int challenge;
+    memcpy(&challenge, digest, sizeof(challenge));
+    challenge &= 0x7fffffff;
+    if (challenge == 0)
+        challenge = 1;
+
+    return challenge;
+}
+
+
+/**
+ * Challenge of the address as HMAC of the address and current time bucket with server secret.
+ * The client gets it only in challengeResponse, so a connect with valid challenge proves the client passed the authorization.
+ */
+int challenge_generate(netaddr_s adr) {
+    return challenge_hmac(adr, (uint32_t)(ticks_ms() / CHALLENGE_BUCKET_MS));
+}
+
+
+/**
+ * Verify the challenge without looking up svs_challenges.
+ */
+bool challenge_verify(netaddr_s adr, int challenge) {
+    if (!challenge_secretValid)
+        return false;
+
+    uint32_t bucket = (uint32_t)(ticks_ms() / CHALLENGE_BUCKET_MS);
+
+    return challenge == challenge_hmac(adr, bucket) || challenge == challenge_hmac(adr, bucket - 1);
+}
+
+
+static uint32_t challenge_mix(uint32_t hash) {
+    hash ^= challenge_hashSeed;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// Must give the same hash for addresses equal by NET_CompareAdr
+static uint32_t challenge_hashAddress(const netaddr_s* adr) {
+    uint32_t hash = adr->type;
+    if (adr->type == NA_IP) {
+        uint32_t ip;
+        memcpy(&ip, adr->ip, 4);
+        hash = challenge_mix(hash ^ ip) ^ adr->port;
+    } else if (adr->type == NA_IPX) {
+        for (int i = 0; i < 10; i++)
+            hash = hash * 31 + adr->ipx[i];
+        hash ^= adr->port;
+    }
+    return challenge_mix(hash) & (CHALLENGE_HASH_SIZE - 1);
+}
+
+static uint32_t challenge_hashNumber(int challenge) {
+    return challenge_mix((uint32_t)challenge) & (CHALLENGE_HASH_SIZE - 1);
+}
+
+
+static void challenge_unlinkChain(int16_t* head, int16_t* next, int slot) {
+    for (int16_t* link = head; *link != -1; link = &next[*link]) {
+        if (*link == slot) {
+            *link = next[slot];
+            break;
+        }
+    }
+    next[slot] = -1;
+}
+
+static void challenge_unindex(int slot) {
+    if (!challenge_indexed[slot])
+        return;
+    challenge_unlinkChain(&challenge_addressHead[challenge_addressChain[slot]], challenge_addressNext, slot);
+    challenge_unlinkChain(&challenge_numberHead[challenge_numberChain[slot]], challenge_numberNext, slot);
+    challenge_indexed[slot] = false;
+}
+
+static void challenge_unlinkTime(int slot) {
+    if (challenge_older[slot] != -1)
+        challenge_newer[challenge_older[slot]] = challenge_newer[slot];
+    else
+        challenge_oldest = challenge_newer[slot];
+
+    if (challenge_newer[slot] != -1)
+        challenge_older[challenge_newer[slot]] = challenge_older[slot];
+    else
+        challenge_newest = challenge_older[slot];
+
+    challenge_older[slot] = -1;
+    challenge_newer[slot] = -1;
+}
+
+static void challenge_pushNewest(int slot) {
+    challenge_older[slot] = challenge_newest;
+    challenge_newer[slot] = -1;
+    if (challenge_newest != -1)
+        challenge_newer[challenge_newest] = slot;
+    else
+        challenge_oldest = slot;
+    challenge_newest = slot;
+}
+
+static void challenge_pushOldest(int slot) {
+    challenge_newer[slot] = challenge_oldest;
+    challenge_older[slot] = -1;
+    if (challenge_oldest != -1)
+        challenge_older[challenge_oldest] = slot;
+    else
+        challenge_newest = slot;
+    challenge_oldest = slot;
+}
+
+
+/**
+ * Update the indexes after address or challenge number of the entry was changed.
+ * Entries with zero challenge are empty and are not indexed.
+ */
+void challenge_update(int slot) {
+    challenge_unindex(slot);
+
+    challenge_t* entry = &svs_challenges[slot];
+    if (entry->challenge == 0)
+        return;
+
+    uint32_t chain = challenge_hashAddress(&entry->adr);
+    challenge_addressChain[slot] = chain;
+    challenge_addressNext[slot] = challenge_addressHead[chain];
+    challenge_addressHead[chain] = slot;
+
+    chain = challenge_hashNumber(entry->challenge);
+    challenge_numberChain[slot] = chain;
+    challenge_numberNext[slot] = challenge_numberHead[chain];
+    challenge_numberHead[chain] = slot;
+
+    challenge_indexed[slot] = true;
+}
+
+/**
+ * Returns the entry with lowest time and marks it as the newest one.
+ * The caller must set the time to svs_time and call challenge_update after the address and challenge are set.
+ */
+int challenge_allocate() {
+    int slot = challenge_oldest;
+    challenge_unindex(slot);
+    challenge_unlinkTime(slot);
+    challenge_pushNewest(slot);
+    return slot;
+}
+
+/**
+ * Clear the entry, replaces memset of svs_challenges entry.
+ */
+void challenge_clear(int slot) {
+    challenge_unindex(slot);
+    memset(&svs_challenges[slot], 0, sizeof(svs_challenges[slot]));
+    challenge_unlinkTime(slot);
+    challenge_pushOldest(slot);
+}
+
+/**
+ * Find the entry of the address that is not connected yet. Returns -1 if not found.
+ */
+int challenge_findByAddress(netaddr_s adr) {
+    for (int slot = challenge_addressHead[challenge_hashAddress(&adr)]; slot != -1; slot = challenge_addressNext[slot]) {
+        if (!svs_challenges[slot].connected && NET_CompareAdr(adr, svs_challenges[slot].adr))
+            return slot;
+    }
+    return -1;
+}
+
+/**
+ * Find the entry of the address with the challenge number. Returns -1 if not found.
+ */
+int challenge_find(netaddr_s adr, int challenge) {
+    for (int slot = challenge_numberHead[challenge_hashNumber(challenge)]; slot != -1; slot = challenge_numberNext[slot]) {
+        if (svs_challenges[slot].challenge == challenge && NET_CompareAdr(adr, svs_challenges[slot].adr))
+            return slot;
+    }
+    return -1;
+}
+
+/**
+ * Find the entry with the challenge number. Returns -1 if not found.
+ */
+int challenge_findByNumber(int challenge) {
+    for (int slot = challenge_numberHead[challenge_hashNumber(challenge)]; slot != -1; slot = challenge_numberNext[slot]) {
+        if (svs_challenges[slot].challenge == challenge)
+            return slot;
+    }
+    return -1;
+}
+
+/**
+ * Build the indexes again from svs_challenges, used when the entries were changed by the engine.
+ */
+void challenge_rebuild() {
+    memset(challenge_addressHead, 0xff, sizeof(challenge_addressHead));
+    memset(challenge_numberHead, 0xff, sizeof(challenge_numberHead));
+    memset(challenge_indexed, 0, sizeof(challenge_indexed));
+    challenge_oldest = -1;
+    challenge_newest = -1;
+
+    static int16_t slots[MAX_CHALLENGES];
+    for (int i = 0; i < MAX_CHALLENGES; i++)
+        slots[i] = i;
+    std::stable_sort(slots, slots + MAX_CHALLENGES, [](int16_t a, int16_t b) { return svs_challenges[a].time < svs_challenges[b].time; });
+
+    for (int i = 0; i < MAX_CHALLENGES; i++) {
+        challenge_pushNewest(slots[i]);
+        challenge_update(slots[i]);
+    }
+}
+
+
+/**
+ * Store the verified challenge into svs_challenges again if its entry was overwritten by other clients (for example by challenge flood),
+ * because the original SV_DirectConnect reads the entry.
+ * Authorization status and CD-key hash of the client are not known anymore, so they are empty.
+ * Returns index of the entry.
+ */
+int challenge_restore(netaddr_s adr, int challenge) {
+    int oldest = challenge_allocate();
+
+    challenge_t* entry = &svs_challenges[oldest];
+    memset(entry, 0, sizeof(*entry));
+    entry->adr = adr;
+    entry->challenge = challenge;
+    entry->time = svs_time;
+    entry->firstTime = svs_time;
+    entry->pingTime = svs_time;
+    challenge_update(oldest);
+
+    Com_DPrintf("Restored challenge of %s\n", NET_AdrToString(adr));
+
+    return oldest;
+}
+
+
+#if DEBUG
+/**
+ * Measure lookups of connect and getchallenge requests with all challenges used, compared to the original loops.
+ * It runs in the game because the index works on svs_challenges of the engine. Challenges are restored after the benchmark.
+ * USAGE: challengeBench [requests]
+ */
+static void challenge_bench() {
+    int count = 1000000;
+    if (Cmd_Argc() > 2 || (Cmd_Argc() == 2 && !bench_parseCount(Cmd_Argv(1), &count))) {
+        Com_Printf("Usage: challengeBench [requests]\n");
+        return;
+    }
+
+    challenge_t* backup = (challenge_t*)malloc(sizeof(svs_challenges));
+    if (backup == NULL)
+        return;
+    memcpy(backup, svs_challenges, sizeof(svs_challenges));
+
+    uint32_t seed = BENCH_SEED;
+    auto random = [&seed]() { return bench_xorshift(&seed); };
+
+    // All challenges are used by clients in the middle of the handshake
+    memset(svs_challenges, 0, sizeof(svs_challenges));
+    for (int i = 0; i < MAX_CHALLENGES; i++) {
+        challenge_t* entry = &svs_challenges[i];
+        entry->adr.type = NA_IP;
+        uint32_t ip = random();
+        memcpy(entry->adr.ip, &ip, 4);
+        entry->adr.port = (uint16_t)random();
+        entry->challenge = (random() & 0x7fffffff) | 1;
+        entry->time = i + 1;
+    }
+    challenge_rebuild();
+
+    // Connect: find the challenge of the address
+    int found = 0;
+    uint64_t start = bench_ticks_ns();
+    for (int n = 0; n < count; n++) {
+        challenge_t* entry = &svs_challenges[random() & (MAX_CHALLENGES - 1)];
+        if (challenge_find(entry->adr, entry->challenge) != -1)
+            found++;
+    }
+    uint64_t indexConnect = bench_ticks_ns() - start;
+
+    start = bench_ticks_ns();
+    for (int n = 0; n < count; n++) {
+        challenge_t* entry = &svs_challenges[random() & (MAX_CHALLENGES - 1)];
+        int i;
+        for (i = 0; i < MAX_CHALLENGES; i++) {
+            if (NET_CompareAdr(entry->adr, svs_challenges[i].adr) && entry->challenge == svs_challenges[i].challenge)
+                break;
+        }
+        if (i != MAX_CHALLENGES)
+            found++;
+    }
+    uint64_t loopConnect = bench_ticks_ns() - start;
+
+    // Getchallenge from new address: the address is not found and the oldest challenge is replaced
+    int time = MAX_CHALLENGES + 1;
+    start = bench_ticks_ns();
+    for (int n = 0; n < count; n++) {
+        netaddr_s adr = {};
+        adr.type = NA_IP;
+        uint32_t ip = random();
+        memcpy(adr.ip, &ip, 4);
+        if (challenge_findByAddress(adr) != -1)
+            continue;
+        int i = challenge_allocate();
+        svs_challenges[i].adr = adr;
+        svs_challenges[i].challenge = (random() & 0x7fffffff) | 1;
+        svs_challenges[i].time = time++;
+        challenge_update(i);
+    }
+    uint64_t indexChallenge = bench_ticks_ns() - start;
+
+    start = bench_ticks_ns();
+    for (int n = 0; n < count; n++) {
+        netaddr_s adr = {};
+        adr.type = NA_IP;
+        uint32_t ip = random();
+        memcpy(adr.ip, &ip, 4);
+        int i, oldest = 0, oldestTime = 0x7fffffff;
+        for (i = 0; i < MAX_CHALLENGES; i++) {
+            if (!svs_challenges[i].connected && NET_CompareAdr(adr, svs_challenges[i].adr))
+                break;
+            if (svs_challenges[i].time < oldestTime) {
+                oldestTime = svs_challenges[i].time;
+                oldest = i;
+            }
+        }
+        if (i != MAX_CHALLENGES)
+            continue;
+        svs_challenges[oldest].adr = adr;
+        svs_challenges[oldest].challenge = (random() & 0x7fffffff) | 1;
+        svs_challenges[oldest].time = time++;
+    }
+    uint64_t loopChallenge = bench_ticks_ns() - start;
+
+    memcpy(svs_challenges, backup, sizeof(svs_challenges));
+    free(backup);
+    challenge_rebuild();
+
+    Com_Printf("Challenges: %i requests with %i challenges used, %i found\n", count, MAX_CHALLENGES, found);
+    Com_Printf("  connect:      index %.1f ns, loop %.1f ns per request\n", (double)indexConnect / count, (double)loopConnect / count);
+    Com_Printf("  getchallenge: index %.1f ns, loop %.1f ns per request\n", (double)indexChallenge / count, (double)loopChallenge / count);
+}
+#endif
+
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void challenge_init() {
+
+    // Challenge is HMAC of the client address so connect can be verified even when the challenge entry was overwritten
+    sv_challengeStateless = Dvar_RegisterBool("sv_challengeStateless", false, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    challenge_secretValid = RAND_bytes(challenge_secret, sizeof(challenge_secret)) == 1;
+    if (!challenge_secretValid)
+        Com_Printf("Failed to generate challenge secret, stateless challenges are disabled\n");
+
+    // Seed of the index hash, so clients can not choose addresses that fall into the same chain
+    memcpy(&challenge_hashSeed, challenge_secret, sizeof(challenge_hashSeed));
+    challenge_hashSeed ^= (uint32_t)ticks_us();
+
+    challenge_rebuild();
+
+    #if DEBUG
+    Cmd_AddCommand("challengeBench", challenge_bench);
+    #endif
+}
@@ -0,0 +1,20 @@
+#ifndef CHALLENGE_H
+#define CHALLENGE_H
+
+#include "cod2_server.h"
+
+bool challenge_isStateless();
+int challenge_generate(netaddr_s adr);
+bool challenge_verify(netaddr_s adr, int challenge);
+int challenge_restore(netaddr_s adr, int challenge);
+
+void challenge_update(int slot);
+int challenge_allocate();
+void challenge_clear(int slot);
+int challenge_findByAddress(netaddr_s adr);
+int challenge_find(netaddr_s adr, int challenge);
+int challenge_findByNumber(int challenge);
+void challenge_rebuild();
+void challenge_init();
+
+#endif
@@ -6,6 +6,9 @@
 #define dedicated (*(dvar_t **)(ADDR(0x00c22f00, 0x084a8780)))
 #define sv_maxclients (*(dvar_t **)(ADDR(0x00d52810, 0x0849f74c)))
 #define sv_running (*(dvar_t **)(ADDR(0x00c26108, 0x081a218c)))
+#if COD2X_LINUX
+#define sv_fps (*(dvar_t **)(0x0849f734)) // Windows address is not known yet
+#endif
 #define sv_packet_info (*((dvar_s**)( ADDR(0x00d52858, 0x0849f798) )))
 #define net_lanauthorize (*((dvar_s**)( ADDR(0x00c8fb14, 0x081fa514) )))
 #define showpackets (*((dvar_s**)( ADDR(0x00c84ae8, 0x081fa500) )))
@@ -55,6 +55,10 @@ enum netsrc_e
 	NS_SERVER
 };
 
+#if COD2X_LINUX
+#define ip_socket (*(int*)(0x08608e34)) // UDP socket of the server, Windows address is not known yet
+#endif
+
 #define MAX_MSGLEN 0x4000
 typedef struct
 {
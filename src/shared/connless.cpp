@@ -0,0 +1,347 @@
+#include "connless.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <ctype.h>
+
+// Commands are found by perfect hash of the lowercased name, so the dispatch does not depend on number of commands
+#define CONNLESS_TABLE_SIZE			64 // must be power of 2
+#define CONNLESS_TABLE_MASK			(CONNLESS_TABLE_SIZE - 1)
+
+static connlessCommand_t connlessCommands[CONNLESS_MAX_COMMANDS];
+static int connlessCommandsCount = 0;
+static uint8_t connlessTable[CONNLESS_TABLE_SIZE]; // index of command + 1, 0 means empty slot
+static uint32_t connlessSeed = 0;
+
+// ioquake3 rate limit connectionless requests, buckets are stored in ratelimit.cpp
+// Requests are limited per address, per /24 prefix and globally, so botnet from few subnets can not use whole global budget
+// Used by the ingress thread and the main thread, so the buckets and the global bucket are guarded by spin lock
+// Prefixes have own table, so flood from random addresses does not evict the prefix buckets
+static ratelimitTable_t requestTable;
+static ratelimitTable_t prefixTable;
+static leakyBucket_t overallBucket; // shared by all rate limited commands, each checks it with its own overall policy
+static std::atomic<bool> requestLock(false);
+// Outbound bytes sent as replies to each address, used only by main thread
+static ratelimitTable_t outboundTable;
+static volatile int outboundMaxBytes = 0;
+static volatile int outboundPeriod = 0;
+// Most frequent /24 prefixes of dropped requests
+static heavyHitters_t heavyHitters;
+static std::atomic<uint32_t> droppedAddress(0);
+static std::atomic<uint32_t> droppedPrefix(0);
+static std::atomic<uint32_t> droppedOverall(0);
+static std::atomic<uint32_t> droppedOutbound(0);
+
+
+static void connless_lockRequests()
+{
+	while (requestLock.exchange(true, std::memory_order_acquire))
+		;
+}
+
+static void connless_unlockRequests()
+{
+	requestLock.store(false, std::memory_order_release);
+}
+
+
+static uint32_t connless_hash( const char* name, uint32_t seed )
+{
+	// FNV-1a of lowercased name
+	uint32_t hash = 2166136261u ^ seed;
+	for (; *name; name++)
+	{
+		hash ^= (unsigned char)tolower((unsigned char)*name);
+		hash *= 16777619u;
+	}
+	return hash ^ (hash >> 16);
+}
+
+// Find seed for which all registered commands are in different slots
+static bool connless_buildTable()
+{
+	for (uint32_t seed = 0; seed < 100000; seed++)
+	{
+		bool collision = false;
+		memset(connlessTable, 0, sizeof(connlessTable));
+
+		for (int i = 0; i < connlessCommandsCount && !collision; i++)
+		{
+			uint32_t slot = connless_hash(connlessCommands[i].name, seed) & CONNLESS_TABLE_MASK;
+			if (connlessTable[slot] != 0)
+				collision = true;
+			else
+				connlessTable[slot] = (uint8_t)(i + 1);
+		}
+
+		if (!collision)
+		{
+			connlessSeed = seed;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Register connection-less command. Returns NULL if the command can not be registered.
+ * Rate limited commands are not limited until the policy is set by connless_parsePolicy.
+ */
+connlessCommand_t* connless_registerCommand( const char* name, bool rateLimited )
+{
+	if (connlessCommandsCount >= CONNLESS_MAX_COMMANDS)
+		return NULL;
+
+	connlessCommand_t* command = &connlessCommands[connlessCommandsCount];
+	command->name = name;
+	command->index = connlessCommandsCount;
+	command->rateLimited = rateLimited;
+	connlessCommandsCount++;
+
+	if (!connless_buildTable())
+	{
+		connlessCommandsCount--;
+		connless_buildTable();
+		return NULL;
+	}
+
+	return command;
+}
+
+connlessCommand_t* connless_findCommand( const char* name )
+{
+	uint8_t index = connlessTable[connless_hash(name, connlessSeed) & CONNLESS_TABLE_MASK];
+	if (index == 0)
+		return NULL;
+
+	connlessCommand_t* command = &connlessCommands[index - 1];
+	if (strcasecmp(name, command->name) != 0)
+		return NULL;
+
+	return command;
+}
+
+connlessCommand_t* connless_getCommand( int index )
+{
+	if (index < 0 || index >= connlessCommandsCount)
+		return NULL;
+	return &connlessCommands[index];
+}
+
+int connless_commandCount()
+{
+	return connlessCommandsCount;
+}
+
+/**
+ * Read the first token of connection-less packet the same way as MSG_ReadStringLine and Cmd_TokenizeString does.
+ */
+void connless_readCommand( const uint8_t* data, int length, char* buffer, size_t bufferSize )
+{
+	size_t len = 0;
+	int i = 4; // skip the -1 marker
+
+	// Skip whitespace
+	while (i < length && data[i] != '\0' && data[i] != '\n' && data[i] <= ' ')
+		i++;
+
+	bool quoted = (i < length && data[i] == '"');
+	if (quoted)
+		i++;
+
+	for (; i < length && len < bufferSize - 1; i++)
+	{
+		uint8_t c = data[i];
+		if (c == '\0' || c == '\n' || (quoted ? c == '"' : c <= ' '))
+			break;
+		buffer[len++] = c;
+	}
+	buffer[len] = '\0';
+}
+
+
+/**
+ * Parse rate limit policy in format "<addrBurst> <addrPeriod> <prefixBurst> <prefixPeriod> <overallBurst> <overallPeriod>", "0" disables the limit.
+ * Returns false if the value is invalid, the previous policy is kept.
+ */
+bool connless_parsePolicy( connlessCommand_t* command, const char* value )
+{
+	int addrBurst, addrPeriod, prefixBurst, prefixPeriod, overallBurst, overallPeriod;
+
+	if (value[0] == '\0' || strcmp(value, "0") == 0)
+	{
+		command->addrBurst = 0;
+		return true;
+	}
+
+	if (sscanf(value, "%i %i %i %i %i %i", &addrBurst, &addrPeriod, &prefixBurst, &prefixPeriod, &overallBurst, &overallPeriod) != 6 ||
+		addrBurst < 1 || addrBurst > 127 || prefixBurst < 1 || prefixBurst > 127 || overallBurst < 1 || overallBurst > 127 ||
+		addrPeriod < 1 || addrPeriod > 60000 || prefixPeriod < 1 || prefixPeriod > 60000 || overallPeriod < 1 || overallPeriod > 60000)
+	{
+		return false;
+	}
+
+	command->addrPeriod = addrPeriod;
+	command->prefixBurst = prefixBurst;
+	command->prefixPeriod = prefixPeriod;
+	command->overallBurst = overallBurst;
+	command->overallPeriod = overallPeriod;
+	command->addrBurst = addrBurst;
+
+	return true;
+}
+
+/**
+ * Parse outbound byte budget in format "<bytes> <period>", "0" disables the limit.
+ * Returns false if the value is invalid, the previous policy is kept.
+ */
+bool connless_parseOutboundPolicy( const char* value )
+{
+	int maxBytes, period;
+
+	if (value[0] == '\0' || strcmp(value, "0") == 0)
+	{
+		outboundMaxBytes = 0;
+		return true;
+	}
+
+	if (sscanf(value, "%i %i", &maxBytes, &period) != 2 || maxBytes < 1 || period < 1 || period > 60000)
+		return false;
+
+	outboundPeriod = period;
+	outboundMaxBytes = maxBytes;
+
+	return true;
+}
+
+bool connless_isOutboundLimited()
+{
+	return outboundMaxBytes > 0;
+}
+
+
+/**
+ * Check the request by the rate limit policy of the command.
+ * Addresses from LAN are limited only by the overall limit.
+ * Its also called by the ingress thread on Linux, the buckets are locked while they are checked.
+ */
+svcRateLimit_e connless_rateLimit( connlessCommand_t* command, const unsigned char* ip, bool isLan, uint64_t now )
+{
+	if (command == NULL || !command->rateLimited || command->addrBurst == 0)
+		return SVC_RATELIMIT_NONE;
+
+	svcRateLimit_e result = SVC_RATELIMIT_OK;
+	int burst = command->addrBurst;
+	int period = command->addrPeriod;
+
+	connless_lockRequests();
+
+	if (!isLan && ratelimit_check(ratelimit_bucketForAddress(&requestTable, ip, burst, period, now), burst, period, now))
+	{
+		droppedAddress++;
+		result = SVC_RATELIMIT_ADDRESS;
+	}
+	else if (!isLan && ratelimit_check(ratelimit_bucketForPrefix(&prefixTable, ip, command->prefixBurst, command->prefixPeriod, now),
+		command->prefixBurst, command->prefixPeriod, now))
+	{
+		droppedPrefix++;
+		result = SVC_RATELIMIT_PREFIX;
+	}
+	else if (ratelimit_check(&overallBucket, command->overallBurst, command->overallPeriod, now))
+	{
+		droppedOverall++;
+		result = SVC_RATELIMIT_OVERALL;
+	}
+
+	connless_unlockRequests();
+
+	if (result != SVC_RATELIMIT_OK)
+	{
+		command->dropped++;
+		ratelimit_heavyHitterAdd(&heavyHitters, ip);
+	}
+
+	return result;
+}
+
+/**
+ * Limit bytes sent as replies to single address, so the server can not be used to amplify reflection attacks with spoofed source address.
+ * Its called only by main thread.
+ */
+svcRateLimit_e connless_rateLimitOutbound( connlessCommand_t* command, const unsigned char* ip, bool isLan, uint64_t now )
+{
+	if (command == NULL || !command->rateLimited || command->addrBurst == 0 || outboundMaxBytes == 0)
+		return SVC_RATELIMIT_NONE;
+
+	if (isLan)
+		return SVC_RATELIMIT_OK;
+
+	leakyBucket_t* bucket = ratelimit_bucketForAddress(&outboundTable, ip, 1, outboundPeriod, now);
+	if (ratelimit_checkBytes(bucket, outboundMaxBytes, outboundPeriod, now))
+	{
+		droppedOutbound++;
+		command->dropped++;
+		ratelimit_heavyHitterAdd(&heavyHitters, ip);
+		return SVC_RATELIMIT_OUTBOUND;
+	}
+
+	return SVC_RATELIMIT_OK;
+}
+
+void connless_chargeOutbound( const unsigned char* ip, bool isLan, int bytes, uint64_t now )
+{
+	if (bytes <= 0 || outboundMaxBytes == 0 || isLan)
+		return;
+
+	leakyBucket_t* bucket = ratelimit_bucketForAddress(&outboundTable, ip, 1, outboundPeriod, now);
+	ratelimit_chargeBytes(bucket, bytes);
+}
+
+
+void connless_getStats( connlessStats_t* stats )
+{
+	stats->droppedAddress = droppedAddress.load();
+	stats->droppedPrefix = droppedPrefix.load();
+	stats->droppedOverall = droppedOverall.load();
+	stats->droppedOutbound = droppedOutbound.load();
+	connless_lockRequests();
+	stats->buckets = ratelimit_bucketCount(&requestTable);
+	stats->prefixBuckets = ratelimit_bucketCount(&prefixTable);
+	stats->evicted = ratelimit_evictedCount(&requestTable) + ratelimit_evictedCount(&prefixTable);
+	connless_unlockRequests();
+	stats->outboundBuckets = ratelimit_bucketCount(&outboundTable);
+}
+
+// Most frequent /24 prefixes of dropped requests sorted by count
+int connless_topOffenders( heavyHitter_t* items, int maxItems )
+{
+	return ratelimit_heavyHitterTop(&heavyHitters, items, maxItems);
+}
+
+void connless_clearStats()
+{
+	droppedAddress = 0;
+	droppedPrefix = 0;
+	droppedOverall = 0;
+	droppedOutbound = 0;
+	ratelimit_heavyHitterClear(&heavyHitters);
+
+	for (int i = 0; i < connlessCommandsCount; i++)
+	{
+		connlessCommands[i].accepted = 0;
+		connlessCommands[i].dropped = 0;
+		connlessCommands[i].handleTime = 0;
+	}
+}
+
+void connless_clearBuckets()
+{
+	connless_lockRequests();
+	ratelimit_clear(&requestTable);
+	ratelimit_clear(&prefixTable);
+	memset(&overallBucket, 0, sizeof(overallBucket));
+	connless_unlockRequests();
+
+	ratelimit_clear(&outboundTable);
+}
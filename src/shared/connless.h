@@ -0,0 +1,71 @@
+#ifndef CONNLESS_H
+#define CONNLESS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+#include "ratelimit.h"
+
+// Engine independent part of connection-less packet handling - command parsing, dispatch table and rate limiter
+// It does not call any engine function, so it can be linked also into the offline benchmark (src/bench)
+
+#define CONNLESS_MAX_COMMANDS		16
+
+typedef enum {
+	SVC_RATELIMIT_OK,		// request is allowed
+	SVC_RATELIMIT_ADDRESS,	// rate limit from the address exceeded
+	SVC_RATELIMIT_PREFIX,	// rate limit from the /24 prefix of the address exceeded
+	SVC_RATELIMIT_OVERALL,	// overall rate limit exceeded
+	SVC_RATELIMIT_NONE,		// command is not rate limited
+	SVC_RATELIMIT_OUTBOUND,	// outbound byte budget of the address exceeded
+} svcRateLimit_e;
+
+typedef struct {
+	const char* name;
+	int index;						// order of registration
+	bool rateLimited;
+	// Parsed rate limit policy, written by main thread, read also by ingress thread
+	volatile int addrBurst;			// 0 means the command is not limited
+	volatile int addrPeriod;
+	volatile int prefixBurst;
+	volatile int prefixPeriod;
+	volatile int overallBurst;
+	volatile int overallPeriod;
+	// Statistics since last reset
+	std::atomic<uint32_t> accepted;
+	std::atomic<uint32_t> dropped;
+	uint64_t handleTime;			// microseconds, main thread only
+} connlessCommand_t;
+
+typedef struct {
+	uint32_t droppedAddress;
+	uint32_t droppedPrefix;
+	uint32_t droppedOverall;
+	uint32_t droppedOutbound;
+	int buckets;
+	int prefixBuckets;
+	int outboundBuckets;
+	uint32_t evicted;		// active request buckets evicted because the table was full
+} connlessStats_t;
+
+connlessCommand_t* connless_registerCommand(const char* name, bool rateLimited);
+connlessCommand_t* connless_findCommand(const char* name);
+connlessCommand_t* connless_getCommand(int index);
+int connless_commandCount();
+void connless_readCommand(const uint8_t* data, int length, char* buffer, size_t bufferSize);
+
+bool connless_parsePolicy(connlessCommand_t* command, const char* value);
+bool connless_parseOutboundPolicy(const char* value);
+bool connless_isOutboundLimited();
+
+svcRateLimit_e connless_rateLimit(connlessCommand_t* command, const unsigned char* ip, bool isLan, uint64_t now);
+svcRateLimit_e connless_rateLimitOutbound(connlessCommand_t* command, const unsigned char* ip, bool isLan, uint64_t now);
+void connless_chargeOutbound(const unsigned char* ip, bool isLan, int bytes, uint64_t now);
+
+void connless_getStats(connlessStats_t* stats);
+int connless_topOffenders(heavyHitter_t* items, int maxItems);
+void connless_clearStats();
+void connless_clearBuckets();
+
+#endif
@@ -33,6 +33,7 @@ scr_method_t scriptMethods[] =
 	{"getHWID", gsc_player_playerGetHWID, 0},
 	{"getCDKeyHash", gsc_player_playerGetCDKeyHash, 0},
 	{"getAuthorizationStatus", gsc_player_playerGetAuthorizationStatus, 0},
+	{"getNetStat", gsc_player_getNetStat, 0},
 
 	{"getViewOrigin", gsc_player_getViewOrigin, 0},
 	{"getStance", gsc_player_getStance, 0},
@@ -258,7 +259,6 @@ bool gsc_beforeMapChangeOrRestart(bool fromScript, bool bComplete, bool shutdown
 
 /** Called every frame on frame start. */
 void gsc_frame() {
-	gsc_http_frame();
 	gsc_websocket_frame();
 }
 
@@ -13,7 +13,7 @@ int gsc_http_pending_requests = 0;
 
 /**
  * Fetch a URL with the specified method, data and headers.
- * The connection is closed after the response is received.
+ * The connection is kept open after the response is received and reused by next requests to the same host.
  * The request is asynchronous, the response is handled in the onDoneCallback or onErrorCallback
  *   onDoneCallback is called with (status, body, headers[])
  *   onErrorCallback is called with (error)
@@ -55,12 +55,12 @@ void gsc_http_fetch() {
 				// Add headers to the script engine
 				Scr_MakeArray();
 				for (const auto& header : res.headers) {
-					Scr_AddString(header.first.c_str());
+					Scr_AddString(header.name.data());
 					Scr_AddArray();
-					Scr_AddString(header.second.c_str());
+					Scr_AddString(header.value.data());
 					Scr_AddArray();
 				}
-				Scr_AddString(res.body.c_str());
+				Scr_AddString(res.body.data());
 				Scr_AddInt(res.status);
 
 				// Run function that print test was OK
@@ -116,13 +116,6 @@ bool gsc_http_beforeMapChangeOrRestart(bool fromScript, bool bComplete, bool shu
 	return true;
 }
 
-/** Called every frame on frame start. */
-void gsc_http_frame() {
-    if (gsc_http_client) {
-        gsc_http_client->poll();
-    }
-}
-
 /** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
 void gsc_http_init() {
 }
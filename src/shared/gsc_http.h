@@ -3,9 +3,11 @@
 
 #include "server.h"
 
+class HttpClient;
+extern HttpClient* gsc_http_client;
+
 bool gsc_http_beforeMapChangeOrRestart(bool fromScript, bool bComplete, bool shutdown, sv_map_change_source_e source);
 void gsc_http_fetch();
-void gsc_http_frame();
 void gsc_http_init();
 
 #endif
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "cod2_script.h"
 #include "server.h"
 #include "match.h"
+#include "userinfo.h"
 
 int codecallback_test_match_onStartGameType;
 int codecallback_test_match_onPlayerConnect;
@@ -35,7 +36,7 @@ void gsc_match_playerGetSetData(int action, scr_entref_t ref) {
 	}
 
 	// Find player by UUID
-	const char* player_uuid = Info_ValueForKey(client->userinfo, "match_login");
+	const char* player_uuid = userinfo_get(id)->matchLogin;
 	MatchPlayer* player = match_find_player_by_uuid(player_uuid);
 
 	// Create player array KEY
@@ -168,14 +169,12 @@ void gsc_match_playerIsAllowed(scr_entref_t ref) {
 		return;
 	}
 
-	client_t *client = &svs_clients[id];
-
 	if (!match.activated) {
 		Scr_AddBool(false);
 		return;
 	}
 
-	const char* login_uuid = Info_ValueForKey(client->userinfo, "match_login");
+	const char* login_uuid = userinfo_get(id)->matchLogin;
 	if (!login_uuid || login_uuid[0] == '\0') {
 		Scr_AddBool(false);
 		return;
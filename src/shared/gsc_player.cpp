@@ -5,6 +5,8 @@
 #include "cod2_script.h"
 #include "cod2_server.h"
 #include "cod2_player.h"
+#include "userinfo.h"
+#include "netstats.h"
 
 
 /* Get the IP address of a player */
@@ -37,9 +39,7 @@ void gsc_player_playerGetHWID(scr_entref_t ref) {
 		return;
 	}
 
-	client_t *client = &svs_clients[id];
-
-	const char* HWID2 = Info_ValueForKey(client->userinfo, "cl_hwid2");
+	const char* HWID2 = userinfo_get(id)->hwid2;
 
 	// Dont use this check, as its empty for bots and for clients it should not happen as its validated on connect
 	/*if (HWID2 == NULL || strlen(HWID2) != 32)
@@ -105,6 +105,35 @@ void gsc_player_playerGetAuthorizationStatus(scr_entref_t ref) {
 }
 
 
+/**
+ * Get the snapshot statistics of the player measured over last second.
+ * Names: snapshots, bytes, packets, fragments, rateDelayed (per second), entities, bytesPerSnapshot, maxBytesPerSnapshot (per snapshot)
+ * Example: bytes = self getNetStat("bytes");
+ */
+void gsc_player_getNetStat(scr_entref_t ref) {
+	int id = ref.entnum;
+
+	if ( id >= MAX_CLIENTS )
+	{
+		Scr_Error(va("entity %d is not a player", id));
+		Scr_AddUndefined();
+		return;
+	}
+
+	const char* name = Scr_GetString(0);
+
+	int value;
+	if (!netstats_getValue(id, name, &value))
+	{
+		Scr_Error(va("unknown net stat '%s'", name));
+		Scr_AddUndefined();
+		return;
+	}
+
+	Scr_AddInt(value);
+}
+
+
 /* Get the player's view origin */
 void gsc_player_getViewOrigin(scr_entref_t ref) {
 	int id = ref.entnum;
@@ -208,7 +208,6 @@ bool gsc_websocket_beforeMapChangeOrRestart(bool fromScript, bool bComplete, boo
 void gsc_websocket_frame() {
     for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; ++i) {
         if (gsc_websocket_clients[i]) {
-            gsc_websocket_clients[i]->poll();
             if (gsc_websocket_clients[i]->isDisconnected()) {
                 delete gsc_websocket_clients[i];
                 gsc_websocket_clients[i] = nullptr;
@@ -0,0 +1,871 @@
+#include "gzip.h"
+
+#include <string.h>
+#include <algorithm>
+
+#define GZIP_WINDOW_SIZE    32768
+#define GZIP_MIN_MATCH      3
+#define GZIP_MAX_MATCH      258
+#define GZIP_HASH_BITS      15
+#define GZIP_HASH_SIZE      (1 << GZIP_HASH_BITS)
+
+static const uint16_t gzip_lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t gzip_lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t gzip_distBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t gzip_distExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Order of code length codes in the header of dynamic block
+static const uint8_t gzip_codeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Tables computed once, initialization of function-local static is thread safe
+struct gzipTables_t {
+    uint32_t crc[256];
+    uint8_t lengthCode[GZIP_MAX_MATCH + 1];  // Length to index of gzip_lengthBase
+    uint16_t litCode[288];                  // Fixed Huffman codes with reversed bits
+    uint8_t litBits[288];
+
+    gzipTables_t() {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            crc[n] = c;
+        }
+        for (int code = 0; code < 29; code++) {
+            int end = code == 28 ? GZIP_MAX_MATCH + 1 : gzip_lengthBase[code + 1];
+            for (int len = gzip_lengthBase[code]; len < end; len++)
+                lengthCode[len] = (uint8_t)code;
+        }
+        lengthCode[GZIP_MAX_MATCH] = 28;
+        for (int sym = 0; sym < 288; sym++) {
+            uint32_t code;
+            int bits;
+            if (sym < 144)      { code = 0x30 + sym;          bits = 8; }
+            else if (sym < 256) { code = 0x190 + sym - 144;   bits = 9; }
+            else if (sym < 280) { code = sym - 256;           bits = 7; }
+            else                { code = 0xc0 + sym - 280;    bits = 8; }
+            litCode[sym] = (uint16_t)reverse(code, bits);
+            litBits[sym] = (uint8_t)bits;
+        }
+    }
+
+    static uint32_t reverse(uint32_t code, int bits) {
+        uint32_t r = 0;
+        for (int i = 0; i < bits; i++) {
+            r = (r << 1) | (code & 1);
+            code >>= 1;
+        }
+        return r;
+    }
+};
+
+static const gzipTables_t& gzip_tables() {
+    static gzipTables_t tables;
+    return tables;
+}
+
+static uint32_t gzip_crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    const gzipTables_t& t = gzip_tables();
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+        crc = t.crc[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+
+
+/*
+ * Compression
+ * Matches are collected to blocks, every block is written with dynamic or fixed Huffman codes, whichever is shorter.
+ */
+
+#define GZIP_BLOCK_TOKENS   16384
+
+// Literal if dist is 0, otherwise match length and distance
+struct gzipToken_t {
+    uint16_t litlen;
+    uint16_t dist;
+};
+
+struct gzipWriter_t {
+    std::vector<char>* out;
+    uint32_t bitbuf;
+    int bitcount;
+
+    void put(uint32_t value, int bits) {
+        bitbuf |= value << bitcount;
+        bitcount += bits;
+        while (bitcount >= 8) {
+            out->push_back((char)(bitbuf & 0xff));
+            bitbuf >>= 8;
+            bitcount -= 8;
+        }
+    }
+
+    void flush() {
+        if (bitcount > 0)
+            out->push_back((char)(bitbuf & 0xff));
+        bitbuf = 0;
+        bitcount = 0;
+    }
+};
+
+// Huffman code with bits reversed for writing
+struct gzipCode_t {
+    uint16_t code[288];
+    uint8_t bits[288];
+};
+
+static inline int gzip_distCode(int distance) {
+    int dcode = 0;
+    while (dcode < 29 && gzip_distBase[dcode + 1] <= distance)
+        dcode++;
+    return dcode;
+}
+
+// Code lengths of Huffman tree for the frequencies, lengths above maxBits are shortened so the code stays complete
+static void gzip_buildLengths(const uint32_t* freq, int n, int maxBits, uint8_t* lengths) {
+    int symbols[288];
+    int used = 0;
+    for (int i = 0; i < n; i++) {
+        lengths[i] = 0;
+        if (freq[i] > 0)
+            symbols[used++] = i;
+    }
+    if (used == 0)
+        return;
+    if (used == 1) {
+        // Complete code needs two symbols
+        lengths[symbols[0]] = 1;
+        lengths[symbols[0] == 0 ? 1 : 0] = 1;
+        return;
+    }
+
+    // Huffman tree, leaves are 0..used-1, internal nodes follow
+    std::sort(symbols, symbols + used, [freq](int a, int b) { return freq[a] < freq[b] || (freq[a] == freq[b] && a < b); });
+    uint64_t weight[2 * 288];
+    int parent[2 * 288];
+    for (int i = 0; i < used; i++)
+        weight[i] = freq[symbols[i]];
+    int leaf = 0, inner = used, nodes = used;
+    auto smallest = [&]() {
+        if (leaf < used && (inner >= nodes || weight[leaf] <= weight[inner]))
+            return leaf++;
+        return inner++;
+    };
+    while (nodes < 2 * used - 1) {
+        int a = smallest();
+        int b = smallest();
+        weight[nodes] = weight[a] + weight[b];
+        parent[a] = parent[b] = nodes;
+        nodes++;
+    }
+
+    int count[64] = {0};
+    int depth[2 * 288];
+    depth[nodes - 1] = 0;
+    for (int i = nodes - 2; i >= 0; i--)
+        depth[i] = depth[parent[i]] + 1;
+    for (int i = 0; i < used; i++)
+        count[depth[i] < 63 ? depth[i] : 63]++;
+
+    // Move too long codes to maxBits and split shorter codes until the code is complete again
+    for (int len = maxBits + 1; len < 64; len++) {
+        count[maxBits] += count[len];
+        count[len] = 0;
+    }
+    uint32_t total = 0;
+    for (int len = maxBits; len > 0; len--)
+        total += (uint32_t)count[len] << (maxBits - len);
+    while (total > (1u << maxBits)) {
+        count[maxBits]--;
+        for (int len = maxBits - 1; len > 0; len--) {
+            if (count[len] > 0) {
+                count[len]--;
+                count[len + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // Most frequent symbols get the shortest codes
+    int index = used - 1;
+    for (int len = 1; len <= maxBits; len++) {
+        for (int k = count[len]; k > 0; k--)
+            lengths[symbols[index--]] = (uint8_t)len;
+    }
+}
+
+// Canonical codes for the lengths
+static void gzip_buildCode(const uint8_t* lengths, int n, gzipCode_t& code) {
+    int count[16] = {0};
+    for (int i = 0; i < n; i++)
+        count[lengths[i]]++;
+    count[0] = 0;
+    uint32_t next[16];
+    uint32_t c = 0;
+    for (int len = 1; len < 16; len++) {
+        c = (c + count[len - 1]) << 1;
+        next[len] = c;
+    }
+    for (int i = 0; i < n; i++) {
+        code.bits[i] = lengths[i];
+        code.code[i] = lengths[i] ? (uint16_t)gzipTables_t::reverse(next[lengths[i]]++, lengths[i]) : 0;
+    }
+}
+
+static void gzip_writeTokens(gzipWriter_t& w, const gzipToken_t* tokens, size_t count, const gzipCode_t& lit, const gzipCode_t& dist) {
+    const gzipTables_t& t = gzip_tables();
+    for (size_t i = 0; i < count; i++) {
+        const gzipToken_t& token = tokens[i];
+        if (token.dist == 0) {
+            w.put(lit.code[token.litlen], lit.bits[token.litlen]);
+            continue;
+        }
+        int code = t.lengthCode[token.litlen];
+        w.put(lit.code[257 + code], lit.bits[257 + code]);
+        if (gzip_lengthExtra[code])
+            w.put(token.litlen - gzip_lengthBase[code], gzip_lengthExtra[code]);
+        int dcode = gzip_distCode(token.dist);
+        w.put(dist.code[dcode], dist.bits[dcode]);
+        if (gzip_distExtra[dcode])
+            w.put(token.dist - gzip_distBase[dcode], gzip_distExtra[dcode]);
+    }
+    w.put(lit.code[256], lit.bits[256]);
+}
+
+// Size of the tokens in bits without the extra bits, they are the same for both codes
+static uint64_t gzip_codeCost(const uint32_t* litFreq, const uint32_t* distFreq, const uint8_t* litBits, const uint8_t* distBits) {
+    uint64_t bits = 0;
+    for (int i = 0; i < 286; i++)
+        bits += (uint64_t)litFreq[i] * litBits[i];
+    for (int i = 0; i < 30; i++)
+        bits += (uint64_t)distFreq[i] * distBits[i];
+    return bits;
+}
+
+static void gzip_writeBlock(gzipWriter_t& w, const gzipToken_t* tokens, size_t count, bool last) {
+    const gzipTables_t& t = gzip_tables();
+
+    uint32_t litFreq[288] = {0};
+    uint32_t distFreq[30] = {0};
+    for (size_t i = 0; i < count; i++) {
+        if (tokens[i].dist == 0) {
+            litFreq[tokens[i].litlen]++;
+        } else {
+            litFreq[257 + t.lengthCode[tokens[i].litlen]]++;
+            distFreq[gzip_distCode(tokens[i].dist)]++;
+        }
+    }
+    litFreq[256] = 1;
+
+    // Dynamic code, at least two distance codes are defined for compatibility with old decoders
+    uint8_t lengths[286 + 30];
+    gzip_buildLengths(litFreq, 286, 15, lengths);
+    uint32_t distFreqUsed[30];
+    memcpy(distFreqUsed, distFreq, sizeof(distFreq));
+    int distUsed = 0;
+    for (int i = 0; i < 30; i++)
+        distUsed += distFreqUsed[i] > 0;
+    for (int i = 0; distUsed < 2 && i < 30; i++) {
+        if (distFreqUsed[i] == 0) {
+            distFreqUsed[i] = 1;
+            distUsed++;
+        }
+    }
+    gzip_buildLengths(distFreqUsed, 30, 15, lengths + 286);
+
+    int nlen = 286;
+    while (nlen > 257 && lengths[nlen - 1] == 0)
+        nlen--;
+    int ndist = 30;
+    while (ndist > 1 && lengths[286 + ndist - 1] == 0)
+        ndist--;
+
+    // Code lengths are written with run-length codes 16 (repeat previous), 17 and 18 (repeat zero)
+    uint8_t all[286 + 30];
+    memcpy(all, lengths, nlen);
+    memcpy(all + nlen, lengths + 286, ndist);
+    int total = nlen + ndist;
+    uint8_t rle[286 + 30];
+    uint8_t rleExtra[286 + 30];
+    int rleCount = 0;
+    uint32_t clFreq[19] = {0};
+    for (int i = 0; i < total; ) {
+        int len = all[i];
+        int run = 1;
+        while (i + run < total && all[i + run] == len)
+            run++;
+        if (len == 0 && run >= 3) {
+            int n = run > 138 ? 138 : run;
+            rle[rleCount] = n >= 11 ? 18 : 17;
+            rleExtra[rleCount++] = (uint8_t)(n >= 11 ? n - 11 : n - 3);
+            i += n;
+        } else if (len != 0 && run >= 4) {
+            rle[rleCount] = (uint8_t)len;
+            rleExtra[rleCount++] = 0;
+            int n = run - 1 > 6 ? 6 : run - 1;
+            rle[rleCount] = 16;
+            rleExtra[rleCount++] = (uint8_t)(n - 3);
+            i += 1 + n;
+        } else {
+            rle[rleCount] = (uint8_t)len;
+            rleExtra[rleCount++] = 0;
+            i++;
+        }
+    }
+    for (int i = 0; i < rleCount; i++)
+        clFreq[rle[i]]++;
+    uint8_t clLengths[19];
+    gzip_buildLengths(clFreq, 19, 7, clLengths);
+    int ncode = 19;
+    while (ncode > 4 && clLengths[gzip_codeLengthOrder[ncode - 1]] == 0)
+        ncode--;
+
+    uint64_t dynamicBits = 14 + ncode * 3 + gzip_codeCost(litFreq, distFreq, lengths, lengths + 286);
+    for (int i = 0; i < rleCount; i++)
+        dynamicBits += clLengths[rle[i]] + (rle[i] == 16 ? 2 : rle[i] == 17 ? 3 : rle[i] == 18 ? 7 : 0);
+    uint8_t fixedDist[30];
+    memset(fixedDist, 5, sizeof(fixedDist));
+    uint64_t fixedBits = gzip_codeCost(litFreq, distFreq, t.litBits, fixedDist);
+
+    gzipCode_t lit, dist;
+    w.put(last ? 1 : 0, 1);
+    if (fixedBits <= dynamicBits) {
+        w.put(1, 2);
+        memcpy(lit.code, t.litCode, sizeof(lit.code));
+        memcpy(lit.bits, t.litBits, sizeof(lit.bits));
+        for (int i = 0; i < 30; i++) {
+            dist.code[i] = (uint16_t)gzipTables_t::reverse(i, 5);
+            dist.bits[i] = 5;
+        }
+    } else {
+        w.put(2, 2);
+        w.put(nlen - 257, 5);
+        w.put(ndist - 1, 5);
+        w.put(ncode - 4, 4);
+        for (int i = 0; i < ncode; i++)
+            w.put(clLengths[gzip_codeLengthOrder[i]], 3);
+        gzipCode_t cl;
+        gzip_buildCode(clLengths, 19, cl);
+        for (int i = 0; i < rleCount; i++) {
+            w.put(cl.code[rle[i]], cl.bits[rle[i]]);
+            if (rle[i] == 16) w.put(rleExtra[i], 2);
+            else if (rle[i] == 17) w.put(rleExtra[i], 3);
+            else if (rle[i] == 18) w.put(rleExtra[i], 7);
+        }
+        gzip_buildCode(lengths, 286, lit);
+        gzip_buildCode(lengths + 286, 30, dist);
+    }
+    gzip_writeTokens(w, tokens, count, lit, dist);
+}
+
+static inline uint32_t gzip_hash(const uint8_t* p) {
+    return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (GZIP_HASH_SIZE - 1);
+}
+
+bool gzip_compress(const char* data, size_t length, int level, std::vector<char>& out) {
+    if (level < 1 || level > 9)
+        return false;
+
+    // Longer chains find longer matches, lazy matching checks if next position has longer match
+    static const int maxChain[10] = {0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096};
+    static const int niceLength[10] = {0, 8, 16, 32, 64, 128, 128, 258, 258, 258};
+    const int chainLimit = maxChain[level];
+    const int nice = niceLength[level];
+    const bool lazy = level >= 4;
+
+    const uint8_t* src = (const uint8_t*)data;
+
+    // Header: magic, deflate, no flags, no time, no extra flags, unknown OS
+    static const char header[10] = {(char)0x1f, (char)0x8b, 8, 0, 0, 0, 0, 0, 0, (char)0xff};
+    out.insert(out.end(), header, header + sizeof(header));
+    out.reserve(out.size() + length / 3 + 64);
+
+    gzipWriter_t w = {&out, 0, 0};
+
+    std::vector<int32_t> head(GZIP_HASH_SIZE, -1);
+    std::vector<int32_t> prev(GZIP_WINDOW_SIZE, -1);
+    std::vector<gzipToken_t> tokens;
+    tokens.reserve(GZIP_BLOCK_TOKENS);
+
+    auto insert = [&](size_t pos) {
+        if (pos + GZIP_MIN_MATCH > length)
+            return;
+        uint32_t h = gzip_hash(src + pos);
+        prev[pos & (GZIP_WINDOW_SIZE - 1)] = head[h];
+        head[h] = (int32_t)pos;
+    };
+
+    auto longest = [&](size_t pos, int& distance) {
+        int best = 0;
+        if (pos + GZIP_MIN_MATCH > length)
+            return 0;
+        size_t maxLen = length - pos < GZIP_MAX_MATCH ? length - pos : GZIP_MAX_MATCH;
+        int32_t candidate = head[gzip_hash(src + pos)];
+        for (int chain = chainLimit; candidate >= 0 && chain > 0 && best < (int)maxLen; chain--) {
+            if (pos - candidate > GZIP_WINDOW_SIZE - 1)
+                break;
+            const uint8_t* a = src + candidate;
+            const uint8_t* b = src + pos;
+            if (a[best] == b[best] && a[0] == b[0]) {
+                size_t len = 0;
+                while (len < maxLen && a[len] == b[len])
+                    len++;
+                if ((int)len > best) {
+                    best = (int)len;
+                    distance = (int)(pos - candidate);
+                    if (best >= nice)
+                        break;
+                }
+            }
+            int32_t next = prev[candidate & (GZIP_WINDOW_SIZE - 1)];
+            if (next >= candidate)
+                break;
+            candidate = next;
+        }
+        return best >= GZIP_MIN_MATCH ? best : 0;
+    };
+
+    auto token = [&](int litlen, int dist) {
+        tokens.push_back({(uint16_t)litlen, (uint16_t)dist});
+        if (tokens.size() >= GZIP_BLOCK_TOKENS) {
+            gzip_writeBlock(w, tokens.data(), tokens.size(), false);
+            tokens.clear();
+        }
+    };
+
+    size_t pos = 0;
+    while (pos < length) {
+        int distance = 0;
+        int len = longest(pos, distance);
+        insert(pos);
+
+        if (len > 0 && lazy && len < nice && pos + 1 < length) {
+            // Literal is written if match at next position is longer
+            int nextDistance = 0;
+            int nextLen = longest(pos + 1, nextDistance);
+            if (nextLen > len) {
+                token(src[pos], 0);
+                pos++;
+                insert(pos);
+                len = nextLen;
+                distance = nextDistance;
+            }
+        }
+
+        if (len == 0) {
+            token(src[pos], 0);
+            pos++;
+            continue;
+        }
+
+        token(len, distance);
+        for (int i = 1; i < len; i++)
+            insert(pos + i);
+        pos += len;
+    }
+
+    gzip_writeBlock(w, tokens.data(), tokens.size(), true);
+    w.flush();
+
+    // Trailer: CRC32 and size of the input
+    uint32_t crc = gzip_crc32(0, src, length);
+    uint32_t size = (uint32_t)length;
+    for (int i = 0; i < 4; i++)
+        out.push_back((char)((crc >> (i * 8)) & 0xff));
+    for (int i = 0; i < 4; i++)
+        out.push_back((char)((size >> (i * 8)) & 0xff));
+    return true;
+}
+
+
+
+/*
+ * Decompression
+ * Every step reads a whole header or symbol, if the input ends in the middle the position is restored and the step is repeated with more input.
+ */
+
+GzipDecoder::GzipDecoder() {
+    window.resize(GZIP_WINDOW_SIZE);
+    crc_table = gzip_tables().crc;
+}
+
+bool GzipDecoder::fail(const char* message) {
+    state = STATE_ERROR;
+    error = message;
+    return false;
+}
+
+bool GzipDecoder::need(size_t count) const {
+    return bitpos + count <= input.size() * 8;
+}
+
+// Caller checks that the bits are available
+uint32_t GzipDecoder::bits(int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++, bitpos++)
+        value |= (uint32_t)((input[bitpos >> 3] >> (bitpos & 7)) & 1) << i;
+    return value;
+}
+
+void GzipDecoder::emit(uint8_t byte, std::string& out) {
+    out.push_back((char)byte);
+    window[window_pos] = byte;
+    window_pos = (window_pos + 1) & (GZIP_WINDOW_SIZE - 1);
+    total_out++;
+
+    if (format == FORMAT_GZIP) {
+        crc = crc_table[(crc ^ byte) & 0xff] ^ (crc >> 8);
+    } else if (format == FORMAT_ZLIB) {
+        uint32_t a = (adler & 0xffff) + byte;
+        if (a >= 65521) a -= 65521;
+        uint32_t b = (adler >> 16) + a;
+        if (b >= 65521) b -= 65521;
+        adler = (b << 16) | a;
+    }
+}
+
+// Decode one symbol, returns false if more input is needed or the code is invalid
+bool GzipDecoder::decode(const Huffman& h, int& symbol) {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+        if (!need(1))
+            return false;
+        code |= (int)bits(1);
+        int count = h.count[len];
+        if (code - count < first) {
+            symbol = h.symbol[index + (code - first)];
+            return true;
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    fail("Invalid Huffman code");
+    return false;
+}
+
+// Build the code from code lengths, returns the number of unused codes - 0 if the code is complete, negative if it is over-subscribed
+int GzipDecoder::construct(Huffman& h, const uint8_t* lengths, int n) {
+    memset(h.count, 0, sizeof(h.count));
+    for (int sym = 0; sym < n; sym++)
+        h.count[lengths[sym]]++;
+    if (h.count[0] == n)
+        return 0; // No codes, decoding of any symbol fails
+
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h.count[len];
+        if (left < 0)
+            return left;
+    }
+
+    uint16_t offs[16];
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++)
+        offs[len + 1] = offs[len] + h.count[len];
+    for (int sym = 0; sym < n; sym++) {
+        if (lengths[sym] != 0)
+            h.symbol[offs[lengths[sym]]++] = (uint16_t)sym;
+    }
+    return left;
+}
+
+bool GzipDecoder::read_header() {
+    if (input.size() < 2)
+        return false;
+
+    const uint8_t* p = input.data();
+    if (p[0] == 0x1f && p[1] == 0x8b) {
+        // Gzip header with optional fields
+        if (input.size() < 10)
+            return false;
+        if (p[2] != 8)
+            return fail("Unknown compression method");
+        int flags = p[3];
+        size_t pos = 10;
+        if (flags & 4) { // Extra field
+            if (input.size() < pos + 2)
+                return false;
+            pos += 2 + (p[pos] | (p[pos + 1] << 8));
+        }
+        for (int field = 8; field <= 16; field <<= 1) { // File name and comment terminated by zero
+            if (!(flags & field))
+                continue;
+            while (pos < input.size() && p[pos] != 0)
+                pos++;
+            if (pos >= input.size())
+                return false;
+            pos++;
+        }
+        if (flags & 2) // Header CRC
+            pos += 2;
+        if (input.size() < pos)
+            return false;
+        format = FORMAT_GZIP;
+        bitpos = pos * 8;
+
+    } else if ((p[0] & 0x0f) == 8 && (p[0] >> 4) <= 7 && ((p[0] << 8) | p[1]) % 31 == 0) {
+        // Zlib header, preset dictionary is not supported
+        if (p[1] & 0x20)
+            return fail("Preset dictionary is not supported");
+        format = FORMAT_ZLIB;
+        bitpos = 16;
+
+    } else {
+        // Some servers send raw deflate as Content-Encoding: deflate
+        format = FORMAT_RAW;
+        bitpos = 0;
+    }
+
+    state = STATE_BLOCK;
+    return true;
+}
+
+bool GzipDecoder::read_block() {
+    size_t mark = bitpos;
+    if (!need(3))
+        return false;
+    last_block = bits(1) != 0;
+    int type = (int)bits(2);
+
+    if (type == 0) {
+        // Stored block, length is byte aligned
+        bitpos = (bitpos + 7) & ~(size_t)7;
+        if (!need(32)) {
+            bitpos = mark;
+            return false;
+        }
+        uint32_t len = bits(16);
+        uint32_t nlen = bits(16);
+        if (len != (~nlen & 0xffff))
+            return fail("Invalid stored block length");
+        stored_remaining = len;
+        state = STATE_STORED;
+
+    } else if (type == 1) {
+        uint8_t lengths[288 + 30];
+        int sym = 0;
+        for (; sym < 144; sym++) lengths[sym] = 8;
+        for (; sym < 256; sym++) lengths[sym] = 9;
+        for (; sym < 280; sym++) lengths[sym] = 7;
+        for (; sym < 288; sym++) lengths[sym] = 8;
+        construct(lencode, lengths, 288);
+        for (sym = 0; sym < 30; sym++) lengths[sym] = 5;
+        construct(distcode, lengths, 30); // Incomplete by the specification, codes 30 and 31 are invalid
+        state = STATE_CODES;
+
+    } else if (type == 2) {
+        if (!read_dynamic()) {
+            if (state != STATE_ERROR)
+                bitpos = mark;
+            return false;
+        }
+        state = STATE_CODES;
+
+    } else {
+        return fail("Invalid block type");
+    }
+    return true;
+}
+
+bool GzipDecoder::read_dynamic() {
+    if (!need(14))
+        return false;
+    int nlen = (int)bits(5) + 257;
+    int ndist = (int)bits(5) + 1;
+    int ncode = (int)bits(4) + 4;
+    if (nlen > 286 || ndist > 30)
+        return fail("Invalid dynamic block header");
+
+    uint8_t lengths[320];
+    if (!need(ncode * 3))
+        return false;
+    memset(lengths, 0, 19);
+    for (int i = 0; i < ncode; i++)
+        lengths[gzip_codeLengthOrder[i]] = (uint8_t)bits(3);
+    if (construct(lencode, lengths, 19) != 0)
+        return fail("Invalid code length code");
+
+    // Code lengths of literal/length and distance codes, compressed with the code length code
+    int index = 0;
+    while (index < nlen + ndist) {
+        int symbol;
+        if (!decode(lencode, symbol))
+            return false;
+        if (symbol < 16) {
+            lengths[index++] = (uint8_t)symbol;
+            continue;
+        }
+        int len = 0, repeat;
+        if (symbol == 16) {
+            if (index == 0)
+                return fail("Repeat without previous length");
+            if (!need(2))
+                return false;
+            len = lengths[index - 1];
+            repeat = 3 + (int)bits(2);
+        } else if (symbol == 17) {
+            if (!need(3))
+                return false;
+            repeat = 3 + (int)bits(3);
+        } else {
+            if (!need(7))
+                return false;
+            repeat = 11 + (int)bits(7);
+        }
+        if (index + repeat > nlen + ndist)
+            return fail("Too many code lengths");
+        while (repeat--)
+            lengths[index++] = (uint8_t)len;
+    }
+    if (lengths[256] == 0)
+        return fail("Missing end of block code");
+
+    // Incomplete code is allowed only if it has single code of length 1 (e.g. one distance code), as in zlib and puff
+    int left = construct(lencode, lengths, nlen);
+    if (left < 0 || (left > 0 && nlen != lencode.count[0] + lencode.count[1]))
+        return fail("Invalid literal/length code lengths");
+    left = construct(distcode, lengths + nlen, ndist);
+    if (left < 0 || (left > 0 && ndist != distcode.count[0] + distcode.count[1]))
+        return fail("Invalid distance code lengths");
+    return true;
+}
+
+bool GzipDecoder::read_stored(std::string& out) {
+    size_t pos = bitpos >> 3;
+    size_t available = input.size() - pos;
+    size_t count = stored_remaining < available ? stored_remaining : available;
+    if (count > max_out - total_out)
+        return fail(ERROR_TOO_LARGE);
+    for (size_t i = 0; i < count; i++)
+        emit(input[pos + i], out);
+    bitpos += count * 8;
+    stored_remaining -= count;
+    if (stored_remaining > 0)
+        return false;
+    state = last_block ? STATE_TRAILER : STATE_BLOCK;
+    return true;
+}
+
+bool GzipDecoder::read_codes(std::string& out) {
+    while (true) {
+        size_t mark = bitpos;
+        int symbol;
+        if (!decode(lencode, symbol)) {
+            if (state != STATE_ERROR)
+                bitpos = mark;
+            return false;
+        }
+
+        if (symbol < 256) {
+            if (total_out >= max_out)
+                return fail(ERROR_TOO_LARGE);
+            emit((uint8_t)symbol, out);
+            continue;
+        }
+        if (symbol == 256) {
+            state = last_block ? STATE_TRAILER : STATE_BLOCK;
+            return true;
+        }
+
+        // Length and distance of the back-reference
+        symbol -= 257;
+        if (symbol >= 29)
+            return fail("Invalid length code");
+        if (!need(gzip_lengthExtra[symbol])) {
+            bitpos = mark;
+            return false;
+        }
+        int len = gzip_lengthBase[symbol] + (int)bits(gzip_lengthExtra[symbol]);
+
+        int dsymbol;
+        if (!decode(distcode, dsymbol)) {
+            if (state != STATE_ERROR)
+                bitpos = mark;
+            return false;
+        }
+        if (dsymbol >= 30)
+            return fail("Invalid distance code");
+        if (!need(gzip_distExtra[dsymbol])) {
+            bitpos = mark;
+            return false;
+        }
+        size_t dist = gzip_distBase[dsymbol] + bits(gzip_distExtra[dsymbol]);
+        if (dist > total_out)
+            return fail("Distance too far back");
+        if ((uint64_t)len > max_out - total_out)
+            return fail(ERROR_TOO_LARGE);
+
+        for (int i = 0; i < len; i++)
+            emit(window[(window_pos - dist) & (GZIP_WINDOW_SIZE - 1)], out);
+    }
+}
+
+bool GzipDecoder::read_trailer() {
+    bitpos = (bitpos + 7) & ~(size_t)7;
+    size_t pos = bitpos >> 3;
+
+    if (format == FORMAT_GZIP) {
+        if (input.size() < pos + 8)
+            return false;
+        const uint8_t* p = input.data() + pos;
+        uint32_t expected = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        uint32_t size = p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+        if (expected != ~crc || size != (uint32_t)total_out)
+            return fail("Invalid gzip checksum");
+        bitpos += 64;
+
+    } else if (format == FORMAT_ZLIB) {
+        if (input.size() < pos + 4)
+            return false;
+        const uint8_t* p = input.data() + pos;
+        uint32_t expected = ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        if (expected != adler)
+            return fail("Invalid zlib checksum");
+        bitpos += 32;
+    }
+
+    state = STATE_DONE;
+    return true;
+}
+
+bool GzipDecoder::write(const char* data, size_t length, std::string& out, uint64_t max_total) {
+    if (state == STATE_ERROR)
+        return false;
+    if (state == STATE_DONE)
+        return true; // Data after the stream is ignored
+
+    max_out = max_total;
+
+    input.insert(input.end(), (const uint8_t*)data, (const uint8_t*)data + length);
+
+    bool progress = true;
+    while (progress && state != STATE_DONE && state != STATE_ERROR) {
+        switch (state) {
+            case STATE_HEADER:  progress = read_header(); break;
+            case STATE_BLOCK:   progress = read_block(); break;
+            case STATE_STORED:  progress = read_stored(out); break;
+            case STATE_CODES:   progress = read_codes(out); break;
+            case STATE_TRAILER: progress = read_trailer(); break;
+            default:            progress = false; break;
+        }
+    }
+
+    // Decoded input is removed, the bit position is kept inside the first byte
+    size_t consumed = bitpos >> 3;
+    if (consumed > 0) {
+        input.erase(input.begin(), input.begin() + consumed);
+        bitpos &= 7;
+    }
+
+    return state != STATE_ERROR;
+}
@@ -0,0 +1,93 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Compress data to gzip format (RFC 1952).
+ * Deflate stream uses LZ77 with hash chains and dynamic or fixed Huffman codes, level 1 is fastest, level 9 searches the longest matches.
+ * Compressed data is appended to out. Returns false if the level is not 1-9.
+ */
+bool gzip_compress(const char* data, size_t length, int level, std::vector<char>& out);
+
+/**
+ * Streaming decompression of gzip (RFC 1952), zlib (RFC 1950) or raw deflate (RFC 1951) data, the format is detected from the first bytes.
+ * Input can be written in chunks of any size, decoded data is appended to the output as soon as it is complete.
+ * Only the unfinished symbol of the input and the last 32 KB of the output are kept between the writes.
+ */
+class GzipDecoder {
+  public:
+    GzipDecoder();
+
+    // Error when the decoded data would exceed the limit given to write
+    static constexpr char ERROR_TOO_LARGE[] = "Decoded data too large";
+
+    // Decompress next chunk of the input, returns false if the data is invalid or total decoded size would exceed max_total
+    bool write(const char* data, size_t length, std::string& out, uint64_t max_total = UINT64_MAX);
+
+    // Whole stream was decompressed and the checksum is valid
+    bool is_done() const { return state == STATE_DONE; }
+
+    const char* get_error() const { return error; }
+
+  private:
+    enum State {
+        STATE_HEADER,
+        STATE_BLOCK,
+        STATE_STORED,
+        STATE_CODES,
+        STATE_TRAILER,
+        STATE_DONE,
+        STATE_ERROR,
+    };
+    enum Format {
+        FORMAT_GZIP,
+        FORMAT_ZLIB,
+        FORMAT_RAW,
+    };
+
+    // Canonical Huffman code, number of codes per length and symbols ordered by code
+    struct Huffman {
+        uint16_t count[16];
+        uint16_t symbol[288];
+    };
+
+    State state = STATE_HEADER;
+    Format format = FORMAT_RAW;
+    const char* error = nullptr;
+
+    std::vector<uint8_t> input;     // Input that was not decoded yet
+    size_t bitpos = 0;              // Position of the next bit in the input
+
+    bool last_block = false;
+    size_t stored_remaining = 0;
+    Huffman lencode;
+    Huffman distcode;
+
+    std::vector<uint8_t> window;    // Last 32 KB of the output for back-references
+    size_t window_pos = 0;
+    uint64_t total_out = 0;
+    uint64_t max_out = UINT64_MAX;  // Limit of total_out given to write
+    const uint32_t* crc_table;
+    uint32_t crc = 0xffffffff;      // Checksum of gzip, inverted when compared
+    uint32_t adler = 1;             // Checksum of zlib
+
+    bool need(size_t bits) const;
+    uint32_t bits(int count);
+    bool decode(const Huffman& h, int& symbol);
+    int construct(Huffman& h, const uint8_t* lengths, int n);
+    bool fail(const char* message);
+    void emit(uint8_t byte, std::string& out);
+
+    bool read_header();
+    bool read_block();
+    bool read_dynamic();
+    bool read_stored(std::string& out);
+    bool read_codes(std::string& out);
+    bool read_trailer();
+};
+
+#endif
@@ -2,30 +2,123 @@
 #define HTTP_CLIENT_H
 
 #include "mongoose/mongoose.h"
+#include "reactor.h"
+#include "gzip.h"
 #include <functional>
 #include <string>
+#include <string_view>
 #include <map>
 #include <cstring>
 #include <cstdint>
 #include <cstdio>
 #include <vector>
+#include <deque>
 #include <algorithm>
+#include <atomic>
+#include <memory>
 
 #undef poll
 
 /**
  * A simple HTTP client using the Mongoose library.
  * Supports GET and POST requests with custom headers and timeouts.
- * Connection is closed after each request.
- * Call poll() periodically to process events.
+ * Connections of requests and uploads are kept open after the response and reused for next requests to the same scheme, host and port.
+ * TLS sessions are resumed when a new connection to the same host is opened.
+ * Request bodies above the size limit are sent compressed with gzip, gzip and deflate responses are decompressed, also while downloading.
+ * Connections are handled by the shared NetReactor, the reactor is polled once per frame for all clients.
+ * Callbacks are called on the main thread, also when the reactor runs on the I/O thread.
  */
 class HttpClient {
   public:
+    struct Header {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    // Headers of the response in the order they were received, without allocation
+    struct Headers {
+        Header items[MG_MAX_HTTP_HEADERS];
+        int count = 0;
+
+        const Header* begin() const { return items; }
+        const Header* end() const { return items + count; }
+        int size() const { return count; }
+
+        // Value of the header with case-insensitive name, empty if not found
+        std::string_view get(const char* name) const {
+            size_t len = strlen(name);
+            for (int i = 0; i < count; i++) {
+                if (items[i].name.size() == len && strncasecmp(items[i].name.data(), name, len) == 0)
+                    return items[i].value;
+            }
+            return std::string_view();
+        }
+    };
+
     // Response object
+    // Body and headers point to the receive buffer and are valid only while the callback runs, copy the Response to keep them
+    // All views are terminated by NUL, e.g. body.data() can be used as C string
     struct Response {
         int status = 0;
-        std::map<std::string, std::string> headers;
-        std::string body;
+        Headers headers;
+        std::string_view body = "";
+
+        Response() = default;
+        Response(const Response& other) { copy(other); }
+        Response& operator=(const Response& other) {
+            if (this != &other)
+                copy(other);
+            return *this;
+        }
+
+        // Copied response is moved without copying the data again
+        Response(Response&& other) noexcept : status(other.status), headers(other.headers), body(other.body) {
+            const char* old_data = other.storage.data();
+            storage = std::move(other.storage);
+            if (storage.data() == old_data)
+                return;
+            // Short strings are moved by copying, views are moved to the new storage
+            for (int i = 0; i < headers.count; i++) {
+                headers.items[i].name = rebase(headers.items[i].name, old_data);
+                headers.items[i].value = rebase(headers.items[i].value, old_data);
+            }
+            body = rebase(body, old_data);
+        }
+
+      private:
+        std::string storage; // Data of the copied response
+
+        std::string_view rebase(std::string_view view, const char* old_data) const {
+            if (view.data() < old_data || view.data() > old_data + storage.size())
+                return view;
+            return std::string_view(storage.data() + (view.data() - old_data), view.size());
+        }
+
+        // Copy the data to own storage, views of the copy point to it
+        void copy(const Response& other) {
+            size_t size = other.body.size() + 1;
+            for (const Header& h : other.headers)
+                size += h.name.size() + h.value.size() + 2;
+            storage.clear();
+            storage.reserve(size); // Views stay valid while appending
+
+            status = other.status;
+            headers.count = other.headers.count;
+            for (int i = 0; i < other.headers.count; i++) {
+                headers.items[i].name = append(other.headers.items[i].name);
+                headers.items[i].value = append(other.headers.items[i].value);
+            }
+            body = append(other.body);
+        }
+
+        std::string_view append(std::string_view view) {
+            size_t offset = storage.size();
+            storage.append(view.data(), view.size());
+            storage.push_back('\0');
+            return std::string_view(storage.data() + offset, view.size());
+        }
+
+        friend class HttpClient;
     };
     using Callback = std::function<void(const Response&)>;
     using ErrorCallback = std::function<void(const std::string& error)>;
@@ -33,34 +126,102 @@ class HttpClient {
     using UploadCallback = std::function<void(size_t uploaded, size_t total, size_t bytes_per_second)>; // Cleaner callback for upload progress
     using ReadCallback = std::function<size_t(char* buffer, size_t maxLen, size_t offset)>;             // Fills buffer with next chunk at 'offset', returns bytes read
 
+    // Connection and handshake statistics
+    struct Stats {
+        uint32_t requests = 0;          // Requests sent
+        uint32_t connections = 0;       // New connections opened
+        uint32_t reused = 0;            // Requests sent on kept-alive connection
+        uint32_t retries = 0;           // Requests repeated on new connection because kept-alive connection was closed by server
+        uint32_t queued = 0;            // Requests that waited for free connection
+        uint32_t tls_full = 0;          // Full TLS handshakes
+        uint32_t tls_resumed = 0;       // Abbreviated TLS handshakes with resumed session
+        uint64_t connect_ms = 0;        // Total time of DNS and TCP connect of new connections
+        uint64_t tls_full_ms = 0;       // Total time of full TLS handshakes
+        uint64_t tls_resumed_ms = 0;    // Total time of resumed TLS handshakes
+        uint32_t compressed = 0;        // Requests sent with gzip body
+        uint64_t compressed_saved = 0;  // Bytes of request bodies saved by the compression
+        uint32_t decompressed = 0;      // Compressed responses and downloads
+    };
+
     // Headers used in every request
     std::vector<std::string> headers = {};
 
+    // Connection pool settings
+    bool keep_alive = true;             // Keep connections open after the response
+    int max_connections_per_host = 4;   // Requests above the limit wait for free connection
+    int idle_timeout_ms = 15000;        // Idle connections are closed after this time
+    bool tls_session_reuse = true;      // Resume TLS session of previous connection to the same host
+
+    // Compression settings
+    // Response headers are kept as received, e.g. Content-Encoding and Content-Length of the compressed body
+    bool decompress = true;             // Send Accept-Encoding and decompress gzip and deflate responses
+    uint64_t max_download_size = 1024ULL * 1024 * 1024; // Decompressed downloads are stopped above this size, responses above MG_MAX_RECV_SIZE
+    static inline std::atomic<int> compress_level{0};       // Gzip level of request bodies 1-9, 0 = not compressed, used by all clients
+    static inline std::atomic<int> compress_min_size{1024}; // Smaller request bodies are sent uncompressed
 
-    HttpClient() {
-        mg_log_set(MG_LL_NONE);
-        mg_mgr_init(&mgr);
+    // Updated by the I/O thread when the reactor is threaded, use get_stats() to read it from other threads
+    Stats stats;
+
+
+    HttpClient() : reactor(NetReactor::instance()) {
+        reactor.run([this]() {
+            reactor.add_timer(this, [this]() { return update(); });
+        });
     }
 
+    // Requests in progress are cancelled, their callbacks are called before the client is destroyed
     ~HttpClient() {
-        mg_mgr_free(&mgr);
+        reactor.run_sync([this]() { close_all(); });
+        reactor.drain();
+
+        for (RequestContext* ctx : free_contexts)
+            delete ctx;
     }
 
+    /**
+     * Poll the shared reactor, used when the reactor is not polled by the frame, e.g. on shutdown.
+     * Requests of other clients are processed as well.
+     * With the I/O thread only the callbacks are called, onReadChunk of uploads is called by the I/O thread.
+     */
     void poll(int wait_time_ms = 0) {
-        mg_mgr_poll(&mgr, wait_time_ms);
+        reactor.poll(wait_time_ms);
     }
 
-    // Poll until no active connections or max_time_ms reached
+    // Poll until no active requests or max_time_ms reached
     void poll_max(int max_time_ms) {
         auto start_time = mg_millis();
         while (mg_millis() - start_time < (uint64_t)max_time_ms) {
-            mg_mgr_poll(&mgr, 10); // Poll with a small wait time to avoid busy-waiting
-            if (mgr.conns == nullptr) {
-                break; // Exit if no active connections
+            poll(10); // Poll with a small wait time to avoid busy-waiting
+            if (get_active_requests() == 0) {
+                break; // Exit if no active requests, idle connections are kept open
             }
         }
     }
 
+    // Number of requests in progress, including requests waiting for free connection
+    int get_active_requests() const {
+        return active_requests;
+    }
+
+    // Copy of the statistics, the counters are cleared when reset is true
+    Stats get_stats(bool reset = false) {
+        Stats copy;
+        reactor.run_sync([this, &copy, reset]() {
+            copy = stats;
+            if (reset)
+                stats = Stats{};
+        });
+        return copy;
+    }
+
+    // Close all idle connections, TLS sessions are kept
+    void close_idle() {
+        reactor.run([this]() {
+            for (auto& idle : idle_connections)
+                idle.c->is_closing = 1;
+        });
+    }
+
     // Basic GET
     void get(const char* url,
              Callback onDone,
@@ -107,6 +268,7 @@ class HttpClient {
     }
 
     // Download file with chunked processing and progress
+    // Compressed file is decompressed before the download callback, downloaded and total are sizes of the compressed data
     void downloadFile(const char* url,
                       DownloadCallback onDownload,
                       Callback onDone,
@@ -121,7 +283,7 @@ class HttpClient {
             return;
         }
 
-        auto* ctx = new RequestContext{};
+        RequestContext* ctx = acquire_context();
         ctx->url = url ? url : "";
         ctx->method = "GET";
         ctx->isDownload = true;
@@ -141,12 +303,8 @@ class HttpClient {
         ctx->timeout_connect_ms = connect_timeout_ms;
 
         // For streaming downloads, still use HTTP connection but intercept body data
-        struct mg_connection* c = mg_http_connect(&mgr, ctx->url.c_str(), ev_handler, ctx);
-        if (!c) {
-            if (ctx->onError)
-                ctx->onError("Failed to connect");
-            delete ctx;
-        }
+        // Body is removed from the receive buffer while downloading, so the connection is not reused
+        submit(ctx, false);
     }
 
     // Upload file content using streaming chunks with progress reporting and bandwidth control
@@ -168,7 +326,7 @@ class HttpClient {
             return;
         }
 
-        auto* ctx = new RequestContext{};
+        RequestContext* ctx = acquire_context();
         ctx->url = url ? url : "";
         ctx->method = "POST";
         ctx->isUpload = true;
@@ -194,12 +352,7 @@ class HttpClient {
         ctx->timeout_ms = timeout_ms;
         ctx->timeout_connect_ms = connect_timeout_ms;
 
-        struct mg_connection* c = mg_http_connect(&mgr, ctx->url.c_str(), ev_handler, ctx);
-        if (!c) {
-            if (ctx->onError)
-                ctx->onError("Failed to connect");
-            delete ctx;
-        }
+        submit(ctx, keep_alive);
     }
 
     // Backwards-compatible API: implemented via upload_chunks with a memory-backed reader
@@ -260,7 +413,7 @@ class HttpClient {
         }
         
         // Own all strings inside the context to avoid dangling pointers
-        auto* ctx = new RequestContext{};
+        RequestContext* ctx = acquire_context();
         ctx->url = url ? url : "";
         ctx->method = method ? method : "GET";
         // Combine global headers and per-request headers
@@ -273,8 +426,7 @@ class HttpClient {
             ctx->headers += headers;
             ctx->headers += "\r\n";
         }
-        ctx->data.resize(data_length);
-        std::memcpy(ctx->data.data(), data, data_length);
+        ctx->data.assign(data, data + data_length);
         ctx->onDone = std::move(onDone);
         ctx->onError = std::move(onError);
 
@@ -283,12 +435,7 @@ class HttpClient {
         ctx->timeout_ms = timeout_ms;
         ctx->timeout_connect_ms = connect_timeout_ms;
 
-        struct mg_connection* c = mg_http_connect(&mgr, ctx->url.c_str(), ev_handler, ctx);
-        if (!c) {
-            if (ctx->onError)
-                ctx->onError("Failed to connect");
-            delete ctx;
-        }
+        submit(ctx, keep_alive);
     }
 
     static size_t url_encode(const char* s, size_t sl, char* buf, size_t len) {
@@ -340,6 +487,7 @@ class HttpClient {
   private:
 
     struct RequestContext {
+        HttpClient* client = nullptr;
         std::string url;
         std::string method;
         std::string headers;
@@ -368,6 +516,8 @@ class HttpClient {
         int http_status = 0;
         size_t header_offset = 0;    // Track where headers end in the first buffer
         size_t last_buffer_size = 0; // Track last processed buffer size
+        std::unique_ptr<GzipDecoder> decoder; // Decoder of compressed download
+        std::string decoded;                  // Decompressed part of the last received data
 
         // Upload-specific fields
         bool isUpload = false;
@@ -386,17 +536,567 @@ class HttpClient {
         uint64_t upload_speed_start_ms = 0;
         uint64_t upload_limiter_start_ms = 0;
         size_t upload_limiter_sent = 0;
+
+        // Connection pool
+        std::string pool_key;                 // Scheme, host and port, e.g. "https://example.com:443"
+        bool pooled = false;                  // Connection can be kept open after the response
+        bool reused = false;                  // Request was sent on kept-alive connection
+        bool retry = false;                   // Request is repeated on new connection when this connection is closed
+        bool retried = false;                 // Request was already repeated once
+        bool response_started = false;        // Some data of the response was received
+        bool request_flushed = false;         // Some bytes of the request were written to the socket
+        uint64_t connect_start_ms = 0;        // Time when the connection was opened
+        uint64_t tls_start_ms = 0;            // Time when the TLS handshake was started
+
+        // Clear the context for next request, allocated memory of the strings and buffers is kept
+        void reset() {
+            std::string url_buffer = std::move(url);
+            std::string method_buffer = std::move(method);
+            std::string headers_buffer = std::move(headers);
+            std::string pool_key_buffer = std::move(pool_key);
+            std::vector<char> data_buffer = std::move(data);
+
+            *this = RequestContext{};
+
+            url = std::move(url_buffer);
+            method = std::move(method_buffer);
+            headers = std::move(headers_buffer);
+            pool_key = std::move(pool_key_buffer);
+            data = std::move(data_buffer);
+            url.clear();
+            method.clear();
+            headers.clear();
+            pool_key.clear();
+            data.clear();
+        }
+    };
+
+    // Finished request contexts are kept for next requests
+    static constexpr size_t MAX_FREE_CONTEXTS = 16;
+
+    // Kept-alive connection without request
+    struct IdleConnection {
+        struct mg_connection* c;
+        std::string pool_key;
+        uint64_t idle_since_ms;
     };
-    mg_mgr mgr;
+
+    #if MG_TLS == MG_TLS_OPENSSL
+    using TlsSession = SSL_SESSION*;
+    #else
+    using TlsSession = void*;
+    #endif
+
+    NetReactor& reactor;
+    std::vector<IdleConnection> idle_connections;
+    std::map<std::string, int> host_connections;    // Number of open pooled connections per pool key
+    std::deque<RequestContext*> pending;            // Requests waiting for free connection
+    std::map<std::string, TlsSession> tls_sessions; // Last resumable TLS session per pool key
+    int active_requests = 0;                        // Requests whose last callback was not called yet on the main thread
+    int running_requests = 0;                       // Requests started on the thread of the reactor
+    bool destroying = false;
+    std::vector<RequestContext*> free_contexts;     // Used only by the main thread
+    std::vector<char> compress_buffer;              // Swapped with the body of compressed request, the buffer of the original body is used next time
+
+
+    static void get_pool_key(const char* url, std::string& key) {
+        struct mg_str host = mg_url_host(url);
+        char port[8];
+        snprintf(port, sizeof(port), ":%u", (unsigned)mg_url_port(url));
+        key = mg_url_is_ssl(url) ? "https://" : "http://";
+        key.append(host.buf, host.len);
+        key += port;
+    }
+
+    RequestContext* acquire_context() {
+        if (free_contexts.empty())
+            return new RequestContext{};
+        RequestContext* ctx = free_contexts.back();
+        free_contexts.pop_back();
+        return ctx;
+    }
+
+    // Called on the main thread, the callbacks are released immediately
+    void recycle_context(RequestContext* ctx) {
+        if (free_contexts.size() >= MAX_FREE_CONTEXTS) {
+            delete ctx;
+            return;
+        }
+        ctx->reset();
+        free_contexts.push_back(ctx);
+    }
+
+    // Start the request on the thread of the reactor
+    void submit(RequestContext* ctx, bool pooled) {
+        active_requests++;
+        reactor.run([this, ctx, pooled]() { start(ctx, pooled); });
+    }
+
+    void start(RequestContext* ctx, bool pooled) {
+        ctx->client = this;
+        get_pool_key(ctx->url.c_str(), ctx->pool_key);
+        ctx->pooled = pooled;
+        running_requests++;
+        compress_request(ctx);
+        dispatch(ctx);
+    }
+
+    // Compress the body on the thread of the reactor, it is sent compressed only if it is smaller
+    // Streaming uploads are not compressed, their length is not known before all chunks are read
+    void compress_request(RequestContext* ctx) {
+        int level = compress_level.load(std::memory_order_relaxed);
+        if (level <= 0 || ctx->isUpload || ctx->isDownload || ctx->data.size() < (size_t)compress_min_size.load(std::memory_order_relaxed))
+            return;
+        if (has_header(ctx->headers, "Content-Encoding"))
+            return;
+
+        compress_buffer.clear();
+        if (!gzip_compress(ctx->data.data(), ctx->data.size(), level > 9 ? 9 : level, compress_buffer) || compress_buffer.size() >= ctx->data.size())
+            return;
+
+        stats.compressed++;
+        stats.compressed_saved += ctx->data.size() - compress_buffer.size();
+        ctx->data.swap(compress_buffer);
+        ctx->headers += "Content-Encoding: gzip\r\n";
+    }
+
+    // Header with case-insensitive name is in the headers separated by \r\n
+    static bool has_header(const std::string& headers, const char* name) {
+        size_t len = strlen(name);
+        for (size_t pos = 0; pos < headers.size(); ) {
+            size_t line_end = headers.find('\n', pos);
+            if (line_end == std::string::npos)
+                line_end = headers.size();
+            while (pos < line_end && (headers[pos] == ' ' || headers[pos] == '\r'))
+                pos++;
+            if (line_end - pos > len && headers[pos + len] == ':' && strncasecmp(headers.c_str() + pos, name, len) == 0)
+                return true;
+            pos = line_end + 1;
+        }
+        return false;
+    }
+
+    static bool is_compressed(std::string_view encoding) {
+        return (encoding.size() == 4 && strncasecmp(encoding.data(), "gzip", 4) == 0) ||
+               (encoding.size() == 6 && strncasecmp(encoding.data(), "x-gzip", 6) == 0) ||
+               (encoding.size() == 7 && strncasecmp(encoding.data(), "deflate", 7) == 0);
+    }
+
+    // Error of the decoder reported to the caller
+    static const char* decode_error(const GzipDecoder& decoder) {
+        return decoder.get_error() == GzipDecoder::ERROR_TOO_LARGE ? "Response too large" : "Invalid compressed response";
+    }
+
+    // Replace the compressed body with decompressed data in the storage of the response, returns the error or nullptr
+    // Decompressed body is limited by MG_MAX_RECV_SIZE as the body received without compression
+    const char* decompress_response(Response& res) {
+        if (!decompress || !is_compressed(res.headers.get("Content-Encoding")))
+            return nullptr;
+
+        GzipDecoder decoder;
+        std::string decoded;
+        decoded.reserve(std::min(res.body.size() * 4, (size_t)MG_MAX_RECV_SIZE));
+        if (!decoder.write(res.body.data(), res.body.size(), decoded, MG_MAX_RECV_SIZE))
+            return decode_error(decoder);
+        if (!decoder.is_done())
+            return "Invalid compressed response";
+
+        stats.decompressed++;
+        res.storage = std::move(decoded);
+        res.body = std::string_view(res.storage.data(), res.storage.size());
+        return nullptr;
+    }
+
+    // Timer of the reactor
+    bool update() {
+        close_idle_connections();
+        return running_requests > 0;
+    }
+
+    // Cancel all requests and close the connections of this client, other clients use the same manager
+    void close_all() {
+        destroying = true;
+        reactor.remove_timer(this);
+
+        // Requests waiting for free connection are never sent
+        std::deque<RequestContext*> waiting;
+        waiting.swap(pending);
+        for (RequestContext* ctx : waiting)
+            fail(ctx, "Request cancelled");
+
+        for (struct mg_connection* c = reactor.get_mgr()->conns; c != NULL; c = c->next) {
+            if (c->fn == idle_handler && c->fn_data == this) {
+                detach(c);
+            } else if (c->fn == ev_handler && ((RequestContext*)c->fn_data)->client == this) {
+                RequestContext* ctx = (RequestContext*)c->fn_data;
+                detach(c);
+                fail(ctx, "Request cancelled");
+            }
+        }
+        idle_connections.clear();
+        host_connections.clear();
+
+        #if MG_TLS == MG_TLS_OPENSSL
+        for (auto& it : tls_sessions)
+            SSL_SESSION_free(it.second);
+        #endif
+        tls_sessions.clear();
+    }
+
+    // Connection is closed without calling the handlers of this client
+    static void detach(struct mg_connection* c) {
+        c->fn = NULL;
+        c->fn_data = NULL;
+        c->is_closing = 1;
+    }
+
+    // Send the request on idle connection to the same host, open new connection or wait for free connection
+    void dispatch(RequestContext* ctx) {
+        if (destroying) {
+            fail(ctx, "Request cancelled");
+            return;
+        }
+
+        if (ctx->pooled) {
+            // Repeated request always opens new connection, other idle connections might be closed by the server as well
+            for (size_t i = 0; i < idle_connections.size() && !ctx->retried; i++) {
+                if (idle_connections[i].pool_key != ctx->pool_key || idle_connections[i].c->is_closing)
+                    continue;
+                struct mg_connection* c = idle_connections[i].c;
+                idle_connections.erase(idle_connections.begin() + i);
+                attach(c, ctx);
+                return;
+            }
+
+            if (host_connections[ctx->pool_key] >= max_connections_per_host) {
+                stats.queued++;
+                pending.push_back(ctx);
+                return;
+            }
+        }
+
+        struct mg_connection* c = mg_http_connect(reactor.get_mgr(), ctx->url.c_str(), ev_handler, ctx);
+        if (!c) {
+            fail(ctx, "Failed to connect");
+            return;
+        }
+        stats.connections++;
+        if (ctx->pooled)
+            host_connections[ctx->pool_key]++;
+    }
+
+    void fail(RequestContext* ctx, const char* error) {
+        call_error(ctx, error);
+        finish(ctx);
+    }
+
+    // Request is done, its last callback was already called
+    void finish(RequestContext* ctx) {
+        running_requests--;
+        reactor.post([this, ctx]() {
+            active_requests--;
+            recycle_context(ctx);
+        });
+    }
+
+    // Callbacks are passed to the main thread when the reactor is threaded, copies of the data are used
+    void call_done(RequestContext* ctx, const Response& res) {
+        if (!ctx->onDone)
+            return;
+        if (reactor.is_threaded())
+            reactor.post([cb = ctx->onDone, res]() { cb(res); });
+        else
+            ctx->onDone(res);
+    }
+
+    void call_error(RequestContext* ctx, const std::string& error) {
+        if (!ctx->onError)
+            return;
+        if (reactor.is_threaded())
+            reactor.post([cb = ctx->onError, error]() { cb(error); });
+        else
+            ctx->onError(error);
+    }
+
+    void call_download(RequestContext* ctx, const char* data, size_t length) {
+        if (!ctx->onDownload)
+            return;
+        if (reactor.is_threaded())
+            reactor.post([cb = ctx->onDownload, chunk = std::string(data, length), downloaded = ctx->downloaded, total = ctx->total_size]() {
+                cb(chunk.data(), chunk.size(), downloaded, total);
+            });
+        else
+            ctx->onDownload(data, length, ctx->downloaded, ctx->total_size);
+    }
+
+    // Pass received part of the download to the callback, returns the error if the compressed data is invalid or too large
+    const char* download_chunk(RequestContext* ctx, const char* data, size_t length) {
+        if (length == 0)
+            return nullptr;
+
+        // Update total downloaded with this chunk
+        ctx->downloaded += length;
+
+        if (!ctx->decoder) {
+            call_download(ctx, data, length);
+            return nullptr;
+        }
+
+        ctx->decoded.clear();
+        if (!ctx->decoder->write(data, length, ctx->decoded, max_download_size))
+            return decode_error(*ctx->decoder);
+        if (!ctx->decoded.empty())
+            call_download(ctx, ctx->decoded.data(), ctx->decoded.size());
+        return nullptr;
+    }
+
+    void call_upload(RequestContext* ctx) {
+        if (!ctx->onUpload)
+            return;
+        if (reactor.is_threaded())
+            reactor.post([cb = ctx->onUpload, sent = ctx->upload_sent, total = ctx->upload_total, speed = ctx->upload_speed]() {
+                cb(sent, total, speed);
+            });
+        else
+            ctx->onUpload(ctx->upload_sent, ctx->upload_total, ctx->upload_speed);
+    }
+
+    // Send the request on kept-alive connection
+    void attach(struct mg_connection* c, RequestContext* ctx) {
+        uint64_t now = mg_millis();
+        c->fn = ev_handler;
+        c->fn_data = ctx;
+        ctx->reused = true;
+        ctx->connected = true;
+        ctx->timeout_endtime = now + ctx->timeout_ms;
+        ctx->timeout_connect_endtime = now + ctx->timeout_connect_ms;
+        stats.reused++;
+        send_request(c, ctx);
+    }
+
+    // Request on the connection is finished, the connection is used by waiting request or kept idle
+    void release(struct mg_connection* c, const std::string& pool_key) {
+        c->fn = idle_handler;
+        c->fn_data = this;
+
+        for (auto it = pending.begin(); it != pending.end(); ++it) {
+            if ((*it)->pool_key == pool_key) {
+                RequestContext* ctx = *it;
+                pending.erase(it);
+                attach(c, ctx);
+                return;
+            }
+        }
+
+        idle_connections.push_back({c, pool_key, mg_millis()});
+    }
+
+    // Pooled connection is closed, waiting request for the same host can open new connection
+    void connection_closed(struct mg_connection* c, RequestContext* ctx) {
+        std::string pool_key = ctx ? (ctx->pooled ? ctx->pool_key : "") : "";
+
+        for (auto it = idle_connections.begin(); it != idle_connections.end(); ++it) {
+            if (it->c == c) {
+                pool_key = it->pool_key;
+                idle_connections.erase(it);
+                break;
+            }
+        }
+
+        if (pool_key.empty())
+            return;
+        if (--host_connections[pool_key] <= 0)
+            host_connections.erase(pool_key);
+
+        if (destroying)
+            return;
+
+        for (auto it = pending.begin(); it != pending.end(); ++it) {
+            if ((*it)->pool_key == pool_key) {
+                RequestContext* next = *it;
+                pending.erase(it);
+                dispatch(next);
+                return;
+            }
+        }
+    }
+
+    void close_idle_connections() {
+        uint64_t now = mg_millis();
+        for (auto& idle : idle_connections) {
+            if (now - idle.idle_since_ms >= (uint64_t)idle_timeout_ms || !keep_alive)
+                idle.c->is_closing = 1;
+        }
+    }
+
+    // Kept-alive connection might be closed by the server meanwhile, the request can be repeated on new connection only if the
+    // server could not process it - method is idempotent or no byte of the request was sent
+    bool can_retry(RequestContext* ctx) {
+        if (!ctx->reused || ctx->response_started || ctx->retried || ctx->error_occurred || destroying)
+            return false;
+        return !ctx->request_flushed || ctx->method == "GET" || ctx->method == "HEAD";
+    }
+
+    // Send the request again on new connection
+    void retry(RequestContext* ctx) {
+        stats.retries++;
+        ctx->retry = false;
+        ctx->retried = true;
+        ctx->reused = false;
+        ctx->connected = false;
+        ctx->error_occurred = false;
+        ctx->finished = false;
+        ctx->response_started = false;
+        ctx->request_flushed = false;
+        ctx->upload_headers_sent = false;
+        ctx->upload_done = false;
+        ctx->upload_sent = 0;
+        ctx->upload_speed_accumulated = 0;
+        ctx->upload_speed_start_ms = 0;
+        ctx->upload_limiter_sent = 0;
+        dispatch(ctx);
+    }
+
+    // Resume the TLS session of previous connection to the same host, must be called after mg_tls_init
+    void tls_resume(struct mg_connection* c, RequestContext* ctx) {
+        #if MG_TLS == MG_TLS_OPENSSL
+        if (!tls_session_reuse || c->tls == NULL)
+            return;
+        auto it = tls_sessions.find(ctx->pool_key);
+        if (it != tls_sessions.end())
+            SSL_set_session(((struct mg_tls*)c->tls)->ssl, it->second);
+        #endif
+    }
+
+    // Remember the TLS session for next connections, with TLS 1.3 the session ticket is received after the handshake
+    void tls_save(struct mg_connection* c, RequestContext* ctx) {
+        #if MG_TLS == MG_TLS_OPENSSL
+        if (!tls_session_reuse || c->tls == NULL)
+            return;
+        SSL_SESSION* current = SSL_get0_session(((struct mg_tls*)c->tls)->ssl);
+        if (current == NULL || !SSL_SESSION_is_resumable(current))
+            return;
+        // Copy is stored, the original session is marked as not resumable when the server closes the connection without close_notify
+        SSL_SESSION* session = SSL_SESSION_dup(current);
+        if (session == NULL)
+            return;
+        TlsSession& slot = tls_sessions[ctx->pool_key];
+        if (slot != nullptr)
+            SSL_SESSION_free(slot);
+        slot = session;
+        #endif
+    }
+
+    bool tls_is_resumed(struct mg_connection* c) {
+        #if MG_TLS == MG_TLS_OPENSSL
+        return c->tls != NULL && SSL_session_reused(((struct mg_tls*)c->tls)->ssl) == 1;
+        #else
+        return false;
+        #endif
+    }
+
+    void send_request(struct mg_connection* c, RequestContext* ctx) {
+        stats.requests++;
+
+        // Extract host name from URL
+        struct mg_str host = mg_url_host(ctx->url.c_str());
+        const char* uri = mg_url_uri(ctx->url.c_str());
+        const size_t body_len = ctx->data.size();
+
+        // Request is written directly to the send buffer of the connection
+        mg_printf(c, "%s %s HTTP/1.1\r\nHost: %.*s\r\n", ctx->method.c_str(), uri, (int)host.len, host.buf);
+
+        if (!ctx->headers.empty()) {
+            mg_send(c, ctx->headers.data(), ctx->headers.size());
+        }
+
+        if (decompress && !has_header(ctx->headers, "Accept-Encoding")) {
+            mg_printf(c, "Accept-Encoding: gzip, deflate\r\n");
+        }
+
+        if (ctx->isDownload) {
+            mg_printf(c, "Connection: close\r\n\r\n");
+
+        } else if (ctx->isUpload) {
+
+            if (!ctx->pooled)
+                mg_printf(c, "Connection: close\r\n");
+
+            mg_printf(c,
+                "Transfer-Encoding: chunked\r\n"
+                "Content-Type: application/octet-stream\r\n"
+                "\r\n");
+
+            ctx->upload_headers_sent = true;
+
+        } else {
+            if (!ctx->pooled)
+                mg_printf(c, "Connection: close\r\n");
+
+            mg_printf(c, "Content-Length: %lu\r\n\r\n", (unsigned long)body_len);
+
+            if (body_len > 0) {
+                mg_send(c, ctx->data.data(), body_len);
+            }
+        }
+    }
+
+    /**
+     * Fill the response with views of the message in the receive buffer.
+     * Names, values and body are terminated by NUL in place, the message is removed from the buffer by Mongoose after the callback.
+     * Byte after the body may be the start of next data, it is saved and must be restored by restore_response().
+     */
+    static char* view_response(struct mg_connection* c, struct mg_http_message* hm, Response& res, bool with_body, char& saved) {
+        res.status = mg_http_status(hm);
+
+        res.headers.count = 0;
+        for (int i = 0; i < MG_MAX_HTTP_HEADERS && hm->headers[i].name.len > 0; i++) {
+            struct mg_str name = hm->headers[i].name;
+            struct mg_str value = hm->headers[i].value;
+            name.buf[name.len] = '\0';   // Colon after the name
+            value.buf[value.len] = '\0'; // Line end after the value
+            res.headers.items[res.headers.count++] = {std::string_view(name.buf, name.len), std::string_view(value.buf, value.len)};
+        }
+
+        if (!with_body || hm->body.len == 0)
+            return NULL;
+
+        char* end = hm->body.buf + hm->body.len;
+        if (end >= (char*)c->recv.buf + c->recv.size) {
+            res.body = res.append(std::string_view(hm->body.buf, hm->body.len)); // Buffer is full, body is copied
+            return NULL;
+        }
+        saved = *end;
+        *end = '\0';
+        res.body = std::string_view(hm->body.buf, hm->body.len);
+        return end;
+    }
+
+    static void restore_response(char* end, char saved) {
+        if (end != NULL)
+            *end = saved;
+    }
+
+    // Idle kept-alive connection
+    static void idle_handler(struct mg_connection* c, int ev, void* ev_data) {
+        HttpClient* client = (HttpClient*)c->fn_data;
+
+        if (ev == MG_EV_READ && c->recv.len > 0)
+            c->is_closing = 1; // Unexpected data, e.g. timeout response from the server
+        else if (ev == MG_EV_CLOSE)
+            client->connection_closed(c, nullptr);
+    }
 
     static void ev_handler(struct mg_connection* c, int ev, void* ev_data) {
         RequestContext* ctx = (RequestContext*)c->fn_data;
+        HttpClient* client = ctx->client;
 
         // Connection created
         if (ev == MG_EV_OPEN) {
             uint64_t now = mg_millis();
             ctx->timeout_endtime = now + ctx->timeout_ms;
             ctx->timeout_connect_endtime = now + ctx->timeout_connect_ms;
+            ctx->connect_start_ms = now;
 
         // Every frame
         } else if (ev == MG_EV_POLL) {
@@ -516,9 +1216,11 @@ class HttpClient {
                     size_t chunk_data_len = ctx->onReadChunk(ctx->data.data(), bytesToSend, ctx->upload_sent);
 
                     if (chunk_data_len == 0) {
+                        ctx->retried = true; // Not a connection error, the request is not repeated
                         if (ctx->onError) mg_call(c, MG_EV_ERROR, (void*)"Read callback returned 0 bytes");
                         return; // Do not send a zero-sized chunk here; treat as error and stop
                     } else if (chunk_data_len > bytesToSend) {
+                        ctx->retried = true;
                         if (ctx->onError) mg_call(c, MG_EV_ERROR, (void*)"Read callback returned more bytes than requested");
                         return; // Invalid callback behavior; stop to avoid protocol corruption
                     }
@@ -540,9 +1242,7 @@ class HttpClient {
                 }
 
                 // Call progress callback
-                if (ctx->onUpload) {
-                    ctx->onUpload(ctx->upload_sent, ctx->upload_total, ctx->upload_speed);
-                }
+                client->call_upload(ctx);
 
             }
 
@@ -550,61 +1250,30 @@ class HttpClient {
         } else if (ev == MG_EV_CONNECT) {
             // Mark connection as established
             ctx->connected = true;
-
-            // Connected to server. Extract host name from URL
-            struct mg_str host = mg_url_host(ctx->url.c_str());
-            const char* uri = mg_url_uri(ctx->url.c_str());
-            const size_t body_len = ctx->data.size();
+            client->stats.connect_ms += mg_millis() - ctx->connect_start_ms;
 
             if (c->is_tls) {
                 struct mg_tls_opts opts = {};
-                opts.name = host;
+                opts.name = mg_url_host(ctx->url.c_str());
                 mg_tls_init(c, &opts);
+                client->tls_resume(c, ctx);
+                ctx->tls_start_ms = mg_millis();
             }
 
-            std::string requestStr;
-            requestStr.reserve(256 + ctx->headers.size());
-
-            requestStr += ctx->method;
-            requestStr += " ";
-            requestStr += uri;
-            requestStr += " HTTP/1.1\r\n";
-
-            requestStr += "Host: ";
-            requestStr.append(host.buf, host.len);
-            requestStr += "\r\n";
-
-            if (!ctx->headers.empty()) {
-                requestStr += ctx->headers;
-            }
-
-            if (ctx->isDownload) {
-                requestStr += "Connection: close\r\n\r\n";
-
-            } else if (ctx->isUpload) {
-
-                requestStr +=
-                    "Transfer-Encoding: chunked\r\n"
-                    "Content-Type: application/octet-stream\r\n"
-                    "\r\n";
-
-                ctx->upload_headers_sent = true;
-
-            } else {
-                requestStr += "Content-Length: ";
-                requestStr += std::to_string(body_len);
-                requestStr += "\r\n\r\n";
-
-                if (body_len > 0) {
-                    requestStr.append(ctx->data.data(), body_len);
-                }
-            }
-
-            mg_send(c, requestStr.data(), requestStr.size());
+            // Request is sent when the TLS handshake is finished
+            client->send_request(c, ctx);
         }
 
-        // TLS handshake complete – no-op
+        // TLS handshake complete
         else if (ev == MG_EV_TLS_HS) {
+            uint64_t elapsed = mg_millis() - ctx->tls_start_ms;
+            if (client->tls_is_resumed(c)) {
+                client->stats.tls_resumed++;
+                client->stats.tls_resumed_ms += elapsed;
+            } else {
+                client->stats.tls_full++;
+                client->stats.tls_full_ms += elapsed;
+            }
         }
 
         // HTTP headers received
@@ -617,21 +1286,24 @@ class HttpClient {
 
                 // Check for HTTP errors
                 if (ctx->http_status != 200) {
-                    if (ctx->onError) {
-                        ctx->onError("HTTP error " + std::to_string(ctx->http_status));
-                    }
+                    client->call_error(ctx, "HTTP error " + std::to_string(ctx->http_status));
                     c->is_closing = 1;
                     return;
                 }
 
                 // Get Content-Length header to show progress
-                for (int i = 0; i < MG_MAX_HTTP_HEADERS && hm->headers[i].name.len > 0; i++) {
-                    std::string header_name(hm->headers[i].name.buf, hm->headers[i].name.len);
-                    if (strcasecmp(header_name.c_str(), "Content-Length") == 0) {
-                        std::string content_length(hm->headers[i].value.buf, hm->headers[i].value.len);
-                        ctx->total_size = (size_t)std::stoull(content_length);
-                        break;
-                    }
+                struct mg_str* content_length = mg_http_get_header(hm, "Content-Length");
+                if (content_length != NULL) {
+                    uint64_t total = 0;
+                    if (mg_str_to_num(*content_length, 10, &total, sizeof(total)))
+                        ctx->total_size = (size_t)total;
+                }
+
+                // Compressed file is decompressed while downloading
+                // Headers are parsed again on every read until the whole response is received
+                struct mg_str* encoding = mg_http_get_header(hm, "Content-Encoding");
+                if (!ctx->headers_received && client->decompress && encoding != NULL && is_compressed(std::string_view(encoding->buf, encoding->len))) {
+                    ctx->decoder.reset(new GzipDecoder());
                 }
 
                 // Calculate header offset: headers + double CRLF
@@ -642,6 +1314,8 @@ class HttpClient {
 
         // Data received (raw socket level) - for streaming downloads
         else if (ev == MG_EV_READ) {
+            ctx->response_started = true;
+
             if (ctx->isDownload && ctx->headers_received) {
                 struct mg_iobuf* io = &c->recv;
                 if (io->len > ctx->header_offset) {
@@ -650,12 +1324,10 @@ class HttpClient {
                     size_t body_size = io->len - ctx->header_offset;
 
                     if (body_size > 0) {
-                        // Update total downloaded with this chunk
-                        ctx->downloaded += body_size;
-
                         // Call streaming callback with body data
-                        if (ctx->onDownload) {
-                            ctx->onDownload(body_start, body_size, ctx->downloaded, ctx->total_size);
+                        if (const char* error = client->download_chunk(ctx, body_start, body_size)) {
+                            mg_error(c, "%s", error);
+                            return;
                         }
 
                         // Clear only the body portion, keep headers intact
@@ -670,6 +1342,8 @@ class HttpClient {
             // MG_EV_WRITE reports how many bytes were actually flushed to the socket
             long bytes_written = *(long*)ev_data;
 
+            if (bytes_written > 0)
+                ctx->request_flushed = true;
             ctx->upload_speed_accumulated += (size_t)bytes_written;
         }
 
@@ -682,49 +1356,84 @@ class HttpClient {
 
             auto* hm = (struct mg_http_message*)ev_data;
 
-            if (ctx->isDownload) {
-                Response res;
-                res.status = mg_http_status(hm);
-                res.body = "";
-                if (ctx->onDone)
-                    ctx->onDone(res);
+            client->tls_save(c, ctx);
+
+            // Connection is kept open for next request if the server allows it and the whole request was sent
+            struct mg_str* connection = mg_http_get_header(hm, "Connection");
+            bool reusable = ctx->pooled && client->keep_alive && !client->destroying &&
+                mg_strcasecmp(hm->method, mg_str("HTTP/1.1")) == 0 &&
+                (connection == NULL || mg_strcasecmp(*connection, mg_str("close")) != 0) &&
+                (!ctx->isUpload || ctx->upload_done);
 
+            // Body of downloads was already passed to the download callback
+            Response res;
+            char saved = 0;
+            char* end = view_response(c, hm, res, !ctx->isDownload, saved);
+
+            // Whole download was received in one read, the body was not removed yet
+            const char* error;
+            if (ctx->isDownload) {
+                error = client->download_chunk(ctx, hm->body.buf, hm->body.len);
+                if (error == nullptr && ctx->decoder && !ctx->decoder->is_done())
+                    error = "Invalid compressed response";
+                if (error == nullptr && ctx->decoder)
+                    client->stats.decompressed++;
             } else {
-                // For regular requests: create response with body and headers
-                Response res;
-                res.status = mg_http_status(hm);
-                res.body.assign(hm->body.buf, hm->body.len);
-
-                // parse headers
-                for (int i = 0; i < MG_MAX_HTTP_HEADERS && hm->headers[i].name.len > 0; i++) {
-                    res.headers[std::string(hm->headers[i].name.buf, hm->headers[i].name.len)] =
-                        std::string(hm->headers[i].value.buf, hm->headers[i].value.len);
-                }
+                error = client->decompress_response(res);
+            }
 
-                if (ctx->onDone)
-                    ctx->onDone(res);
+            if (reusable && error == nullptr) {
+                client->release(c, ctx->pool_key);
+                client->call_done(ctx, res);
+                restore_response(end, saved);
+                client->finish(ctx);
+                return;
             }
+
+            if (error == nullptr) {
+                client->call_done(ctx, res);
+            } else {
+                ctx->error_occurred = true;
+                client->call_error(ctx, error);
+            }
+            restore_response(end, saved);
             c->is_closing = 1;
 
             ctx->finished = true;
         }
 
         else if (ev == MG_EV_ERROR) {
+            // Kept-alive connection might be closed by the server meanwhile, the request is repeated on new connection
+            if (client->can_retry(ctx)) {
+                ctx->retry = true;
+                c->is_closing = 1;
+                return;
+            }
+
             ctx->error_occurred = true;
-            if (ctx && ctx->onError)
-                ctx->onError((char*)ev_data);
+            client->call_error(ctx, (char*)ev_data);
             c->is_closing = 1;
         }
 
         else if (ev == MG_EV_CLOSE) {
 
+            client->connection_closed(c, ctx);
+
+            // Kept-alive connection was closed by the server before the response
+            if (!ctx->finished && client->can_retry(ctx))
+                ctx->retry = true;
+
+            if (ctx->retry && !client->destroying) {
+                client->retry(ctx);
+                return;
+            }
+
             if (!ctx->error_occurred && !ctx->finished) {
                 // Unexpected error
-                if (ctx && ctx->onError)
-                    ctx->onError("Connection closed unexpectedly");
+                client->call_error(ctx, "Connection closed unexpectedly");
             }
 
-            delete ctx;
+            client->finish(ctx);
         }
     }
 };
@@ -0,0 +1,202 @@
+#ifndef IO_THREAD_H
+#define IO_THREAD_H
+
+#include "mongoose/mongoose.h"
+#include <functional>
+#include <atomic>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+#undef poll
+
+/**
+ * Background thread that polls a Mongoose manager.
+ * The manager must be used only by the thread while it is running, other threads submit tasks that are run
+ * by the thread before the next poll. Results are posted back and run on the main thread by drain().
+ * On Linux the manager waits for the sockets with epoll.
+ */
+class IoThread {
+  public:
+    using Task = std::function<void()>;
+
+    // Called by the thread before every poll, e.g. to check timers of the connections
+    // Returns true if the connections are in use and need to be checked often, e.g. for upload pacing
+    std::function<bool()> onPoll;
+
+    IoThread(struct mg_mgr* mgr) : mgr(mgr) {}
+
+    ~IoThread() {
+        stop();
+        // Tasks that were never run
+        for (Node* node = submitted.takeAll(); node != nullptr; node = free_node(node))
+            ;
+        for (Node* node = completed.takeAll(); node != nullptr; node = free_node(node))
+            ;
+    }
+
+    // Start the thread, returns false if the thread could not be created
+    bool start() {
+        if (running)
+            return true;
+
+        // Socket pair used to interrupt the waiting in poll when a task is submitted
+        if (mgr->pipe == MG_INVALID_SOCKET && !mg_wakeup_init(mgr))
+            return false;
+
+        exit = false;
+        #if defined(_WIN32)
+            thread = CreateThread(NULL, 0, thread_proc, this, 0, NULL);
+            running = thread != NULL;
+        #else
+            running = pthread_create(&thread, NULL, thread_proc, this) == 0;
+        #endif
+        return running;
+    }
+
+    // Wait until the thread runs the submitted tasks and exits, the manager can be used by the caller again
+    void stop() {
+        if (!running)
+            return;
+
+        exit = true;
+        wakeup();
+        #if defined(_WIN32)
+            WaitForSingleObject(thread, INFINITE);
+            CloseHandle(thread);
+            thread = NULL;
+        #else
+            pthread_join(thread, NULL);
+        #endif
+        running = false;
+    }
+
+    bool is_running() const {
+        return running;
+    }
+
+    // Run the task on the thread, can be called from any thread
+    void submit(Task task) {
+        submitted.push(new Node{std::move(task), nullptr});
+        wakeup();
+    }
+
+    // Run the task on the main thread in next drain(), can be called from any thread
+    void post(Task task) {
+        completed.push(new Node{std::move(task), nullptr});
+    }
+
+    // Run posted tasks in the order they were posted, returns false if there was none
+    bool drain() {
+        Node* node = completed.takeAll();
+        if (node == nullptr)
+            return false;
+        while (node != nullptr) {
+            node->task();
+            node = free_node(node);
+        }
+        return true;
+    }
+
+    // Run posted tasks, if there are none wait for them at most wait_time_ms
+    bool drain(int wait_time_ms) {
+        uint64_t end = mg_millis() + (wait_time_ms > 0 ? wait_time_ms : 0);
+        while (!drain()) {
+            if (mg_millis() >= end)
+                return false;
+            #if defined(_WIN32)
+                Sleep(1);
+            #else
+                usleep(1000);
+            #endif
+        }
+        return true;
+    }
+
+  private:
+    struct Node {
+        Task task;
+        Node* next;
+    };
+
+    // Lock-free multiple-producer single-consumer queue
+    // Producers push to the head of the list, the consumer takes the whole list and reverses it to the original order
+    struct Queue {
+        std::atomic<Node*> head{nullptr};
+
+        void push(Node* node) {
+            node->next = head.load(std::memory_order_relaxed);
+            while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+                ;
+        }
+
+        Node* takeAll() {
+            Node* node = head.exchange(nullptr, std::memory_order_acquire);
+            Node* reversed = nullptr;
+            while (node != nullptr) {
+                Node* next = node->next;
+                node->next = reversed;
+                reversed = node;
+                node = next;
+            }
+            return reversed;
+        }
+    };
+
+    struct mg_mgr* mgr;
+    Queue submitted;
+    Queue completed;
+    std::atomic<bool> exit{false};
+    bool running = false;
+
+    #if defined(_WIN32)
+    HANDLE thread = NULL;
+    #else
+    pthread_t thread;
+    #endif
+
+
+    static Node* free_node(Node* node) {
+        Node* next = node->next;
+        delete node;
+        return next;
+    }
+
+    void wakeup() {
+        // Connection id that does not exist, the data only interrupts the waiting
+        mg_wakeup(mgr, (unsigned long)-1, "", 0);
+    }
+
+    void run_submitted() {
+        for (Node* node = submitted.takeAll(); node != nullptr; node = free_node(node))
+            node->task();
+    }
+
+    void run() {
+        while (!exit.load(std::memory_order_acquire)) {
+            run_submitted();
+            bool active = onPoll ? onPoll() : false;
+
+            // Socket events and submitted tasks interrupt the waiting
+            mg_mgr_poll(mgr, active ? 5 : 100);
+        }
+
+        // Tasks submitted before stop, e.g. closing of the connections
+        run_submitted();
+    }
+
+    #if defined(_WIN32)
+    static DWORD WINAPI thread_proc(LPVOID arg) {
+    #else
+    static void* thread_proc(void* arg) {
+    #endif
+        ((IoThread*)arg)->run();
+        return 0;
+    }
+};
+
+#endif
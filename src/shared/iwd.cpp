@@ -176,7 +176,7 @@ static void iwd_processZpamFiles() {
                     if (res.status == 200 || res.status == 201) {
                         Com_Printf("Downloading %s: 100%% complete!\n", url);
                     } else {
-                        Com_Printf("Downloading %s: zPAM download failed with status %d: %s\n", url, res.status, res.body.c_str());
+                        Com_Printf("Downloading %s: zPAM download failed with status %d: %s\n", url, res.status, res.body.data());
                     }
                 },
                 [&downloading, &closeFile](const std::string& error) {
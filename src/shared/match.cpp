@@ -10,6 +10,7 @@
 #include "http_client.h"
 #include "cod2_server.h"
 #include "server.h"
+#include "player_index.h"
 #include "json.h"
 
 dvar_t *match_login; // Cvar to store match login hash
@@ -80,12 +81,12 @@ bool match_upload_match_data(std::function<void()> onDone, std::function<void(co
         [onError, onDone](const HttpClient::Response& res) {
             match.uploading = false;
             if (res.status != 200 && res.status != 201) {
-                Com_Printf("Match uploading error, invalid status: %d\n%s\n", res.status, res.body.c_str());
+                Com_Printf("Match uploading error, invalid status: %d\n%s\n", res.status, res.body.data());
                 Com_Printf("Uploaded JSON data:\n%s\n", match_create_json_data().c_str());
                 if (onError) onError("Invalid status: " + std::to_string(res.status));
                 return;
             }
-            //Com_Printf("Match upload succeeded: %s\n", res.body.c_str());
+            //Com_Printf("Match upload succeeded: %s\n", res.body.data());
 
             if (onDone) onDone();
         },
@@ -96,8 +97,6 @@ bool match_upload_match_data(std::function<void()> onDone, std::function<void(co
         }
     );
 
-    match.httpClient->poll();
-
     return true;
 }
 
@@ -129,10 +128,10 @@ bool match_upload_error(const char* error, const char* errorMessage) {
         [](const HttpClient::Response& res) {
             match.uploadingError = false;
             if (res.status != 200 && res.status != 201) {
-                Com_Printf("Match error uploading failed, invalid status: %d\n%s\n", res.status, res.body.c_str());
+                Com_Printf("Match error uploading failed, invalid status: %d\n%s\n", res.status, res.body.data());
                 return;
             }
-            //Com_Printf("Match error uploading succeeded: %s\n", res.body.c_str());
+            //Com_Printf("Match error uploading succeeded: %s\n", res.body.data());
         },
         [](const std::string& error) {
             match.uploadingError = false;
@@ -140,8 +139,6 @@ bool match_upload_error(const char* error, const char* errorMessage) {
         }
     );
 
-    match.httpClient->poll();
-
     return true;
 }
 
@@ -339,16 +336,16 @@ bool match_redownload() {
         [](const HttpClient::Response& res) {
 
             if (res.status != 200 && res.status != 201) {
-                Com_Printf("Match redownloading error, invalid status of downloading data: %d\n%s\n", res.status, res.body.c_str());
+                Com_Printf("Match redownloading error, invalid status of downloading data: %d\n%s\n", res.status, res.body.data());
                 return;
             }
-            //Com_Printf("GET succeeded: %s\n", res.body.c_str());
+            //Com_Printf("GET succeeded: %s\n", res.body.data());
 
             MatchData matchData = MatchData{};
 
-            bool status = match_parse_json_match_data(res.body.c_str(), &matchData);
+            bool status = match_parse_json_match_data(res.body.data(), &matchData);
             if (!status) {
-                Com_Printf("Match redownloading error, failed to parse match data:\n%s\n%s\n", res.body.c_str(), matchData.error.c_str());
+                Com_Printf("Match redownloading error, failed to parse match data:\n%s\n%s\n", res.body.data(), matchData.error.c_str());
                 match_upload_error("Failed to parse match data", matchData.error.c_str());
                 return;
             }
@@ -414,10 +411,11 @@ void match_finish() {
     if (match.activated && !match.canceling) 
     {
         // Kick all players, match is finished
-        for (int i = 0; i < sv_maxclients->value.integer; i++) {
-            client_t* client = &svs_clients[i];
-            
-            if (client && client->state) {
+        player_index_update();
+        for (int i = 0; i < player_index_count; i++) {
+            client_t* client = &svs_clients[player_index_clients[i]];
+
+            if (client->state) {
                 SV_DropClient(client, "\n^2Match has finished^7");
             }
         }
@@ -558,16 +556,16 @@ void match_cmd() {
                     return;
 
                 if (res.status != 200 && res.status != 201) {
-                    Com_Printf("Match creating error, invalid status of downloading data: %d\n%s\n", res.status, res.body.c_str());
+                    Com_Printf("Match creating error, invalid status of downloading data: %d\n%s\n", res.status, res.body.data());
                     match.downloading = false;
                     return;
                 }
-                //Com_Printf("GET succeeded: %s\n", res.body.c_str());
+                //Com_Printf("GET succeeded: %s\n", res.body.data());
 
                 match.data = MatchData{};
-                bool status = match_parse_json_match_data(res.body.c_str(), &match.data);
+                bool status = match_parse_json_match_data(res.body.data(), &match.data);
                 if (!status) {
-                    Com_Printf("Match creating error, failed to parse match data:\n%s\n%s\n", res.body.c_str(), match.data.error.c_str());
+                    Com_Printf("Match creating error, failed to parse match data:\n%s\n%s\n", res.body.data(), match.data.error.c_str());
                     match_upload_error("Failed to parse match data", match.data.error.c_str());
                     match.downloading = false;
                     return;
@@ -714,10 +712,6 @@ bool match_beforeMapChangeOrRestart(bool fromScript, bool bComplete, bool shutdo
 /** Called every frame on frame start. */
 void match_frame() {
 
-    // Run event loop until no connections left
-    if (match.httpClient)
-         match.httpClient->poll();
-
     // Check if the match has timed out
     if (ticks_ms() > (match.start_tick + 5000) && (match.loading || match.downloading) && !match.activated) {
         match.loading = false;
@@ -0,0 +1,86 @@
+#include "net_reactor.h"
+
+#include "shared.h"
+#include "cod2_common.h"
+#include "cod2_cmd.h"
+#include "cod2_dvars.h"
+#include "reactor.h"
+#include "http_client.h"
+#include "gsc_http.h"
+#include "match.h"
+
+dvar_t* net_ioThread = nullptr;
+dvar_t* net_httpCompression = nullptr;
+dvar_t* net_httpCompressionMinSize = nullptr;
+
+static uint64_t net_reactor_statsTime = 0;
+
+
+static void net_reactor_printHttpStats(const char* name, HttpClient* client) {
+    if (client == nullptr) {
+        Com_Printf("%-6s not created\n", name);
+        return;
+    }
+
+    HttpClient::Stats stats = client->get_stats(true);
+    Com_Printf("%-6s requests %u, new connections %u, reused %u, retried %u, queued %u, connect avg %.1f ms\n", name,
+        stats.requests, stats.connections, stats.reused, stats.retries, stats.queued,
+        stats.connections > 0 ? (double)stats.connect_ms / stats.connections : 0.0);
+    Com_Printf("       TLS full %u (avg %.1f ms), resumed %u (avg %.1f ms), compressed %u (saved %llu bytes), decompressed %u\n",
+        stats.tls_full, stats.tls_full > 0 ? (double)stats.tls_full_ms / stats.tls_full : 0.0,
+        stats.tls_resumed, stats.tls_resumed > 0 ? (double)stats.tls_resumed_ms / stats.tls_resumed : 0.0,
+        stats.compressed, (unsigned long long)stats.compressed_saved, stats.decompressed);
+}
+
+static void net_reactor_httpStats_command() {
+    uint64_t now = ticks_ms();
+    double seconds = (now - net_reactor_statsTime) / 1000.0;
+    net_reactor_statsTime = now;
+
+    net_reactor_printHttpStats("http", gsc_http_client);
+    net_reactor_printHttpStats("match", match.httpClient);
+    Com_Printf("Statistics of last %.1f seconds\n", seconds);
+}
+
+
+/** Called every frame on frame start. */
+void net_reactor_frame() {
+
+    if (net_ioThread->modified) {
+        net_ioThread->modified = false;
+        if (!NetReactor::instance().set_threaded(net_ioThread->value.boolean))
+            Com_Printf("Failed to start network I/O thread\n");
+    }
+
+    if (net_httpCompression->modified || net_httpCompressionMinSize->modified) {
+        net_httpCompression->modified = false;
+        net_httpCompressionMinSize->modified = false;
+        HttpClient::compress_level = net_httpCompression->value.integer;
+        HttpClient::compress_min_size = net_httpCompressionMinSize->value.integer;
+    }
+
+    // One poll of the shared manager for all HTTP and WebSocket clients
+    NetReactor::instance().poll();
+}
+
+/** Called once when DLL hot-reloading is activated. The I/O thread must not run the code of the unloaded DLL. */
+void net_reactor_unload() {
+    NetReactor::instance().set_threaded(false);
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void net_reactor_init() {
+
+    // Network I/O of HTTP and WebSocket clients runs on background thread, only the callbacks are called in the frame
+    net_ioThread = Dvar_RegisterBool("net_ioThread", false, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    // Gzip level of HTTP request bodies, 0 = disabled, 1 = fastest, 9 = smallest
+    net_httpCompression = Dvar_RegisterInt("net_httpCompression", 0, 0, 9, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    // HTTP request bodies smaller than this number of bytes are sent uncompressed
+    net_httpCompressionMinSize = Dvar_RegisterInt("net_httpCompressionMinSize", 1024, 0, 1024 * 1024, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+
+    net_reactor_statsTime = ticks_ms();
+
+    Cmd_AddCommand("httpStats", net_reactor_httpStats_command);
+}
@@ -0,0 +1,8 @@
+#ifndef NET_REACTOR_H
+#define NET_REACTOR_H
+
+void net_reactor_frame();
+void net_reactor_unload();
+void net_reactor_init();
+
+#endif
@@ -0,0 +1,188 @@
+#include "netstats.h"
+
+#include "shared.h"
+#include "cod2_common.h"
+#include "cod2_cmd.h"
+#include "cod2_dvars.h"
+#include "player_index.h"
+
+#define NETSTATS_WINDOW_MS      1000
+#define NETSTATS_FRAGMENT_BIT   (1 << 31)   // set in sequence of netchan packet that is fragment
+
+// Counters of current window
+typedef struct {
+    uint32_t snapshots;
+    uint32_t bytes;
+    uint32_t packets;
+    uint32_t fragments;
+    uint32_t entities;
+    uint32_t snapshotBytes;
+    uint32_t maxSnapshotBytes;
+    uint32_t rateDelayed;
+} netstatsCounters_t;
+
+typedef struct {
+    netstatsCounters_t counters;
+    int lastSequence;           // last seen netchan.outgoingSequence, snapshot is detected by its change
+    int droppedTotal;           // packets from client lost since connect, netchan.dropped is only of last packet
+    netstatsValues_t values;    // result of last window
+} netstatsClient_t;
+
+static netstatsClient_t netstats_clients[MAX_CLIENTS];
+static uint64_t netstats_windowTime = 0;
+
+
+static bool netstats_compareAddress(const netaddr_s* a, const netaddr_s* b) {
+    return a->type == b->type && a->port == b->port && (a->type != NA_IP || memcmp(a->ip, b->ip, 4) == 0);
+}
+
+
+/** Called from NET_SendPacket, counts netchan packets sent to clients. */
+void netstats_packet(netsrc_e sock, int length, const void* data, netaddr_s to) {
+    if (sock != NS_SERVER || length < 4)
+        return;
+
+    int sequence = *(const int*)data;
+    if (sequence == -1)
+        return; // connection-less packet
+
+    for (int i = 0; i < player_index_count; i++) {
+        int clientNum = player_index_clients[i];
+        if (!netstats_compareAddress(&svs_clients[clientNum].netchan.remoteAddress, &to))
+            continue;
+
+        netstatsCounters_t* stats = &netstats_clients[clientNum].counters;
+        stats->bytes += length;
+        stats->packets++;
+        if (sequence & NETSTATS_FRAGMENT_BIT)
+            stats->fragments++;
+        return;
+    }
+}
+
+/** Called from Netchan_Process when message from client was accepted, dropped is the number of packets lost before it. */
+void netstats_received(int clientNum, int dropped) {
+    if (dropped > 0)
+        netstats_clients[clientNum].droppedTotal += dropped;
+}
+
+// Snapshot message is written into client frame when it is sent, the sequence is incremented after the whole message is transmitted
+static void netstats_updateSnapshot(int clientNum) {
+    client_t* client = &svs_clients[clientNum];
+    netstatsCounters_t* stats = &netstats_clients[clientNum].counters;
+
+    int sequence = client->netchan.outgoingSequence;
+    if (sequence == netstats_clients[clientNum].lastSequence)
+        return;
+    netstats_clients[clientNum].lastSequence = sequence;
+
+    if (client->state != CS_ACTIVE)
+        return;
+
+    clientSnapshot_t* frame = &client->frames[(sequence - 1) & 0x1f];
+    stats->snapshots++;
+    stats->entities += frame->num_entities;
+    stats->snapshotBytes += frame->messageSize;
+    if ((uint32_t)frame->messageSize > stats->maxSnapshotBytes)
+        stats->maxSnapshotBytes = frame->messageSize;
+    if (client->rateDelayed)
+        stats->rateDelayed++;
+}
+
+static void netstats_closeWindow(double seconds) {
+    for (int clientNum = 0; clientNum < MAX_CLIENTS; clientNum++) {
+        netstatsCounters_t* stats = &netstats_clients[clientNum].counters;
+        netstatsValues_t* values = &netstats_clients[clientNum].values;
+
+        if (svs_clients[clientNum].state < CS_CONNECTED) {
+            memset(&netstats_clients[clientNum], 0, sizeof(netstatsClient_t));
+            continue;
+        }
+
+        values->snapshots = (int)(stats->snapshots / seconds);
+        values->bytes = (int)(stats->bytes / seconds);
+        values->packets = (int)(stats->packets / seconds);
+        values->fragments = (int)(stats->fragments / seconds);
+        values->rateDelayed = (int)(stats->rateDelayed / seconds);
+        values->entities = stats->snapshots ? stats->entities / stats->snapshots : 0;
+        values->bytesPerSnapshot = stats->snapshots ? stats->snapshotBytes / stats->snapshots : 0;
+        values->maxBytesPerSnapshot = stats->maxSnapshotBytes;
+
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+
+/** Get statistics of last second, all values are 0 for not connected client. */
+const netstatsValues_t* netstats_get(int clientNum) {
+    return &netstats_clients[clientNum].values;
+}
+
+/** Get number of packets from client lost since connect. */
+int netstats_getDropped(int clientNum) {
+    return netstats_clients[clientNum].droppedTotal;
+}
+
+/** Get statistic value by name, used by GSC. */
+bool netstats_getValue(int clientNum, const char* name, int* value) {
+    const netstatsValues_t* values = netstats_get(clientNum);
+    static const struct { const char* name; const int netstatsValues_t::* field; } fields[] = {
+        { "snapshots",              &netstatsValues_t::snapshots },
+        { "bytes",                  &netstatsValues_t::bytes },
+        { "packets",                &netstatsValues_t::packets },
+        { "fragments",              &netstatsValues_t::fragments },
+        { "entities",               &netstatsValues_t::entities },
+        { "bytesPerSnapshot",       &netstatsValues_t::bytesPerSnapshot },
+        { "maxBytesPerSnapshot",    &netstatsValues_t::maxBytesPerSnapshot },
+        { "rateDelayed",            &netstatsValues_t::rateDelayed },
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (strcmp(fields[i].name, name) == 0) {
+            *value = values->*fields[i].field;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static void netstats_command() {
+    Com_Printf("num name             rate  snaps ping snap/s bytes/s  bytes/snap max   entities frag/s delayed/s\n");
+    Com_Printf("--- ---------------- ----- ----- ---- ------ -------- ---------- ----- -------- ------ ---------\n");
+    for (int i = 0; i < player_index_count; i++) {
+        int clientNum = player_index_clients[i];
+        client_t* client = &svs_clients[clientNum];
+        if (client->state != CS_ACTIVE)
+            continue;
+        const netstatsValues_t* values = netstats_get(clientNum);
+        Com_Printf("%3i %-16.16s %5i %5i %4i %6i %8i %10i %5i %8i %6i %9i\n", clientNum, client->name,
+            client->rate, client->snapshotMsec > 0 ? 1000 / client->snapshotMsec : 0, client->ping,
+            values->snapshots, values->bytes, values->bytesPerSnapshot, values->maxBytesPerSnapshot,
+            values->entities, values->fragments, values->rateDelayed);
+    }
+}
+
+
+/** Called every frame on frame start. */
+void netstats_frame() {
+    if (!sv_running || !sv_running->value.boolean)
+        return;
+
+    for (int i = 0; i < player_index_count; i++)
+        netstats_updateSnapshot(player_index_clients[i]);
+
+    uint64_t now = ticks_ms();
+    if (now - netstats_windowTime >= NETSTATS_WINDOW_MS) {
+        netstats_closeWindow((now - netstats_windowTime) / 1000.0);
+        netstats_windowTime = now;
+    }
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void netstats_init() {
+
+    netstats_windowTime = ticks_ms();
+
+    // Snapshot statistics of clients, values are per second or per snapshot over last second
+    Cmd_AddCommand("sv_netstats", netstats_command);
+}
@@ -0,0 +1,26 @@
+#ifndef NETSTATS_H
+#define NETSTATS_H
+
+#include "cod2_server.h"
+
+// Snapshot statistics of client measured over last second
+typedef struct {
+    int snapshots;              // snapshots sent
+    int bytes;                  // bytes of all packets sent to client, including fragments and headers
+    int packets;
+    int fragments;              // packets sent as fragment of too big snapshot
+    int entities;               // average entities in snapshot
+    int bytesPerSnapshot;       // average size of snapshot message
+    int maxBytesPerSnapshot;
+    int rateDelayed;            // snapshots after which the next one was delayed because of rate
+} netstatsValues_t;
+
+void netstats_packet(netsrc_e sock, int length, const void* data, netaddr_s to);
+void netstats_received(int clientNum, int dropped);
+const netstatsValues_t* netstats_get(int clientNum);
+int netstats_getDropped(int clientNum);
+bool netstats_getValue(int clientNum, const char* name, int* value);
+void netstats_frame();
+void netstats_init();
+
+#endif
@@ -0,0 +1,113 @@
+#include "player_index.h"
+
+#include "shared.h"
+#include "cod2_common.h"
+#include "cod2_cmd.h"
+#include "cod2_dvars.h"
+#include "cod2_entity.h"
+#include "bench.h"
+
+int player_index_clients[MAX_CLIENTS];
+int player_index_count = 0;
+
+static bool player_index_contains[MAX_CLIENTS];
+
+
+/**
+ * Add the client into the list.
+ * Called when the client connects (from SV_UserinfoChanged in SV_DirectConnect) and when it begins (SV_ClientBegin).
+ */
+void player_index_add(int clientNum) {
+    if (clientNum < 0 || clientNum >= MAX_CLIENTS || player_index_contains[clientNum])
+        return;
+
+    player_index_contains[clientNum] = true;
+    player_index_clients[player_index_count++] = clientNum;
+}
+
+/**
+ * Remove the clients that disconnected.
+ * The engine has no disconnect callback, so the clients in the list are checked instead of all slots.
+ */
+void player_index_update() {
+    for (int i = 0; i < player_index_count; ) {
+        int clientNum = player_index_clients[i];
+        if (svs_clients[clientNum].state >= CS_CONNECTED) {
+            i++;
+            continue;
+        }
+        player_index_contains[clientNum] = false;
+        player_index_clients[i] = player_index_clients[--player_index_count];
+    }
+}
+
+
+#if DEBUG
+/**
+ * Measure the player loops of G_RunFrame over g_entities compared to the player index.
+ * It runs in the game because the loops read g_entities of the engine. The index is restored after the benchmark.
+ * USAGE: playerIndexBench [frames]
+ */
+static void player_index_bench() {
+    int frames = 100000;
+    if (Cmd_Argc() > 2 || (Cmd_Argc() == 2 && !bench_parseCount(Cmd_Argv(1), &frames))) {
+        Com_Printf("Usage: playerIndexBench [frames]\n");
+        return;
+    }
+
+    // Full server, all client slots are iterated
+    int backupClients[MAX_CLIENTS];
+    bool backupContains[MAX_CLIENTS];
+    int backupCount = player_index_count;
+    memcpy(backupClients, player_index_clients, sizeof(backupClients));
+    memcpy(backupContains, player_index_contains, sizeof(backupContains));
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        player_index_clients[i] = i;
+        player_index_contains[i] = true;
+    }
+    player_index_count = MAX_CLIENTS;
+
+    // Count and set loops from G_RunFrame, broadcastTime is not written
+    volatile int players = 0;
+    uint64_t start = bench_ticks_ns();
+    for (int n = 0; n < frames; n++) {
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < MAX_GENTITIES; i++) {
+                gentity_t* ent = &g_entities[i];
+                if (ent->client && ent->r.inuse && ent->s.eType == ET_PLAYER && (pass == 0 || ent->health > 0))
+                    players++;
+            }
+        }
+    }
+    uint64_t scan = bench_ticks_ns() - start;
+
+    start = bench_ticks_ns();
+    for (int n = 0; n < frames; n++) {
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < player_index_count; i++) {
+                gentity_t* ent = &g_entities[player_index_clients[i]];
+                if (ent->client && ent->r.inuse && ent->s.eType == ET_PLAYER && (pass == 0 || ent->health > 0))
+                    players++;
+            }
+        }
+    }
+    uint64_t index = bench_ticks_ns() - start;
+
+    player_index_count = backupCount;
+    memcpy(player_index_clients, backupClients, sizeof(backupClients));
+    memcpy(player_index_contains, backupContains, sizeof(backupContains));
+
+    Com_Printf("G_RunFrame player loops with %i clients, %i frames:\n", MAX_CLIENTS, frames);
+    Com_Printf("  g_entities scan: %.3f us per frame\n", scan / 1000.0 / frames);
+    Com_Printf("  player index:    %.3f us per frame\n", index / 1000.0 / frames);
+}
+#endif
+
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void player_index_init() {
+
+    #if DEBUG
+    Cmd_AddCommand("playerIndexBench", player_index_bench);
+    #endif
+}
@@ -0,0 +1,14 @@
+#ifndef PLAYER_INDEX_H
+#define PLAYER_INDEX_H
+
+#include "cod2_server.h"
+
+// Compact list of connected client numbers, valid after player_index_update()
+extern int player_index_clients[MAX_CLIENTS];
+extern int player_index_count;
+
+void player_index_add(int clientNum);
+void player_index_update();
+void player_index_init();
+
+#endif
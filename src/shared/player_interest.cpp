@@ -0,0 +1,91 @@
+#include "player_interest.h"
+
+#include "shared.h"
+#include "cod2_common.h"
+#include "cod2_cmd.h"
+#include "cod2_entity.h"
+#include "cod2_server.h"
+#include "player_index.h"
+
+typedef struct {
+    uint32_t snapshots;
+    uint64_t entities;
+    uint64_t bytes;
+    uint64_t broadcast;
+} playerInterestStats_t;
+
+static playerInterestStats_t player_interest_stats[MAX_CLIENTS][PLAYER_BROADCAST_COUNT];
+static int player_interest_lastSequence[MAX_CLIENTS];
+static uint64_t player_interest_statsTime = 0;
+
+
+static bool player_interest_isAlivePlayer(gentity_t* ent) {
+    return ent->client && ent->r.inuse && ent->s.eType == ET_PLAYER && ent->health > 0;
+}
+
+
+/** Called every server frame after the players were broadcasted, records the snapshots of clients. */
+void player_interest_frame(playerBroadcast_e mode) {
+
+    int alivePlayers = 0;
+    if (mode == PLAYER_BROADCAST_ALL) {
+        for (int i = 0; i < player_index_count; i++)
+            alivePlayers += player_interest_isAlivePlayer(&g_entities[player_index_clients[i]]);
+    }
+
+    for (int i = 0; i < player_index_count; i++) {
+        int clientNum = player_index_clients[i];
+        client_t* client = &svs_clients[clientNum];
+
+        // New snapshot was sent since last frame
+        int sequence = client->netchan.outgoingSequence;
+        if (client->state != CS_ACTIVE || sequence == player_interest_lastSequence[clientNum])
+            continue;
+        player_interest_lastSequence[clientNum] = sequence;
+
+        clientSnapshot_t* frame = &client->frames[(sequence - 1) & 0x1f];
+        playerInterestStats_t* stats = &player_interest_stats[clientNum][mode];
+        stats->snapshots++;
+        stats->entities += frame->num_entities;
+        stats->bytes += frame->messageSize;
+
+        if (mode == PLAYER_BROADCAST_ALL)
+            stats->broadcast += alivePlayers - player_interest_isAlivePlayer(&g_entities[clientNum]);
+    }
+}
+
+
+static void player_interest_stats_command() {
+    static const char* modeNames[PLAYER_BROADCAST_COUNT] = { "pvs", "all" };
+
+    uint64_t now = ticks_ms();
+    double seconds = (now - player_interest_statsTime) / 1000.0;
+    player_interest_statsTime = now;
+
+    Com_Printf("num name             mode     snaps   entities  forced  bytes/snap\n");
+    Com_Printf("--- ---------------- -------- ------- --------- ------- ----------\n");
+    for (int i = 0; i < player_index_count; i++) {
+        int clientNum = player_index_clients[i];
+        for (int mode = 0; mode < PLAYER_BROADCAST_COUNT; mode++) {
+            playerInterestStats_t* stats = &player_interest_stats[clientNum][mode];
+            if (stats->snapshots == 0)
+                continue;
+            Com_Printf("%3i %-16.16s %-8s %7u %9.1f %7.1f %10.1f\n", clientNum, svs_clients[clientNum].name, modeNames[mode], stats->snapshots,
+                (double)stats->entities / stats->snapshots,
+                (double)stats->broadcast / stats->snapshots,
+                (double)stats->bytes / stats->snapshots);
+        }
+    }
+    Com_Printf("Averages per snapshot of last %.1f seconds, forced = other players sent by broadcast\n", seconds);
+
+    memset(player_interest_stats, 0, sizeof(player_interest_stats));
+}
+
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void player_interest_init() {
+
+    player_interest_statsTime = ticks_ms();
+
+    Cmd_AddCommand("playerInterestStats", player_interest_stats_command);
+}
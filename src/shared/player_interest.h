@@ -0,0 +1,13 @@
+#ifndef PLAYER_INTEREST_H
+#define PLAYER_INTEREST_H
+
+typedef enum {
+    PLAYER_BROADCAST_NONE,      // players are sent by PVS only
+    PLAYER_BROADCAST_ALL,       // all alive players are sent to all clients
+    PLAYER_BROADCAST_COUNT
+} playerBroadcast_e;
+
+void player_interest_frame(playerBroadcast_e mode);
+void player_interest_init();
+
+#endif
@@ -0,0 +1,246 @@
+#include "query_cache.h"
+
+#include "shared.h"
+#include "cod2_common.h"
+#include "cod2_dvars.h"
+#include "cod2_cmd.h"
+#include "cod2_net.h"
+#include "cod2_server.h"
+
+#define dvar_modifiedFlags (*(int*)ADDR(0x00c5c580, 0x085abe04))
+
+// Challenge used when the cached response is built, it is replaced by the challenge of the request when sending
+// Must be alphanumeric so it is not changed by Info_SetValueForKey
+#define QUERY_CACHE_CHALLENGE       "cod2xQueryCacheChallenge00000000"
+#define QUERY_CACHE_CHALLENGE_KEY   "\\challenge\\" QUERY_CACHE_CHALLENGE
+
+// Response is built into 16KB buffer by the original function
+#define QUERY_CACHE_MAX_PACKET      0x4000
+
+typedef struct {
+    char data[QUERY_CACHE_MAX_PACKET];
+    int length;
+    int challengeOffset;    // offset of QUERY_CACHE_CHALLENGE_KEY in data
+    bool valid;
+    uint64_t time;
+} queryCache_t;
+
+dvar_t* sv_queryCache;
+
+static queryCache_t query_cache_status;
+static queryCache_t query_cache_info;
+static queryCache_t* query_cache_capturing = NULL;
+// Placeholder is compared by pointer to find out if the arguments were tokenized again
+static const char query_cache_challenge[] = QUERY_CACHE_CHALLENGE;
+static clientState_t query_cache_clientStates[MAX_CLIENTS];
+
+// server.cpp
+void SVC_Status(netaddr_s from);
+void SVC_Info(netaddr_s from);
+int NET_SendPacket(netsrc_e sock, int length, const void *data, netaddr_s addr_to);
+
+
+/**
+ * Called from NET_SendPacket before the packet is sent.
+ * Returns true if the packet was captured into the cache and must not be sent.
+ */
+bool query_cache_capture(int length, const void* data) {
+    if (query_cache_capturing == NULL)
+        return false;
+
+    queryCache_t* cache = query_cache_capturing;
+    query_cache_capturing = NULL; // only the first packet is the response
+
+    if (length <= 0 || length > QUERY_CACHE_MAX_PACKET)
+        return true; // cache stays invalid, the original function is called again
+
+    memcpy(cache->data, data, length);
+    cache->length = length;
+
+    return true;
+}
+
+
+/**
+ * Build the response by the original function with placeholder challenge and store it into cache.
+ * Returns false if the response can not be cached.
+ */
+static bool query_cache_build(queryCache_t* cache, void (*build)(netaddr_s), netaddr_s from, const char* lastKey) {
+
+    cache->valid = false;
+    cache->length = 0;
+
+    // Original function reads the challenge from the second argument of the command
+    int argc = cmd_argc;
+    char* argv1 = cmd_argv[1];
+    cmd_argv[1] = (char*)query_cache_challenge;
+    if (cmd_argc < 2)
+        cmd_argc = 2;
+
+    query_cache_capturing = cache;
+    build(from);
+    query_cache_capturing = NULL;
+
+    // Arguments might be already tokenized again by the original function (SVC_Status tokenizes referenced iwds)
+    if (cmd_argv[1] == query_cache_challenge) {
+        cmd_argv[1] = argv1;
+        cmd_argc = argc;
+    }
+
+    if (cache->length == 0)
+        return false;
+
+    // Make sure the response is complete, Info_SetValueForKey skips values when info string is too long
+    int keyLength = strlen(QUERY_CACHE_CHALLENGE_KEY);
+    int lastKeyLength = strlen(lastKey);
+    cache->challengeOffset = -1;
+    bool lastKeyFound = false;
+
+    for (int i = 4; i < cache->length; i++) {
+        if (cache->challengeOffset == -1 && i + keyLength <= cache->length && memcmp(cache->data + i, QUERY_CACHE_CHALLENGE_KEY, keyLength) == 0)
+            cache->challengeOffset = i;
+        if (i + lastKeyLength <= cache->length && memcmp(cache->data + i, lastKey, lastKeyLength) == 0) {
+            lastKeyFound = true;
+            break;
+        }
+    }
+
+    if (cache->challengeOffset == -1 || !lastKeyFound)
+        return false;
+
+    cache->valid = true;
+    cache->time = ticks_ms();
+
+    return true;
+}
+
+
+/**
+ * Send the cached response with the challenge of the request.
+ * Returns false if the response must be built by the original function.
+ */
+static bool query_cache_send(queryCache_t* cache, void (*build)(netaddr_s), netaddr_s from, const char* lastKey) {
+
+    if (sv_queryCache->value.integer <= 0)
+        return false;
+
+    // Challenge that would be changed or rejected by Info_SetValueForKey is handled by the original function
+    // Longer challenge might not fit into the info string, so its also handled by the original function
+    // Its copied because the arguments might be tokenized again when the response is built
+    char challenge[sizeof(QUERY_CACHE_CHALLENGE)];
+    const char* arg = Cmd_Argv(1);
+    int challengeLength = strlen(arg);
+    if (challengeLength >= (int)sizeof(challenge))
+        return false;
+    for (int i = 0; i < challengeLength; i++) {
+        unsigned char c = arg[i];
+        if (c < ' ' || c > '~' || c == '\\' || c == ';' || c == '"')
+            return false;
+    }
+    memcpy(challenge, arg, challengeLength + 1);
+
+    // Server info dvar was changed and SV_Frame did not update the configstring yet
+    if (dvar_modifiedFlags & (DVAR_SERVERINFO | DVAR_SCRIPTINFO))
+        cache->valid = false;
+
+    // Scores, pings and other values not related to dvars are refreshed periodically
+    if (cache->valid && ticks_ms() - cache->time >= (uint64_t)sv_queryCache->value.integer)
+        cache->valid = false;
+
+    if (!cache->valid && !query_cache_build(cache, build, from, lastKey))
+        return false;
+
+    char packet[QUERY_CACHE_MAX_PACKET];
+    int suffixOffset = cache->challengeOffset + strlen(QUERY_CACHE_CHALLENGE_KEY);
+    int length = cache->challengeOffset;
+
+    memcpy(packet, cache->data, cache->challengeOffset);
+
+    // Empty challenge is not added by Info_SetValueForKey
+    if (challengeLength > 0) {
+        memcpy(packet + length, "\\challenge\\", 11);
+        length += 11;
+        memcpy(packet + length, challenge, challengeLength);
+        length += challengeLength;
+    }
+
+    memcpy(packet + length, cache->data + suffixOffset, cache->length - suffixOffset);
+    length += cache->length - suffixOffset;
+
+    NET_SendPacket(NS_SERVER, length, packet, from);
+
+    return true;
+}
+
+
+/**
+ * Reply to getstatus request, replaces SVC_Status.
+ */
+void query_cache_sendStatus(netaddr_s from) {
+    if (!query_cache_send(&query_cache_status, SVC_Status, from, "\\mod\\"))
+        SVC_Status(from);
+}
+
+/**
+ * Reply to getinfo request, replaces SVC_Info.
+ */
+void query_cache_sendInfo(netaddr_s from) {
+    if (!query_cache_send(&query_cache_info, SVC_Info, from, "\\pb\\"))
+        SVC_Info(from);
+}
+
+
+/**
+ * Cached responses are built again on next request.
+ * Called when clients, server info or map is changed.
+ */
+void query_cache_invalidate() {
+    query_cache_status.valid = false;
+    query_cache_info.valid = false;
+}
+
+
+/**
+ * SV_SetConfigstring(CS_SERVERINFO, Dvar_InfoString(DVAR_SERVERINFO | DVAR_SCRIPTINFO))
+ * Is called from SV_Frame when dvar with server info flag was modified.
+ */
+static void SV_SetConfigstring_ServerInfo(int index, const char* val) {
+    query_cache_invalidate();
+
+    ASM_CALL(RETURN_VOID, ADDR(0x00457ce0, 0x08092780), 2, PUSH(index), PUSH(val));
+}
+
+
+/** Called every frame on frame start. */
+void query_cache_frame() {
+
+    if (sv_queryCache->modified) {
+        sv_queryCache->modified = false;
+        query_cache_invalidate();
+    }
+
+    if (!sv_running || !sv_running->value.boolean)
+        return;
+
+    // Connected, disconnected or fully joined clients are visible in the responses
+    for (int i = 0; i < sv_maxclients->value.integer; i++) {
+        clientState_t state = svs_clients[i].state;
+        if (state != query_cache_clientStates[i]) {
+            query_cache_clientStates[i] = state;
+            query_cache_invalidate();
+        }
+    }
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void query_cache_init() {
+
+    // Maximum age of cached getstatus and getinfo responses in milliseconds, 0 disables the cache
+    sv_queryCache = Dvar_RegisterInt("sv_queryCache", 1000, 0, 60000, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+}
+
+/** Called before the entry point is called. Used to patch the memory. */
+void query_cache_patch() {
+
+    patch_call(ADDR(0x0045c7e3, 0x08096d3b), (unsigned int)SV_SetConfigstring_ServerInfo); // SV_Frame
+}
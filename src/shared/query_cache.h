@@ -0,0 +1,12 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+bool query_cache_capture(int length, const void* data);
+void query_cache_sendStatus(struct netaddr_s from);
+void query_cache_sendInfo(struct netaddr_s from);
+void query_cache_invalidate();
+void query_cache_frame();
+void query_cache_init();
+void query_cache_patch();
+
+#endif
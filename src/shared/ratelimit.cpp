@@ -0,0 +1,376 @@
+#include "ratelimit.h"
+
+#include <string.h>
+#include <time.h>
+
+// Buckets are indexed by open addressing table with linear probing that is kept at most half full,
+// so lookup, insert and remove are O(1) even when flooded from random addresses.
+// Expired buckets are reclaimed from the tail of LRU list, so no scan over all buckets is needed.
+// When the table is full of active buckets, the least recently used one is evicted, so new addresses are never refused
+// just because the table is full, they are still limited by the prefix and overall buckets.
+#define RATELIMIT_TABLE_MASK (RATELIMIT_TABLE_SIZE - 1)
+
+// Maximum number of expired buckets reclaimed by one call
+#define MAX_RECLAIM 4
+
+
+static uint32_t ratelimit_hashForKey( ratelimitTable_t* table, const unsigned char* adr, unsigned char type )
+{
+	uint32_t hash;
+	memcpy( &hash, adr, 4 );
+
+	// Seeded murmur3 finalizer, so the slots can not be predicted by spoofing addresses
+	hash ^= table->hashSeed + type * 0x9e3779b9;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+// Returns true if the key was found, slot is set to its position or to the empty slot where it can be inserted
+static bool ratelimit_findSlot( ratelimitTable_t* table, const unsigned char* adr, unsigned char type, uint32_t hash, uint32_t* slot )
+{
+	uint32_t i = hash & RATELIMIT_TABLE_MASK;
+
+	while ( table->slots[ i ] != 0 )
+	{
+		leakyBucket_t* bucket = &table->buckets[ table->slots[ i ] - 1 ];
+		if ( bucket->hash == hash && bucket->type == type && memcmp( bucket->adr, adr, 4 ) == 0 )
+		{
+			*slot = i;
+			return true;
+		}
+		i = ( i + 1 ) & RATELIMIT_TABLE_MASK;
+	}
+
+	*slot = i;
+	return false;
+}
+
+// Remove the slot and shift back following entries of the same cluster, so no tombstones are needed
+static void ratelimit_removeSlot( ratelimitTable_t* table, uint32_t slot )
+{
+	uint32_t i = slot;
+	uint32_t j = slot;
+
+	while ( true )
+	{
+		j = ( j + 1 ) & RATELIMIT_TABLE_MASK;
+		if ( table->slots[ j ] == 0 )
+			break;
+
+		// Entry can stay if its ideal slot is cyclically in range (i, j]
+		uint32_t k = table->buckets[ table->slots[ j ] - 1 ].hash & RATELIMIT_TABLE_MASK;
+		if ( i <= j ? ( i < k && k <= j ) : ( i < k || k <= j ) )
+			continue;
+
+		table->slots[ i ] = table->slots[ j ];
+		i = j;
+	}
+
+	table->slots[ i ] = 0;
+}
+
+static void ratelimit_unlink( ratelimitTable_t* table, leakyBucket_t* bucket )
+{
+	if ( bucket->prev != NULL )
+		bucket->prev->next = bucket->next;
+	else
+		table->lruHead = bucket->next;
+
+	if ( bucket->next != NULL )
+		bucket->next->prev = bucket->prev;
+	else
+		table->lruTail = bucket->prev;
+
+	bucket->prev = NULL;
+	bucket->next = NULL;
+}
+
+static void ratelimit_pushFront( ratelimitTable_t* table, leakyBucket_t* bucket )
+{
+	bucket->prev = NULL;
+	bucket->next = table->lruHead;
+
+	if ( table->lruHead != NULL )
+		table->lruHead->prev = bucket;
+	else
+		table->lruTail = bucket;
+
+	table->lruHead = bucket;
+}
+
+static void ratelimit_reclaim( ratelimitTable_t* table, leakyBucket_t* bucket )
+{
+	uint32_t slot;
+	if ( ratelimit_findSlot( table, bucket->adr, bucket->type, bucket->hash, &slot ) )
+		ratelimit_removeSlot( table, slot );
+
+	ratelimit_unlink( table, bucket );
+	memset( bucket, 0, sizeof( leakyBucket_t ) );
+
+	bucket->next = table->freeBuckets;
+	table->freeBuckets = bucket;
+	table->bucketCount--;
+}
+
+
+static leakyBucket_t* ratelimit_bucketForKey( ratelimitTable_t* table, const unsigned char* adr, unsigned char type, int burst, int period, uint64_t now )
+{
+	if ( !table->initialized )
+		ratelimit_clear( table );
+
+	uint32_t hash = ratelimit_hashForKey( table, adr, type );
+	uint32_t slot;
+
+	if ( ratelimit_findSlot( table, adr, type, hash, &slot ) )
+	{
+		leakyBucket_t* bucket = &table->buckets[ table->slots[ slot ] - 1 ];
+
+		// Move to the front of LRU list
+		if ( bucket != table->lruHead )
+		{
+			ratelimit_unlink( table, bucket );
+			ratelimit_pushFront( table, bucket );
+		}
+		return bucket;
+	}
+
+	// Reclaim expired buckets, the least recently used bucket is the best candidate
+	for ( int i = 0; i < MAX_RECLAIM && table->lruTail != NULL; i++ )
+	{
+		int interval = now - table->lruTail->lastTime;
+
+		if ( interval > ( burst * period ) || interval < 0 )
+			ratelimit_reclaim( table, table->lruTail );
+		else
+			break;
+	}
+
+	// Table is full, evict the least recently used bucket, its address loses its burst state
+	if ( table->freeBuckets == NULL )
+	{
+		table->evicted++;
+		ratelimit_reclaim( table, table->lruTail );
+	}
+
+	// Slots might have been shifted by reclaim
+	ratelimit_findSlot( table, adr, type, hash, &slot );
+
+	leakyBucket_t* bucket = table->freeBuckets;
+	table->freeBuckets = bucket->next;
+
+	memcpy( bucket->adr, adr, 4 );
+	bucket->type = type;
+	bucket->lastTime = now;
+	bucket->burst = 0;
+	bucket->bytes = 0;
+	bucket->hash = hash;
+
+	table->slots[ slot ] = (uint16_t)( bucket - table->buckets + 1 );
+	ratelimit_pushFront( table, bucket );
+	table->bucketCount++;
+
+	return bucket;
+}
+
+leakyBucket_t* ratelimit_bucketForAddress( ratelimitTable_t* table, const unsigned char* adr, int burst, int period, uint64_t now )
+{
+	return ratelimit_bucketForKey( table, adr, RATELIMIT_KEY_ADDRESS, burst, period, now );
+}
+
+leakyBucket_t* ratelimit_bucketForPrefix( ratelimitTable_t* table, const unsigned char* adr, int burst, int period, uint64_t now )
+{
+	unsigned char prefix[4] = { adr[0], adr[1], adr[2], 0 };
+	return ratelimit_bucketForKey( table, prefix, RATELIMIT_KEY_PREFIX, burst, period, now );
+}
+
+
+// Returns true if the rate limit is exceeded
+bool ratelimit_check( leakyBucket_t* bucket, int burst, int period, uint64_t now )
+{
+	if ( bucket != NULL )
+	{
+		int interval = now - bucket->lastTime;
+		int expired = interval / period;
+		int expiredRemainder = interval % period;
+
+		if ( expired > bucket->burst || interval < 0 )
+		{
+			bucket->burst = 0;
+			bucket->lastTime = now;
+		}
+		else
+		{
+			bucket->burst -= expired;
+			bucket->lastTime = now - expiredRemainder;
+		}
+
+		if ( bucket->burst < burst )
+		{
+			bucket->burst++;
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Returns true if more than maxBytes were sent in last period, the sent bytes expire continuously
+bool ratelimit_checkBytes( leakyBucket_t* bucket, int maxBytes, int period, uint64_t now )
+{
+	if ( bucket == NULL )
+		return true;
+
+	int interval = now - bucket->lastTime;
+
+	if ( interval < 0 || interval >= period )
+	{
+		bucket->bytes = 0;
+		bucket->lastTime = now;
+	}
+	else
+	{
+		int expired = (int)( (int64_t)maxBytes * interval / period );
+		if ( expired > 0 )
+		{
+			bucket->bytes = bucket->bytes > expired ? bucket->bytes - expired : 0;
+			bucket->lastTime = now;
+		}
+	}
+
+	return bucket->bytes >= maxBytes;
+}
+
+void ratelimit_chargeBytes( leakyBucket_t* bucket, int bytes )
+{
+	if ( bucket != NULL )
+		bucket->bytes += bytes;
+}
+
+
+int ratelimit_bucketCount( ratelimitTable_t* table )
+{
+	return table->bucketCount;
+}
+
+uint32_t ratelimit_evictedCount( ratelimitTable_t* table )
+{
+	return table->evicted;
+}
+
+void ratelimit_clear( ratelimitTable_t* table )
+{
+	memset( table->buckets, 0, sizeof( table->buckets ) );
+	memset( table->slots, 0, sizeof( table->slots ) );
+
+	table->freeBuckets = NULL;
+	for ( int i = RATELIMIT_MAX_BUCKETS - 1; i >= 0; i-- )
+	{
+		table->buckets[ i ].next = table->freeBuckets;
+		table->freeBuckets = &table->buckets[ i ];
+	}
+
+	table->lruHead = NULL;
+	table->lruTail = NULL;
+	table->bucketCount = 0;
+	table->evicted = 0;
+	table->hashSeed = (uint32_t)time( NULL ) ^ (uint32_t)(uintptr_t)table;
+	table->initialized = true;
+}
+
+
+
+// Space-saving algorithm (Metwally et al.), every prefix with frequency above 1/RATELIMIT_HEAVY_HITTERS is guaranteed to be tracked
+// Its updated by the thread that runs the rate limiter and read by the main thread, so its guarded by spin lock
+static void ratelimit_heavyHitterLock( heavyHitters_t* hitters )
+{
+	while ( hitters->lock.exchange( true, std::memory_order_acquire ) )
+		;
+}
+
+static void ratelimit_heavyHitterUnlock( heavyHitters_t* hitters )
+{
+	hitters->lock.store( false, std::memory_order_release );
+}
+
+void ratelimit_heavyHitterAdd( heavyHitters_t* hitters, const unsigned char* adr )
+{
+	uint32_t prefix = 0;
+	memcpy( &prefix, adr, 3 );
+
+	ratelimit_heavyHitterLock( hitters );
+
+	heavyHitter_t* min = NULL;
+	int i;
+	for ( i = 0; i < hitters->count; i++ )
+	{
+		heavyHitter_t* item = &hitters->items[ i ];
+		if ( item->prefix == prefix )
+		{
+			item->count++;
+			break;
+		}
+		if ( min == NULL || item->count < min->count )
+			min = item;
+	}
+
+	if ( i == hitters->count )
+	{
+		if ( hitters->count < RATELIMIT_HEAVY_HITTERS )
+		{
+			heavyHitter_t* item = &hitters->items[ hitters->count++ ];
+			item->prefix = prefix;
+			item->count = 1;
+			item->error = 0;
+		}
+		else
+		{
+			// Replace the least frequent prefix, its count is the maximum error of the new one
+			min->prefix = prefix;
+			min->error = min->count;
+			min->count++;
+		}
+	}
+
+	ratelimit_heavyHitterUnlock( hitters );
+}
+
+// Copy the tracked prefixes sorted by count, returns number of items
+int ratelimit_heavyHitterTop( heavyHitters_t* hitters, heavyHitter_t* items, int maxItems )
+{
+	ratelimit_heavyHitterLock( hitters );
+
+	int count = hitters->count < maxItems ? hitters->count : maxItems;
+	heavyHitter_t all[ RATELIMIT_HEAVY_HITTERS ];
+	int total = hitters->count;
+	memcpy( all, hitters->items, sizeof( heavyHitter_t ) * total );
+
+	ratelimit_heavyHitterUnlock( hitters );
+
+	for ( int i = 0; i < count; i++ )
+	{
+		int best = i;
+		for ( int j = i + 1; j < total; j++ )
+			if ( all[ j ].count > all[ best ].count )
+				best = j;
+
+		heavyHitter_t tmp = all[ i ];
+		all[ i ] = all[ best ];
+		all[ best ] = tmp;
+		items[ i ] = all[ i ];
+	}
+
+	return count;
+}
+
+void ratelimit_heavyHitterClear( heavyHitters_t* hitters )
+{
+	ratelimit_heavyHitterLock( hitters );
+	hitters->count = 0;
+	ratelimit_heavyHitterUnlock( hitters );
+}
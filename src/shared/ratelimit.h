@@ -0,0 +1,71 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <cstdint>
+#include <atomic>
+
+// ioquake3 rate limit connectionless requests
+// https://github.com/ioquake/ioq3/blob/master/code/server/sv_main.c
+// This is deliberately quite large to make it more of an effort to DoS
+#define RATELIMIT_MAX_BUCKETS		16384
+// Open addressing table is kept at most half full
+#define RATELIMIT_TABLE_SIZE		(RATELIMIT_MAX_BUCKETS * 2)
+// Number of prefixes tracked by heavy hitters sketch
+#define RATELIMIT_HEAVY_HITTERS		32
+
+typedef enum {
+	RATELIMIT_KEY_ADDRESS,	// single IPv4 address
+	RATELIMIT_KEY_PREFIX,	// IPv4 /24 prefix
+} ratelimitKey_e;
+
+typedef struct leakyBucket_s leakyBucket_t;
+struct leakyBucket_s
+{
+	unsigned char adr[4];
+	unsigned char type;		// ratelimitKey_e
+	uint64_t lastTime;
+	signed char	burst;
+	int32_t bytes;			// outbound bytes not yet expired, used by byte budget
+	uint32_t hash;
+	leakyBucket_t *prev, *next; // LRU list, next is also used to link free buckets
+};
+
+typedef struct {
+	leakyBucket_t buckets[RATELIMIT_MAX_BUCKETS];
+	uint16_t slots[RATELIMIT_TABLE_SIZE]; // index of bucket + 1, 0 means empty slot
+	leakyBucket_t* freeBuckets;
+	leakyBucket_t* lruHead;	// most recently used
+	leakyBucket_t* lruTail;	// least recently used
+	int bucketCount;
+	uint32_t evicted;		// active buckets evicted because the table was full
+	uint32_t hashSeed;
+	bool initialized;
+} ratelimitTable_t;
+
+typedef struct {
+	uint32_t prefix;		// /24 prefix in network order, last byte is 0
+	uint32_t count;			// estimated count, overestimated by at most error
+	uint32_t error;
+} heavyHitter_t;
+
+// Space-saving sketch of the most frequent /24 prefixes
+typedef struct {
+	heavyHitter_t items[RATELIMIT_HEAVY_HITTERS];
+	int count;
+	std::atomic<bool> lock;
+} heavyHitters_t;
+
+leakyBucket_t* ratelimit_bucketForAddress(ratelimitTable_t* table, const unsigned char* adr, int burst, int period, uint64_t now);
+leakyBucket_t* ratelimit_bucketForPrefix(ratelimitTable_t* table, const unsigned char* adr, int burst, int period, uint64_t now);
+bool ratelimit_check(leakyBucket_t* bucket, int burst, int period, uint64_t now);
+bool ratelimit_checkBytes(leakyBucket_t* bucket, int maxBytes, int period, uint64_t now);
+void ratelimit_chargeBytes(leakyBucket_t* bucket, int bytes);
+int ratelimit_bucketCount(ratelimitTable_t* table);
+uint32_t ratelimit_evictedCount(ratelimitTable_t* table);
+void ratelimit_clear(ratelimitTable_t* table);
+
+void ratelimit_heavyHitterAdd(heavyHitters_t* hitters, const unsigned char* adr);
+int ratelimit_heavyHitterTop(heavyHitters_t* hitters, heavyHitter_t* items, int maxItems);
+void ratelimit_heavyHitterClear(heavyHitters_t* hitters);
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include "mongoose/mongoose.h"
+#include "io_thread.h"
+#include <functional>
+#include <vector>
+#include <atomic>
+
+#undef poll
+
+/**
+ * Event loop shared by all HTTP and WebSocket clients of the process.
+ * Connections of all clients are in one Mongoose manager, so one poll per frame services all of them.
+ * The manager is polled by poll() on the main thread or by the background I/O thread.
+ * Code that uses the manager must be run by run(), callbacks for the main thread are passed by post().
+ */
+class NetReactor {
+  public:
+    using Task = std::function<void()>;
+    using Timer = std::function<bool()>; // Returns true if the owner has requests in progress
+
+    // The reactor is never destroyed, connections may be still open on exit
+    static NetReactor& instance() {
+        static NetReactor* reactor = new NetReactor();
+        return *reactor;
+    }
+
+    struct mg_mgr* get_mgr() {
+        return &mgr;
+    }
+
+    bool is_threaded() const {
+        return io != nullptr;
+    }
+
+    // Start or stop the background I/O thread, open connections are kept
+    bool set_threaded(bool threaded) {
+        if (threaded == (io != nullptr))
+            return true;
+
+        if (threaded) {
+            io = new IoThread(&mgr);
+            io->onPoll = [this]() { return update_timers(); };
+            if (!io->start()) {
+                delete io;
+                io = nullptr;
+                return false;
+            }
+        } else {
+            io->stop();
+            IoThread* stopped = io;
+            io = nullptr;
+            stopped->drain();
+            delete stopped;
+        }
+        return true;
+    }
+
+    // Run the task on the thread that polls the manager
+    void run(Task task) {
+        if (io)
+            io->submit(std::move(task));
+        else
+            task();
+    }
+
+    // Run the task on the thread that polls the manager and wait until it is done
+    void run_sync(Task task) {
+        if (!io) {
+            task();
+            return;
+        }
+        std::atomic<bool> done{false};
+        io->submit([&task, &done]() {
+            task();
+            done.store(true, std::memory_order_release);
+        });
+        while (!done.load(std::memory_order_acquire)) {
+            #if defined(_WIN32)
+                Sleep(1);
+            #else
+                usleep(1000);
+            #endif
+        }
+    }
+
+    // Call the callback on the main thread, is called immediately if the manager is polled by the main thread
+    void post(Task task) {
+        if (io)
+            io->post(std::move(task));
+        else
+            task();
+    }
+
+    // Poll the manager, or call the callbacks posted by the I/O thread, waits at most wait_time_ms
+    void poll(int wait_time_ms = 0) {
+        if (io) {
+            io->drain(wait_time_ms);
+            return;
+        }
+        update_timers();
+        mg_mgr_poll(&mgr, wait_time_ms);
+    }
+
+    // Call the callbacks posted by the I/O thread
+    void drain() {
+        if (io)
+            io->drain();
+    }
+
+    // Timer is called before every poll of the manager, must be added and removed in run()
+    void add_timer(const void* owner, Timer timer) {
+        timers.push_back({owner, std::move(timer)});
+    }
+
+    void remove_timer(const void* owner) {
+        for (auto it = timers.begin(); it != timers.end(); ++it) {
+            if (it->owner == owner) {
+                timers.erase(it);
+                return;
+            }
+        }
+    }
+
+  private:
+    struct TimerEntry {
+        const void* owner;
+        Timer timer;
+    };
+
+    mg_mgr mgr;
+    IoThread* io = nullptr;
+    std::vector<TimerEntry> timers;
+
+    NetReactor() {
+        mg_log_set(MG_LL_NONE);
+        mg_mgr_init(&mgr);
+    }
+
+    bool update_timers() {
+        bool active = false;
+        // Timer may remove other timers when it closes connections
+        for (size_t i = 0; i < timers.size(); i++)
+            active |= timers[i].timer();
+        return active;
+    }
+};
+
+#endif
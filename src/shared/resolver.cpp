@@ -0,0 +1,275 @@
+#include "resolver.h"
+#include "shared.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <atomic>
+#if COD2X_WIN32
+    #include <winsock2.h> // must be included before windows.h
+    #include <ws2tcpip.h>
+    #include <windows.h>
+#endif
+#if COD2X_LINUX
+    #include <pthread.h>
+    #include <unistd.h>
+    #include <netdb.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+#endif
+
+#include "cod2_common.h"
+#include "cod2_shared.h"
+#include "cod2_dvars.h"
+#include "cod2_net.h"
+
+#define RESOLVER_MAX_HOSTS      16
+#define RESOLVER_HOST_LENGTH    256
+// Failed lookup is repeated after this time, the last known address is used meanwhile
+#define RESOLVER_RETRY_MS       30000
+
+typedef enum {
+    RESOLVER_STATE_IDLE,        // owned by main thread
+    RESOLVER_STATE_REQUESTED,   // owned by resolver thread
+    RESOLVER_STATE_DONE,        // result is written, owned by main thread
+} resolverState_e;
+
+typedef struct {
+    char host[RESOLVER_HOST_LENGTH];
+    std::atomic<int> state;     // resolverState_e
+    // Result of the lookup, written by resolver thread before the state is set to done
+    bool resultValid;
+    uint8_t resultIp[4];
+    // Main thread only
+    bool used;
+    bool resolved;              // address was resolved at least once
+    bool failed;                // last lookup failed
+    uint8_t ip[4];
+    uint64_t expireTime;
+    uint64_t lastUsedTime;
+} resolverHost_t;
+
+dvar_t* net_dnsTTL;
+
+static resolverHost_t resolver_hosts[RESOLVER_MAX_HOSTS];
+static bool resolver_threadRunning = false;
+static volatile bool resolver_exitThread = false;
+
+#if COD2X_WIN32
+static HANDLE resolver_thread = NULL;
+#endif
+#if COD2X_LINUX
+static pthread_t resolver_thread;
+#endif
+
+
+// Blocking lookup, called only by resolver thread
+static bool resolver_resolve(const char* host, uint8_t* ip) {
+    struct addrinfo hints;
+    struct addrinfo* result = NULL;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if (getaddrinfo(host, NULL, &hints, &result) != 0 || result == NULL)
+        return false;
+
+    memcpy(ip, &((struct sockaddr_in*)result->ai_addr)->sin_addr, 4);
+    freeaddrinfo(result);
+
+    return true;
+}
+
+#if COD2X_WIN32
+static DWORD WINAPI resolver_threadProc(LPVOID arg) {
+#else
+static void* resolver_threadProc(void* arg) {
+#endif
+    (void)arg;
+
+    while (!resolver_exitThread) {
+        for (int i = 0; i < RESOLVER_MAX_HOSTS; i++) {
+            resolverHost_t* entry = &resolver_hosts[i];
+            if (entry->state.load(std::memory_order_acquire) != RESOLVER_STATE_REQUESTED)
+                continue;
+
+            entry->resultValid = resolver_resolve(entry->host, entry->resultIp);
+            entry->state.store(RESOLVER_STATE_DONE, std::memory_order_release);
+        }
+        #if COD2X_WIN32
+            Sleep(20);
+        #else
+            usleep(20000);
+        #endif
+    }
+
+    return 0;
+}
+
+static bool resolver_startThread() {
+    if (resolver_threadRunning)
+        return true;
+
+    resolver_exitThread = false;
+
+    #if COD2X_WIN32
+        resolver_thread = CreateThread(NULL, 0, resolver_threadProc, NULL, 0, NULL);
+        resolver_threadRunning = resolver_thread != NULL;
+    #else
+        resolver_threadRunning = pthread_create(&resolver_thread, NULL, resolver_threadProc, NULL) == 0;
+    #endif
+
+    if (!resolver_threadRunning)
+        Com_Printf("Failed to create resolver thread\n");
+
+    return resolver_threadRunning;
+}
+
+
+// Take the result of finished lookup
+static void resolver_update(resolverHost_t* entry) {
+    if (entry->state.load(std::memory_order_acquire) != RESOLVER_STATE_DONE)
+        return;
+
+    uint64_t now = ticks_ms();
+
+    if (entry->resultValid) {
+        if (!entry->resolved || memcmp(entry->ip, entry->resultIp, 4) != 0) {
+            Com_Printf("%s resolved to %i.%i.%i.%i\n", entry->host, entry->resultIp[0], entry->resultIp[1], entry->resultIp[2], entry->resultIp[3]);
+        }
+        memcpy(entry->ip, entry->resultIp, 4);
+        entry->resolved = true;
+        entry->failed = false;
+        entry->expireTime = now + (uint64_t)net_dnsTTL->value.integer * 1000;
+    } else {
+        Com_Printf("Couldn't resolve address: %s%s\n", entry->host, entry->resolved ? ", using last known address" : "");
+        entry->failed = true;
+        entry->expireTime = now + RESOLVER_RETRY_MS;
+    }
+
+    entry->state.store(RESOLVER_STATE_IDLE, std::memory_order_release);
+}
+
+static resolverHost_t* resolver_findHost(const char* host) {
+    resolverHost_t* replace = NULL;
+
+    for (int i = 0; i < RESOLVER_MAX_HOSTS; i++) {
+        resolverHost_t* entry = &resolver_hosts[i];
+        if (entry->used && Q_stricmp(entry->host, host) == 0)
+            return entry;
+
+        // Host used least recently is replaced, the host must not be written while the lookup is running
+        resolver_update(entry);
+        if (entry->state.load(std::memory_order_acquire) != RESOLVER_STATE_IDLE)
+            continue;
+        if (replace == NULL || !entry->used || (replace->used && entry->lastUsedTime < replace->lastUsedTime))
+            replace = entry;
+    }
+
+    if (replace == NULL)
+        return NULL;
+
+    Q_strncpyz(replace->host, host, sizeof(replace->host));
+    replace->used = true;
+    replace->resolved = false;
+    replace->failed = false;
+    replace->expireTime = 0;
+
+    return replace;
+}
+
+
+/**
+ * Get the address of host in format "host" or "host:port" without blocking.
+ * The lookup runs in background thread, results are cached for net_dnsTTL seconds.
+ * When the cached address expires, the last known address is returned until the new lookup finishes.
+ */
+resolverStatus_e resolver_lookup(const char* name, int defaultPort, netaddr_s* adr) {
+    char host[RESOLVER_HOST_LENGTH];
+    int port = defaultPort;
+
+    Q_strncpyz(host, name, sizeof(host));
+
+    // Port
+    char* colon = strrchr(host, ':');
+    if (colon != NULL && colon[1] != '\0') {
+        bool digits = true;
+        for (char* c = colon + 1; *c; c++)
+            digits = digits && isdigit((unsigned char)*c);
+        if (digits) {
+            port = atoi(colon + 1);
+            *colon = '\0';
+        }
+    }
+
+    if (host[0] == '\0')
+        return RESOLVER_FAILED;
+
+    memset(adr, 0, sizeof(*adr));
+    adr->type = NA_IP;
+    adr->port = BigShort((short)port);
+
+    // Numeric address does not need the lookup
+    int a, b, c, d;
+    char end;
+    if (sscanf(host, "%i.%i.%i.%i%c", &a, &b, &c, &d, &end) == 4 &&
+        a >= 0 && a <= 255 && b >= 0 && b <= 255 && c >= 0 && c <= 255 && d >= 0 && d <= 255) {
+        adr->ip[0] = a; adr->ip[1] = b; adr->ip[2] = c; adr->ip[3] = d;
+        return RESOLVER_OK;
+    }
+
+    resolverHost_t* entry = resolver_findHost(host);
+    if (entry == NULL)
+        return RESOLVER_PENDING; // all hosts are being resolved, try it later
+
+    resolver_update(entry);
+
+    uint64_t now = ticks_ms();
+    entry->lastUsedTime = now;
+
+    if (entry->state.load(std::memory_order_acquire) == RESOLVER_STATE_IDLE && now >= entry->expireTime && resolver_startThread()) {
+        Com_DPrintf("Resolving %s\n", entry->host);
+        entry->state.store(RESOLVER_STATE_REQUESTED, std::memory_order_release);
+    }
+
+    if (entry->resolved) {
+        memcpy(adr->ip, entry->ip, 4);
+        return RESOLVER_OK;
+    }
+
+    adr->type = NA_BAD;
+    return entry->failed ? RESOLVER_FAILED : RESOLVER_PENDING;
+}
+
+
+/** Called every frame on frame start. */
+void resolver_frame() {
+    for (int i = 0; i < RESOLVER_MAX_HOSTS; i++)
+        resolver_update(&resolver_hosts[i]);
+}
+
+/** Called once when DLL hot-reloading is activated. The resolver thread must not run the code of the unloaded DLL, running lookup is waited for. */
+void resolver_unload() {
+    if (!resolver_threadRunning)
+        return;
+
+    resolver_exitThread = true;
+
+    #if COD2X_WIN32
+        WaitForSingleObject(resolver_thread, INFINITE);
+        CloseHandle(resolver_thread);
+        resolver_thread = NULL;
+    #else
+        pthread_join(resolver_thread, NULL);
+    #endif
+
+    resolver_threadRunning = false;
+}
+
+/** Called only once on game start after common inicialization. Used to initialize variables, cvars, etc. */
+void resolver_init() {
+
+    // Time in seconds how long the resolved addresses of master, authorize and update servers are cached
+    net_dnsTTL = Dvar_RegisterInt("net_dnsTTL", 600, 10, 86400, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+}
@@ -0,0 +1,15 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+typedef enum {
+    RESOLVER_OK,        // address is set, it might be the last known address while the refresh is running
+    RESOLVER_PENDING,   // first lookup is running in background
+    RESOLVER_FAILED,    // host could not be resolved, lookup is repeated later
+} resolverStatus_e;
+
+resolverStatus_e resolver_lookup(const char* name, int defaultPort, struct netaddr_s* adr);
+void resolver_frame();
+void resolver_unload();
+void resolver_init();
+
+#endif
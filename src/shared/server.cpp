@@ -1,5 +1,7 @@
 #include "server.h"
 
+#include <atomic>
+
 #include "shared.h"
 #include "animation.h"
 #include "cod2_common.h"
@@ -16,11 +18,27 @@
 #include "gsc_http.h"
 #include "gsc_websocket.h"
 #include "match.h"
+#include "ratelimit.h"
+#include "connless.h"
+#include "challenge.h"
+#include "ban.h"
+#include "userinfo.h"
+#include "authorize_cache.h"
+#include "player_index.h"
+#include "player_interest.h"
+#include "netstats.h"
+#include "adaptive_snaps.h"
+#include "resolver.h"
+#include "query_cache.h"
+#include "capture.h"
 #if COD2X_WIN32
 #include "../mss32/updater.h"
 #endif
 #if COD2X_LINUX
 #include "../linux/updater.h"
+#include "../linux/ingress.h"
+#include "../linux/egress.h"
+#include "../linux/hibernate.h"
 #endif
 
 #define originalAuthorizeServerUrl 				((const char*)(ADDR(0x005a3c90, 0x08149afb)))
@@ -33,6 +51,9 @@ dvar_t*		sv_rateLimiter;
 dvar_t*		showpacketstrings;
 dvar_t*		sv_playerBroadcastLimit;
 int 		nextIPTime = 0;
+// CoD2x: Masters that did not get heartbeat or status because their address was not resolved yet
+int			masterHeartbeatPending = 0;
+int			masterStatusPending = 0;
 dvar_t*		g_competitive;
 bool		server_ignoreMapChangeThisFrame = false;
 
@@ -41,144 +62,162 @@ extern dvar_t* g_cod2x;
 
 
 
-// ioquake3 rate limit connectionless requests
-// https://github.com/ioquake/ioq3/blob/master/code/server/sv_main.c
-// This is deliberately quite large to make it more of an effort to DoS
-#define MAX_BUCKETS	16384
-#define MAX_HASHES 1024
+// CoD2x: Table of connection-less commands
+// Parsing, dispatch table and rate limiter are in connless.cpp, here are the engine related parts - handlers, dvars and commands
+typedef void (*svcCommandHandler_t)(netaddr_s from, msg_t* msg);
+
+typedef struct {
+	connlessCommand_t* command;
+	const char* action;				// name used in debug messages
+	svcCommandHandler_t handler;
+	dvar_t* rateLimit;				// sv_rl_<name>, NULL if the command is not rate limited
+	char rateLimitName[32];
+} svcCommand_t;
+
+static svcCommand_t svcCommands[CONNLESS_MAX_COMMANDS];
+static uint64_t svcCommandStatsTime = 0;
+dvar_t* sv_rl_outbound;
+// Bytes sent by NET_SendPacket to the address of currently handled request
+static bool svcOutboundTracking = false;
+static netaddr_s svcOutboundAddress;
+static int svcOutboundBytes = 0;
 
-static leakyBucket_t buckets[ MAX_BUCKETS ];
-static leakyBucket_t* bucketHashes[ MAX_HASHES ];
-leakyBucket_t outboundLeakyBucket;
 
-static long SVC_HashForAddress( netaddr_s address )
+static svcCommand_t* SVC_FindCommand( const char* name )
 {
-	unsigned char *ip = address.ip;
-	int	i;
-	long hash = 0;
+	connlessCommand_t* command = connless_findCommand(name);
+	if (command == NULL)
+		return NULL;
+	return &svcCommands[command->index];
+}
 
-	for ( i = 0; i < 4; i++ )
+static void SVC_UpdateRateLimitPolicy( svcCommand_t* command )
+{
+	if (!connless_parsePolicy(command->command, command->rateLimit->value.string))
 	{
-		hash += (long)( ip[ i ] ) * ( i + 119 );
+		Com_Printf("%s: invalid value '%s', expected '<addrBurst> <addrPeriod> <prefixBurst> <prefixPeriod> <overallBurst> <overallPeriod>' "
+			"with burst 1-127 and period in ms, or '0'\n", command->rateLimitName, command->rateLimit->value.string);
 	}
-
-	hash = ( hash ^ ( hash >> 10 ) ^ ( hash >> 20 ) );
-	hash &= ( MAX_HASHES - 1 );
-
-	return hash;
 }
 
-static leakyBucket_t *SVC_BucketForAddress( netaddr_s address, int burst, int period )
+static void SVC_UpdateOutboundPolicy()
 {
-	leakyBucket_t *bucket = NULL;
-	int	i;
-	long hash = SVC_HashForAddress( address );
-	uint64_t now = ticks_ms();
-
-	for ( bucket = bucketHashes[ hash ]; bucket; bucket = bucket->next )
+	if (!connless_parseOutboundPolicy(sv_rl_outbound->value.string))
 	{
-		if ( memcmp( bucket->adr, address.ip, 4 ) == 0 )
-		{
-			return bucket;
-		}
+		Com_Printf("sv_rl_outbound: invalid value '%s', expected '<bytes> <period ms>' or '0'\n", sv_rl_outbound->value.string);
 	}
+}
 
-	for ( i = 0; i < MAX_BUCKETS; i++ )
+/**
+ * Register connection-less command handled by SV_ConnectionlessPacket.
+ * If rateLimit is set, the command is rate limited by policy in dvar sv_rl_<name>.
+ */
+static void SVC_RegisterCommand( const char* name, const char* action, svcCommandHandler_t handler, const char* rateLimit = NULL )
+{
+	connlessCommand_t* connless = connless_registerCommand(name, rateLimit != NULL);
+	if (connless == NULL)
 	{
-		int interval;
-
-		bucket = &buckets[ i ];
-		interval = now - bucket->lastTime;
-
-		// Reclaim expired buckets
-		if ( bucket->lastTime > 0 && ( interval > ( burst * period ) ||
-		                               interval < 0 ) )
-		{
-			if ( bucket->prev != NULL )
-			{
-				bucket->prev->next = bucket->next;
-			}
-			else
-			{
-				bucketHashes[ bucket->hash ] = bucket->next;
-			}
-
-			if ( bucket->next != NULL )
-			{
-				bucket->next->prev = bucket->prev;
-			}
-
-			memset( bucket, 0, sizeof( leakyBucket_t ) );
-		}
-
-		if ( bucket->type == 0 )
-		{
-			bucket->type = address.type;
-			memcpy( bucket->adr, address.ip, 4 );
-
-			bucket->lastTime = now;
-			bucket->burst = 0;
-			bucket->hash = hash;
+		Com_Error(ERR_FATAL, "SVC_RegisterCommand: failed to register command '%s'", name);
+		return;
+	}
 
-			// Add to the head of the relevant hash chain
-			bucket->next = bucketHashes[ hash ];
-			if ( bucketHashes[ hash ] != NULL )
-			{
-				bucketHashes[ hash ]->prev = bucket;
-			}
+	svcCommand_t* command = &svcCommands[connless->index];
+	command->command = connless;
+	command->action = action;
+	command->handler = handler;
 
-			bucket->prev = NULL;
-			bucketHashes[ hash ] = bucket;
+	if (rateLimit != NULL)
+	{
+		snprintf(command->rateLimitName, sizeof(command->rateLimitName), "sv_rl_%s", name);
+		for (char* c = command->rateLimitName; *c; c++)
+			*c = tolower((unsigned char)*c);
 
-			return bucket;
-		}
+		command->rateLimit = Dvar_RegisterString(command->rateLimitName, rateLimit, (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+		command->rateLimit->modified = false;
+		SVC_UpdateRateLimitPolicy(command);
 	}
+}
 
-	// Couldn't allocate a bucket for this address
-	return NULL;
+// The ingress thread on Linux calls connless_rateLimit directly, Sys_IsLANAddress must be called only by main thread
+static svcRateLimit_e SVC_RateLimitCommand( netaddr_s from, const char* name )
+{
+	return connless_rateLimit(connless_findCommand(name), from.ip, Sys_IsLANAddress(from), ticks_ms());
 }
 
+static svcRateLimit_e SVC_RateLimitOutbound( netaddr_s from, const char* name )
+{
+	return connless_rateLimitOutbound(connless_findCommand(name), from.ip, from.type != NA_IP || Sys_IsLANAddress(from), ticks_ms());
+}
 
-bool SVC_RateLimit( leakyBucket_t *bucket, int burst, int period )
+static void SVC_ChargeOutbound( netaddr_s from, int bytes )
 {
-	if ( bucket != NULL )
+	if (from.type != NA_IP || !connless_isOutboundLimited())
+		return;
+	connless_chargeOutbound(from.ip, Sys_IsLANAddress(from), bytes, ticks_ms());
+}
+
+/** Print statistics of the rate limiter */
+static void SVC_RateLimitStats_f()
+{
+	if (Cmd_Argc() == 2 && Q_stricmp(Cmd_Argv(1), "clear") == 0)
 	{
-		uint64_t now = ticks_ms();
-		int interval = now - bucket->lastTime;
-		int expired = interval / period;
-		int expiredRemainder = interval % period;
+		connless_clearStats();
+		svcCommandStatsTime = ticks_ms();
+		Com_Printf("Rate limiter statistics cleared\n");
+		return;
+	}
 
-		if ( expired > bucket->burst || interval < 0 )
-		{
-			bucket->burst = 0;
-			bucket->lastTime = now;
-		}
-		else
-		{
-			bucket->burst -= expired;
-			bucket->lastTime = now - expiredRemainder;
-		}
+	connlessStats_t stats;
+	connless_getStats(&stats);
 
-		if ( bucket->burst < burst )
-		{
-			bucket->burst++;
+	Com_Printf("Buckets used: %i request, %i prefix, %i outbound (max %i each), %u evicted\n",
+		stats.buckets, stats.prefixBuckets, stats.outboundBuckets, RATELIMIT_MAX_BUCKETS, stats.evicted);
+	Com_Printf("Dropped requests: %u address, %u prefix, %u overall, %u outbound bytes\n",
+		stats.droppedAddress, stats.droppedPrefix, stats.droppedOverall, stats.droppedOutbound);
 
-			return false;
-		}
-	}
+	heavyHitter_t items[RATELIMIT_HEAVY_HITTERS];
+	int count = connless_topOffenders(items, 10);
+	if (count == 0)
+		return;
 
-	return true;
+	Com_Printf("Top offending prefixes:\n");
+	Com_Printf("prefix              dropped   error\n");
+	for (int i = 0; i < count; i++)
+	{
+		unsigned char* ip = (unsigned char*)&items[i].prefix;
+		Com_Printf("%3i.%3i.%3i.0/24    %-9u %u\n", ip[0], ip[1], ip[2], items[i].count, items[i].error);
+	}
 }
 
-bool SVC_RateLimitAddress( netaddr_s from, int burst, int period )
+/** Print statistics of connection-less commands since last call */
+static void SVC_NetStats_f()
 {
-	if (Sys_IsLANAddress(from))
-		return false;
-
-	leakyBucket_t *bucket = SVC_BucketForAddress( from, burst, period );
-
-	return SVC_RateLimit( bucket, burst, period );
+	uint64_t now = ticks_ms();
+	double seconds = (now - svcCommandStatsTime) / 1000.0;
+	if (seconds <= 0)
+		seconds = 0.001;
+	svcCommandStatsTime = now;
+
+	Com_Printf("command          req/s     drop/s    avg us    rate limit\n");
+	Com_Printf("---------------- --------- --------- --------- ----------------\n");
+	for (int i = 0; i < connless_commandCount(); i++)
+	{
+		svcCommand_t* command = &svcCommands[i];
+		connlessCommand_t* connless = command->command;
+		uint32_t accepted = connless->accepted.exchange(0);
+		uint32_t dropped = connless->dropped.exchange(0);
+		uint64_t handleTime = connless->handleTime;
+		connless->handleTime = 0;
+
+		Com_Printf("%-16s %9.1f %9.1f %9.1f %s\n", connless->name,
+			(accepted + dropped) / seconds,
+			dropped / seconds,
+			accepted > 0 ? (double)handleTime / accepted : 0.0,
+			command->rateLimit == NULL ? "-" : connless->addrBurst == 0 ? "off" : command->rateLimit->value.string);
+	}
+	Com_Printf("Statistics of last %.1f seconds\n", seconds);
 }
+// CoD2x: End
 
 
 
@@ -230,11 +269,17 @@ into a more C friendly form.
 */
 void SV_UserinfoChanged( client_t *cl )
 {
-	const char	*val;
 	int		i;
 
+	// CoD2x: Userinfo is parsed only once instead of calling Info_ValueForKey for each key
+	userinfo_t* info = userinfo_update(cl - svs_clients);
+
+	// CoD2x: Client is added into the list of connected clients
+	player_index_add(cl - svs_clients);
+	// CoD2x: End
+
 	// name for C code
-	Q_strncpyz( cl->name, Info_ValueForKey (cl->userinfo, "name"), sizeof(cl->name) );
+	Q_strncpyz( cl->name, info->name, sizeof(cl->name) );
 
 	// rate command
 
@@ -246,10 +291,9 @@ void SV_UserinfoChanged( client_t *cl )
 	}
 	else
 	{
-		val = Info_ValueForKey (cl->userinfo, "rate");
-		if (strlen(val))
+		if (info->hasRate)
 		{
-			i = atoi(val);
+			i = info->rate;
 			cl->rate = i;
 			if (cl->rate < 1000)
 			{
@@ -267,10 +311,9 @@ void SV_UserinfoChanged( client_t *cl )
 	}
 
 	// snaps command
-	val = Info_ValueForKey (cl->userinfo, "snaps");
-	if (strlen(val))
+	if (info->hasSnaps)
 	{
-		i = atoi(val);
+		i = info->snaps;
 		if ( i < 1 )
 		{
 			i = 1;
@@ -289,14 +332,20 @@ void SV_UserinfoChanged( client_t *cl )
 	}
 
 	// voice command
-	val = Info_ValueForKey (cl->userinfo, "cl_voice");
-	cl->sendVoice = atoi(val) > 0;
+	cl->sendVoice = info->voice > 0;
 	if ( cl->rate < 5000 )
 		cl->sendVoice = 0;
 
 	// wwwdl command
-	val = Info_ValueForKey (cl->userinfo, "cl_wwwDownload");
-	cl->wwwOk = atoi(val) > 0;
+	cl->wwwOk = info->wwwDownload > 0;
+
+	// CoD2x: Rate and snaps might be raised by the server
+	adaptive_snaps_reset(cl - svs_clients);
+	// CoD2x: End
+
+	// CoD2x: Player name is visible in getstatus response
+	query_cache_invalidate();
+	// CoD2x: End
 }
 
 void SV_UserinfoChanged_Win32() {
@@ -311,6 +360,10 @@ void SV_UserinfoChanged_Win32() {
 void server_unbanAll_command() {
 	// Remove file main/ban.txt
 	bool ok = FS_Delete("ban.txt");
+
+	// CoD2x: Bans made by banHwid are removed as well
+	ban_clear();
+
 	if (ok) {
 		Com_Printf("All bans removed\n");
 	} else {
@@ -321,17 +374,22 @@ void server_unbanAll_command() {
 
 void SV_DirectConnect(netaddr_s addr)
 {
-	int i;
+	int i = -1; // stays -1 for loopback and bot clients
 
     Com_DPrintf("SV_DirectConnect(%s)\n", NET_AdrToString(addr));
 
-    const char *infoKeyValue = Cmd_Argv(1);
+	#if COD2X_LINUX
+	// CoD2x: Server runs at full frame rate while the client is connecting
+	if (!NET_IsLocalAddress(addr))
+		hibernate_wake("connect");
+	// CoD2x: End
+	#endif
 
-    char str[1024];
-    strncpy(str, infoKeyValue, 1023);
-    str[1023] = '\0';
+    // CoD2x: Userinfo is parsed only once instead of calling Info_ValueForKey for each key
+    userinfo_t info;
+    userinfo_parse(&info, Cmd_Argv(1));
 
-    int32_t protocolNum = atol(Info_ValueForKey(str, "protocol"));
+    int32_t protocolNum = info.protocol;
 
     if (protocolNum != 118)
     {   
@@ -348,7 +406,7 @@ void SV_DirectConnect(netaddr_s addr)
         return;
     }
 
-    int32_t cod2xNum = atol(Info_ValueForKey(str, "protocol_cod2x"));
+    int32_t cod2xNum = info.protocolCod2x;
 
     // CoD2x is not installed on 1.3 client
     if (cod2xNum == 0) {
@@ -371,7 +429,7 @@ void SV_DirectConnect(netaddr_s addr)
 
 
 	// Require HWID2
-	char* hwid2 = Info_ValueForKey(str, "cl_hwid2");
+	const char* hwid2 = info.hwid2;
 
 	if (hwid2 == NULL || strlen(hwid2) != 32)
 	{
@@ -391,40 +449,53 @@ void SV_DirectConnect(netaddr_s addr)
 
 
 
-	int challenge = atoi( Info_ValueForKey( str, "challenge" ) );
+	int challenge = info.challenge;
 
 	// loopback and bot clients don't need to challenge
 	if (!NET_IsLocalAddress(addr))
 	{
-		for (i = 0; i < MAX_CHALLENGES; i++)
+		// CoD2x: Stateless challenge is verified without the lookup, invalid connect is dropped
+		bool stateless = challenge_isStateless();
+		if (stateless && !challenge_verify(addr, challenge))
 		{
-			if ( NET_CompareAdr( addr, svs_challenges[i].adr ) )
-			{
-				if (challenge == svs_challenges[i].challenge )
-					break;
-			}
+			Com_DPrintf("    rejected connect with invalid challenge\n");
+			return;
+		}
+		// CoD2x: End
+
+		// CoD2x: Challenge is found by index instead of loop over all challenges
+		i = challenge_find(addr, challenge);
+		if (i == -1)
+		{
+			// CoD2x: Entry of verified challenge was overwritten by other clients, create it again
+			if (!stateless)
+				return; // will be handled in original function again
+			i = challenge_restore(addr, challenge);
 		}
-		if (i == MAX_CHALLENGES)
-			return; // will be handled in original function again
 
 		// CoD2x: change GUID to HWID
 		svs_challenges[i].guid = hwid;
 	}
 
 
-	if (SV_IsBannedGuid(hwid))
+	// CoD2x: Bans are looked up in memory index instead of parsing ban.txt on every connect
+	banStatus_e ban = ban_isEnabled() ? ban_check(hwid) : (SV_IsBannedGuid(hwid) ? BAN_PERMANENT : BAN_NONE);
+
+	if (ban == BAN_PERMANENT)
 	{
 		Com_Printf("rejected connection from permanently banned HWID %i\n", hwid);
-		NET_OutOfBandPrint( NS_SERVER, svs_challenges[i].adr, "error\n\x15You are permanently banned from this server" );
-		memset( &svs_challenges[i], 0, sizeof( svs_challenges[i]));
+		NET_OutOfBandPrint( NS_SERVER, addr, "error\n\x15You are permanently banned from this server" );
+		if (i != -1)
+			challenge_clear(i);
 		return;
 	}
 
-	if (SV_IsTempBannedGuid(hwid))
+	if (ban == BAN_TEMPORARY || SV_IsTempBannedGuid(hwid))
 	{
 		Com_Printf("rejected connection from temporarily banned HWID %i\n", hwid);
-		NET_OutOfBandPrint( NS_SERVER, svs_challenges[i].adr, "error\n\x15You are temporarily banned from this server" );
-		memset( &svs_challenges[i], 0, sizeof( svs_challenges[i]));
+		NET_OutOfBandPrint( NS_SERVER, addr, "error\n\x15You are temporarily banned from this server" );
+		if (i != -1)
+			challenge_clear(i);
 		return;
 	}
 
@@ -436,45 +507,49 @@ void SV_DirectConnect(netaddr_s addr)
 
 
 // Resolve the master server address
-netaddr_s * SV_MasterAddress(int i)
+// CoD2x: Address is resolved in background, the type is NA_BAD until its resolved, then the last known address is used until its refreshed
+netaddr_s * SV_MasterAddress(int i, resolverStatus_e* status = NULL)
 {
-	if (masterServerAddr[i].type == NA_INIT || sv_master[i]->modified)
-	{
-		sv_master[i]->modified = false;
+	sv_master[i]->modified = false;
+
+	resolverStatus_e result = resolver_lookup(sv_master[i]->value.string, SERVER_MASTER_PORT, &masterServerAddr[i]);
+	if (result != RESOLVER_OK)
+		masterServerAddr[i].type = NA_BAD;
+
+	if (status != NULL)
+		*status = result;
 
-		Com_Printf("Resolving master server %s\n", sv_master[i]->value.string);
-		if (NET_StringToAdr(sv_master[i]->value.string, &masterServerAddr[i]) == 0)
-		{
-			Com_Printf("Couldn't resolve address: %s\n", sv_master[i]->value.string);
-			// Address type is set to NA_BAD, so it will not be resolved again
-		}
-		else
-		{
-			if (strstr(":", sv_master[i]->value.string) == 0)
-			{
-				masterServerAddr[i].port = BigShort(SERVER_MASTER_PORT);
-			}
-			Com_Printf( "%s resolved to %s\n", sv_master[i]->value.string, NET_AdrToString(masterServerAddr[i]));
-		}
-	}
 	return &masterServerAddr[i];
 }
 
 
-void server_cmd_getIp()
+// Returns false if the address of the master server is not resolved yet
+bool server_sendGetIp()
 {
+	bool resolved = true;
 	for (int i = 0 ; i < MAX_MASTER_SERVERS; i++)
 	{
 		if (strcmp(sv_master[i]->value.string, SERVER_MASTER_URI) != 0) // find CoD2x master server
 			continue;
 
-		SV_MasterAddress(i); // Resolve the master server address in cause its not resolved yet or sv_master was modified
+		resolverStatus_e status;
+		SV_MasterAddress(i, &status); // Resolve the master server address in cause its not resolved yet or sv_master was modified
 
 		if (masterServerAddr[i].type != NA_BAD)
 		{
 			NET_OutOfBandPrint(NS_SERVER, masterServerAddr[i], "getIp");
 		}
+		else if (status == RESOLVER_PENDING)
+		{
+			resolved = false;
+		}
 	}
+	return resolved;
+}
+
+void server_cmd_getIp()
+{
+	server_sendGetIp();
 }
 
 
@@ -523,44 +598,54 @@ void SV_MasterHeartbeat( const char *hbname )
 	if ( svs_time >= svs_nextHeartbeatTime )
 	{
 		svs_nextHeartbeatTime = svs_time + HEARTBEAT_MSEC;
-
-		// CoD2x: Send heartbeats to multiple master servers
-		for (i = 0 ; i < MAX_MASTER_SERVERS; i++)
-		{
-			if (sv_master[i]->value.string[0] == '\0')
-				continue;
-			
-			SV_MasterAddress(i); // Resolve the master server address in cause its not resolved yet or sv_master was modified
-
-			if (masterServerAddr[i].type != NA_BAD)
-			{
-				Com_DPrintf( "Sending heartbeat to %s\n", sv_master[i]->value.string );
-				NET_OutOfBandPrint( NS_SERVER, masterServerAddr[i], va("heartbeat %s\n", hbname));
-			}
-		}
-		// CoD2x: End
+		masterHeartbeatPending = (1 << MAX_MASTER_SERVERS) - 1;
 	}
 
 	// Its time to send a status response to the master servers
 	if ( svs_time >= svs_nextStatusResponseTime )
 	{
 		svs_nextStatusResponseTime = svs_time + STATUS_MSEC;
+		masterStatusPending = (1 << MAX_MASTER_SERVERS) - 1;
+	}
 
-		// CoD2x: Send status to multiple master servers
-		for (i = 0 ; i < MAX_MASTER_SERVERS; i++)
+	// CoD2x: Send heartbeats and status to multiple master servers
+	// If the address is being resolved in background, its sent in next frames when the address is resolved
+	for (i = 0 ; i < MAX_MASTER_SERVERS && (masterHeartbeatPending | masterStatusPending); i++)
+	{
+		int bit = 1 << i;
+		if (!((masterHeartbeatPending | masterStatusPending) & bit))
+			continue;
+
+		if (sv_master[i]->value.string[0] == '\0')
 		{
-			if (sv_master[i]->value.string[0] == '\0')
-				continue;
+			masterHeartbeatPending &= ~bit;
+			masterStatusPending &= ~bit;
+			continue;
+		}
+
+		resolverStatus_e status;
+		SV_MasterAddress(i, &status); // Resolve the master server address in cause its not resolved yet or sv_master was modified
 
-			SV_MasterAddress(i); // Resolve the master server address in cause its not resolved yet or sv_master was modified
+		if (status == RESOLVER_PENDING)
+			continue;
 
-			if (masterServerAddr[i].type != NA_BAD)
+		if (masterServerAddr[i].type != NA_BAD)
+		{
+			if (masterHeartbeatPending & bit)
+			{
+				Com_DPrintf( "Sending heartbeat to %s\n", sv_master[i]->value.string );
+				NET_OutOfBandPrint( NS_SERVER, masterServerAddr[i], va("heartbeat %s\n", hbname));
+			}
+			if (masterStatusPending & bit)
 			{
 				SVC_Status(masterServerAddr[i]);
 			}
 		}
-		// CoD2x: End
+
+		masterHeartbeatPending &= ~bit;
+		masterStatusPending &= ~bit;
 	}
+	// CoD2x: End
 
 	// CoD2x: Ask for IP and port of this server
 	if (svs_time >= nextIPTime && nextIPTime > 0) 
@@ -568,12 +653,16 @@ void SV_MasterHeartbeat( const char *hbname )
 		//nextIPTime = svs_time + 2000; // Try again after 2 seconds, unless response is received
 		nextIPTime = 0;
 
-		server_cmd_getIp();
+		// CoD2x: Try again when the address of master server is resolved
+		if (!server_sendGetIp())
+			nextIPTime = svs_time + 500;
 	}
 	// CoD2x: End
 }
 
 
+// CoD2x: Response handling is separated from SV_AuthorizeIpPacket so the cached response can be applied in SV_GetChallenge
+void SV_AuthorizeResponse( int i, const char *response, const char *info );
 
 /**
  * Process the response from authorization server.
@@ -591,7 +680,6 @@ void SV_AuthorizeIpPacket( netaddr_s from )
 	const char    *info;
 	//const char    *guid;
 	//const char    *PBguid;
-	char ret[1024];
 
 	if (NET_CompareBaseAdrSigned(&from, &svs_authorizeAddress ) != 0)
 	{
@@ -602,12 +690,9 @@ void SV_AuthorizeIpPacket( netaddr_s from )
 	challenge = atoi(Cmd_Argv(1));
 
 	// Find the challenge
-	for (i = 0; i < MAX_CHALLENGES; i++)
-	{
-		if (svs_challenges[i].challenge == challenge )
-			break;
-	}
-	if (i == MAX_CHALLENGES )
+	// CoD2x: Challenge is found by index instead of loop over all challenges
+	i = challenge_findByNumber(challenge);
+	if (i == -1)
 	{
 		Com_Printf( "SV_AuthorizeIpPacket: challenge not found\n" );
 		return;
@@ -621,6 +706,16 @@ void SV_AuthorizeIpPacket( netaddr_s from )
 	//guid = Cmd_Argv( 4 ); // 32bit number
 	//PBguid = Cmd_Argv( 5 ); // MD5 hash
 
+	// CoD2x: Response is reused when the same client asks for challenge again, e.g. on reconnect
+	authorize_cache_store(svs_challenges[i].adr, svs_challenges[i].clientPBguid, response, info);
+
+	SV_AuthorizeResponse(i, response, info);
+}
+
+void SV_AuthorizeResponse( int i, const char *response, const char *info )
+{
+	char ret[1024];
+
 	// Save PBguid
 	#if 0
 	strncpy(svs_challenges[i].PBguid, PBguid, 32);
@@ -643,7 +738,7 @@ void SV_AuthorizeIpPacket( netaddr_s from )
 		/*if (Q_stricmp( response, "deny" ) == 0 && info && info[0] && (Q_stricmp(info, "CLIENT_UNKNOWN_TO_AUTH") == 0 || Q_stricmp(info, "BAD_CDKEY") == 0))
 		{
 			NET_OutOfBandPrint(NS_SERVER, svs_challenges[i].adr, "needcdkey"); // Awaiting key code authorization warning
-			memset( &svs_challenges[i], 0, sizeof( svs_challenges[i]));
+			challenge_clear(i);
 			return;
 		}*/
 
@@ -657,7 +752,7 @@ void SV_AuthorizeIpPacket( netaddr_s from )
 	{
 		// they are a demo client trying to connect to a real server
 		NET_OutOfBandPrint( NS_SERVER, svs_challenges[i].adr, "error\nEXE_ERR_NOT_A_DEMO_SERVER" );
-		memset( &svs_challenges[i], 0, sizeof( svs_challenges[i]));
+		challenge_clear(i);
 		return;
 	}
 
@@ -671,7 +766,7 @@ void SV_AuthorizeIpPacket( netaddr_s from )
 		{
 			Com_Printf("rejected connection from permanently banned GUID %i\n", svs_challenges[i].guid);
 			NET_OutOfBandPrint( NS_SERVER, svs_challenges[i].adr, "error\n\x15You are permanently banned from this server" );
-			memset( &svs_challenges[i], 0, sizeof( svs_challenges[i]));
+			challenge_clear(i);
 			return;
 		}
 
@@ -679,7 +774,7 @@ void SV_AuthorizeIpPacket( netaddr_s from )
 		{
 			Com_Printf("rejected connection from temporarily banned GUID %i\n", svs_challenges[i].guid);
 			NET_OutOfBandPrint( NS_SERVER, svs_challenges[i].adr, "error\n\x15You are temporarily banned from this server" );
-			memset( &svs_challenges[i], 0, sizeof( svs_challenges[i]));
+			challenge_clear(i);
 			return;
 		}
 		#endif
@@ -710,7 +805,7 @@ void SV_AuthorizeIpPacket( netaddr_s from )
 		else if (Q_stricmp(info, "BANNED_CDKEY") == 0)
 			NET_OutOfBandPrint(NS_SERVER, svs_challenges[i].adr, "error\nEXE_ERR_BAD_CDKEY");
 		
-		memset( &svs_challenges[i], 0, sizeof( svs_challenges[i]));
+		challenge_clear(i);
 		return;
 	}
 
@@ -724,7 +819,7 @@ void SV_AuthorizeIpPacket( netaddr_s from )
 		NET_OutOfBandPrint(NS_SERVER, svs_challenges[i].adr, ret);
 	}
 
-	memset( &svs_challenges[i], 0, sizeof( svs_challenges[i]));
+	challenge_clear(i);
 	return;
 }
 
@@ -743,40 +838,48 @@ void SV_AuthorizeRequest(netaddr_s from, int challenge, const char* PBHASH) {
 void SV_GetChallenge( netaddr_s from )
 {
 	int i;
-	int oldest;
-	int oldestTime;
 	challenge_t *challenge;
 
-	oldest = 0;
-	oldestTime = 0x7fffffff;
+	#if COD2X_LINUX
+	// CoD2x: Server runs at full frame rate while the client is connecting
+	hibernate_wake("getchallenge");
+	// CoD2x: End
+	#endif
 
 	// see if we already have a challenge for this ip
-	challenge = &svs_challenges[0];
-	for ( i = 0 ; i < MAX_CHALLENGES ; i++, challenge++ )
-	{
-		if ( !challenge->connected && NET_CompareAdr( from, challenge->adr ) )
-		{
-			break;
-		}
-		if ( challenge->time < oldestTime )
-		{
-			oldestTime = challenge->time;
-			oldest = i;
-		}
-	}
+	// CoD2x: Challenge is found by index and the oldest one is taken from time ordered list instead of loop over all challenges
+	i = challenge_findByAddress(from);
 
-	if ( i == MAX_CHALLENGES )
+	if ( i == -1 )
 	{
 		// this is the first time this client has asked for a challenge
-		challenge = &svs_challenges[oldest];
+		i = challenge_allocate();
+		challenge = &svs_challenges[i];
 
-		challenge->challenge = ( ( rand() << 16 ) ^ rand() ) ^ svs_time;
+		// CoD2x: Stateless challenge is derived from the address, so it can be verified in SV_DirectConnect without this entry
+		if (challenge_isStateless())
+			challenge->challenge = challenge_generate(from);
+		else
+			challenge->challenge = ( ( rand() << 16 ) ^ rand() ) ^ svs_time;
+		// CoD2x: End
 		challenge->adr = from;
 		challenge->firstTime = svs_time;
 		challenge->firstPing = 0;
 		challenge->time = svs_time;
 		challenge->connected = 0;
-		i = oldest;
+		challenge_update(i);
+	}
+	else
+	{
+		challenge = &svs_challenges[i];
+
+		// CoD2x: Existing challenge might be expired or created before stateless challenges were enabled
+		if (challenge_isStateless() && !challenge_verify(from, challenge->challenge))
+		{
+			challenge->challenge = challenge_generate(from);
+			challenge_update(i);
+		}
+		// CoD2x: End
 	}
 
 	// Save CDKEY hash from client
@@ -795,21 +898,24 @@ void SV_GetChallenge( netaddr_s from )
 		return;
 	}
 
+	// CoD2x: Same client was authorized recently, the response is applied without the round-trip to the authorize server
+	const char *response, *info;
+	if ( PBHASH != NULL && authorize_cache_find(from, challenge->clientPBguid, &response, &info) )
+	{
+		challenge->pingTime = svs_time;
+		SV_AuthorizeResponse(i, response, info);
+		return;
+	}
+	// CoD2x: End
+
 	// look up the authorize server's IP
-	if ( !svs_authorizeAddress.ip[0] && svs_authorizeAddress.type != NA_BAD )
+	// CoD2x: Address is resolved in background, until its resolved the client is allowed to join after the timeout below
+	netaddr_s authorizeAddress;
+	if ( resolver_lookup( SERVER_ACTIVISION_AUTHORIZE_URI, SERVER_ACTIVISION_AUTHORIZE_PORT, &authorizeAddress ) == RESOLVER_OK )
 	{
-		Com_Printf( "Resolving authorization server %s\n", SERVER_ACTIVISION_AUTHORIZE_URI );
-		if ( !NET_StringToAdr( SERVER_ACTIVISION_AUTHORIZE_URI, &svs_authorizeAddress ) )
-		{
-			Com_Printf( "Couldn't resolve address\n" );
-			return;
-		}
-		svs_authorizeAddress.port = BigShort( SERVER_ACTIVISION_AUTHORIZE_PORT );
-		Com_Printf( "%s resolved to %i.%i.%i.%i:%i\n", SERVER_ACTIVISION_AUTHORIZE_URI,
-		            svs_authorizeAddress.ip[0], svs_authorizeAddress.ip[1],
-		            svs_authorizeAddress.ip[2], svs_authorizeAddress.ip[3],
-		            BigShort( svs_authorizeAddress.port ) );
+		svs_authorizeAddress = authorizeAddress;
 	}
+	// CoD2x: End
 
 	// CoD2x: 
 	// Originally the players were allowed to join after 7 seconds if the master server was not asking for 20mins
@@ -829,7 +935,8 @@ void SV_GetChallenge( netaddr_s from )
 	}
 
 	// otherwise send their ip to the authorize server
-	SV_AuthorizeRequest(from, challenge->challenge, PBHASH);
+	if ( svs_authorizeAddress.type == NA_IP )
+		SV_AuthorizeRequest(from, challenge->challenge, PBHASH);
 }
 
 
@@ -855,6 +962,11 @@ void SV_ConnectionlessPacket( netaddr_s from, msg_t *msg )
 	char* s;
 	const char* c;
 
+	// CoD2x: Capture raw packet into pcap file
+	if (capture_active)
+		capture_packet(false, from, msg->data, msg->cursize);
+	// CoD2x: End
+
 	MSG_BeginReading(msg);
 	MSG_ReadLong(msg); // skip the -1 marker
 	SV_Netchan_AddOOBProfilePacket(msg->cursize);
@@ -880,84 +992,65 @@ void SV_ConnectionlessPacket( netaddr_s from, msg_t *msg )
 
 
 	// CoD2x: Rate limiting function
-	auto isRateLimitOk = [](leakyBucket_t* bucket, netaddr_s from, const char* action, int addrBurst, int addrPeriod, int overallBurst, int overallPeriod) -> bool 
+	auto isRateLimitOk = [](netaddr_s from, const char* action, const char* command) -> bool 
 	{
 		if (sv_rateLimiter->value.boolean == false) {
 			return true;
 		}
-		if (SVC_RateLimitAddress(from, addrBurst, addrPeriod)) {
-			Com_DPrintf("%s: rate limit from %s exceeded, dropping request\n", action, NET_AdrToString(from));
-			return false;
+		svcRateLimit_e result = SVC_RATELIMIT_NONE;
+		bool filtered = false;
+		#if COD2X_LINUX
+		// Packets received by the ingress thread were already checked by the rate limiter in that thread
+		filtered = (from.type == NA_IP && ingress_isPacketFromThread() && ingress_isPacketFiltered());
+		#endif
+		if (!filtered) {
+			result = SVC_RateLimitCommand(from, command);
 		}
-		extern leakyBucket_t outboundLeakyBucket;
-		if (SVC_RateLimit(&outboundLeakyBucket, overallBurst, overallPeriod)) {
-			Com_DPrintf("%s: overall rate limit exceeded, dropping request\n", action);
-			return false;
+		if (result == SVC_RATELIMIT_OK || result == SVC_RATELIMIT_NONE) {
+			result = SVC_RateLimitOutbound(from, command);
+		}
+		switch (result) {
+			case SVC_RATELIMIT_ADDRESS:
+				Com_DPrintf("%s: rate limit from %s exceeded, dropping request\n", action, NET_AdrToString(from));
+				return false;
+			case SVC_RATELIMIT_PREFIX:
+				Com_DPrintf("%s: rate limit from %i.%i.%i.0/24 exceeded, dropping request\n", action, from.ip[0], from.ip[1], from.ip[2]);
+				return false;
+			case SVC_RATELIMIT_OVERALL:
+				Com_DPrintf("%s: overall rate limit exceeded, dropping request\n", action);
+				return false;
+			case SVC_RATELIMIT_OUTBOUND:
+				Com_DPrintf("%s: outbound byte budget of %s exceeded, dropping request\n", action, NET_AdrToString(from));
+				return false;
+			default:
+				return true;
 		}
-		return true;
 	};
 	// CoD2x: End
 
 
-	if (Q_stricmp( c, "v") == 0)
-	{
-		SV_VoicePacket( from, msg );
-	}
-	else if (Q_stricmp( c,"getstatus") == 0)
-	{
-		if (isRateLimitOk(&outboundLeakyBucket, from, "SV_Status", 10, 1000, 10, 100))
-			SVC_Status( from  );
-	}
-	else if (Q_stricmp( c,"getinfo") == 0)
-	{
-		if (isRateLimitOk(&outboundLeakyBucket, from, "SV_Info", 10, 1000, 10, 100))
-			SVC_Info( from );
-	}
-	else if (Q_stricmp( c,"getchallenge") == 0)
-	{
-		if (isRateLimitOk(&outboundLeakyBucket, from, "SV_GetChallenge", 10, 1000, 10, 100))
-			SV_GetChallenge( from );
-	}
-	else if (Q_stricmp( c,"connect") == 0)
-	{
-		SV_DirectConnect( from );
-	}
-	else if (Q_stricmp( c,"ipAuthorize") == 0)
-	{
-		SV_AuthorizeIpPacket( from );
-	}
-	else if (Q_stricmp( c, "rcon") == 0)
-	{
-		if (isRateLimitOk(&outboundLeakyBucket, from, "SVC_RemoteCommand", 10, 1000, 10, 1000))
-			SVC_RemoteCommand( from );
-	}
-	// CoD2x: Auto-Updater
-    else if (Q_stricmp(c, "updateResponse") == 0)
-    {
-		#if COD2X_WIN32
-		updater_updatePacketResponse(from);
-		#endif
-		#if COD2X_LINUX
-		updater_updatePacketResponse(from);
-		#endif
-    }
-	// CoD2x: Master server getIp
-	else if (Q_stricmp(c, "getIpResponse") == 0)
-	{
-		nextIPTime = 0; // Stop asking for IP
-		if (server_isAddressMasterServer(from) && Cmd_Argc() == 2)
-		{
-			const char* ip = Cmd_Argv(1);
-			Com_Printf("Server IP: %s\n", ip);
-		}
-	}
+	// CoD2x: Commands are dispatched by table of registered commands
+	svcCommand_t* command = SVC_FindCommand(c);
+	if (command == NULL)
+		return;
+
+	if (command->rateLimit != NULL && !isRateLimitOk(from, command->action, c))
+		return;
+
+	uint64_t start = ticks_us();
+	svcOutboundTracking = (command->rateLimit != NULL);
+	svcOutboundAddress = from;
+	svcOutboundBytes = 0;
+
+	command->handler(from, msg);
+
+	svcOutboundTracking = false;
+	if (command->rateLimit != NULL && sv_rateLimiter->value.boolean)
+		SVC_ChargeOutbound(from, svcOutboundBytes);
+
+	command->command->handleTime += ticks_us() - start;
+	command->command->accepted++;
 	// CoD2x: End
-	else if (Q_stricmp( c,"disconnect") == 0)
-	{
-		// if a client starts up a local server, we may see some spurious
-		// server disconnect messages when their new server sees our final
-		// sequenced messages to the old client
-	}
 }
 
 
@@ -978,6 +1071,25 @@ void NET_SendLoopPacket(netsrc_e mode, int length, const void *data, netaddr_s t
 
 
 int NET_SendPacket(netsrc_e sock, int length, const void *data, netaddr_s addr_to ) { 
+	// CoD2x: Response of getstatus / getinfo is stored into cache instead of being sent
+	if (query_cache_capture(length, data))
+		return 1;
+	// CoD2x: End
+
+	// CoD2x: Capture raw packet into pcap file
+	if (capture_active)
+		capture_packet(true, addr_to, data, length);
+	// CoD2x: End
+
+	// CoD2x: Count bytes sent to clients
+	netstats_packet(sock, length, data, addr_to);
+	// CoD2x: End
+
+	// CoD2x: Count bytes sent as reply to the connection-less request
+	if (svcOutboundTracking && addr_to.type == NA_IP && memcmp(addr_to.ip, svcOutboundAddress.ip, 4) == 0)
+		svcOutboundBytes += length;
+	// CoD2x: End
+
 	if (showpackets->value.boolean && *(int *)data == -1)
 	{
 		Com_Printf("[client %i] send packet %4i\n", 0, length);
@@ -1003,6 +1115,13 @@ int NET_SendPacket(netsrc_e sock, int length, const void *data, netaddr_s addr_t
 	if (addr_to.type == NA_INIT || addr_to.type == NA_BAD)
 		return 0;
 
+	#if COD2X_LINUX
+	// CoD2x: Packets sent during server frame are queued and sent together at the end of the frame
+	if (egress_queuePacket(length, data, addr_to))
+		return 1;
+	// CoD2x: End
+	#endif
+
 	return Sys_SendPacket( length, data, addr_to );
 }
 
@@ -1018,10 +1137,33 @@ int NET_SendPacket_Linux(netsrc_e mode, uint32_t length, int32_t* data, netaddr_
 }
 
 
+// Process the packet of connected client, returns true if the message is complete and should be executed
+int Netchan_Process(netchan_t* chan, msg_t* msg) {
+	int result;
+	ASM_CALL(RETURN(result), ADDR(0x004481b0, 0x0806be8a), WL(1, 2), WL(EAX, PUSH)(chan), PUSH(msg));
+
+	// CoD2x: Count packets lost by client, netchan.dropped is overwritten by the next packet
+	if (result)
+		netstats_received((int)(((char*)chan - (char*)&svs_clients[0].netchan) / sizeof(client_t)), chan->dropped);
+	// CoD2x: End
+
+	return result;
+}
+
+int Netchan_Process_Win32(msg_t* msg) {
+	netchan_t* chan;
+	ASM( movr, chan, "eax" );
+	return Netchan_Process(chan, msg);
+}
+
+
 // Function called when a client fully connects to the server, original function calls "begin" to gsc script
 // Its called on client connection and on map_restart (even on soft restart on next round)
 void SV_ClientBegin(int clientNum) {
-    
+
+    // Client might be missing in the list after the map change
+    player_index_add(clientNum);
+
     // Set client cvar g_cod2x
     // This will ensure that the same client side bug fixes are applied
     SV_SetClientCvar(clientNum, "g_cod2x", TOSTRING(APP_VERSION_PROTOCOL));
@@ -1145,6 +1287,9 @@ void SV_SpawnServer(char* mapname) {
     // Call the original function
     ((void (*)(char* mapname))ADDR(0x00458a40, 0x08093520))(mapname);
 
+	// Map and referenced iwds are changed
+	query_cache_invalidate();
+
 	nextIPTime = svs_time + 4000; // Ask for IP and port of this server in 4 seconds
 }
 
@@ -1158,8 +1303,19 @@ void SV_Shutdown(const char* error) {
 		server_beforeMapChangeOrRestart(true, SV_MAP_CHANGE_SOURCE_MAP_SHUTDOWN);
 	}
 
+	#if COD2X_LINUX
+	// Send packets queued in the last server frame before the clients are dropped
+	egress_flush();
+	#endif
+
 	// Call the original function
 	ASM_CALL(RETURN_VOID, ADDR(0x0045a130, 0x080942f8), 1, PUSH(error));
+
+	// Challenges might be cleared by the original function
+	challenge_rebuild();
+
+	// Packets captured until now are written and the file is closed
+	capture_unload();
 }
 
 
@@ -1170,13 +1326,18 @@ void G_RunFrame(int time) {
 
 	server_ignoreMapChangeThisFrame = false;
 
+	// CoD2x: Only connected clients are iterated instead of all entities
+	player_index_update();
+
+	playerBroadcast_e broadcast = PLAYER_BROADCAST_NONE;
+
 	if (sv_playerBroadcastLimit->value.integer > 0) {
 
 		// Count number of players
 		int numPlayers = 0;
-		for (int i = 0; i < MAX_GENTITIES; i++)
+		for (int i = 0; i < player_index_count; i++)
 		{
-			gentity_t* ent = &g_entities[i];
+			gentity_t* ent = &g_entities[player_index_clients[i]];
 			if (ent->client && ent->r.inuse && ent->s.eType == ET_PLAYER)
 			{
 				numPlayers++;
@@ -1191,16 +1352,19 @@ void G_RunFrame(int time) {
 			// The game by default sends only "visible" (related to portaling / PVS) entities to the clients.
 			// It make sense to not send data about players if the player is not visible, but that is causing issues with sounds - player's sounds (shooting, footsteps, etc.) are not heard by other players if they are not visible.
 			// The game internally uses broadcastTime to determine if the entity should be sent to the client, we will use it to force sending all players to all clients.
-			for (int i = 0; i < MAX_GENTITIES; i++)
+			for (int i = 0; i < player_index_count; i++)
 			{
-				gentity_t* ent = &g_entities[i];
+				gentity_t* ent = &g_entities[player_index_clients[i]];
 				if (ent->client && ent->r.inuse && ent->s.eType == ET_PLAYER && ent->health > 0)
 				{
 					ent->r.broadcastTime = svs_time + 1; // if we keep broadcastTime bigger then svs.time, the client will be sent to all other clients
 				}
 			}
+			broadcast = PLAYER_BROADCAST_ALL;
 		}
 	}
+
+	player_interest_frame(broadcast);
 }
 
 void G_RunFrame_Win32() {
@@ -1212,6 +1376,26 @@ void G_RunFrame_Win32() {
 
 
 
+/** Called every frame on frame start. */
+void server_frame()
+{
+	if (sv_rl_outbound->modified)
+	{
+		sv_rl_outbound->modified = false;
+		SVC_UpdateOutboundPolicy();
+	}
+
+	for (int i = 0; i < connless_commandCount(); i++)
+	{
+		svcCommand_t* command = &svcCommands[i];
+		if (command->rateLimit != NULL && command->rateLimit->modified)
+		{
+			command->rateLimit->modified = false;
+			SVC_UpdateRateLimitPolicy(command);
+		}
+	}
+}
+
 // Called after all is initialized on game start
 void server_init()
 {
@@ -1242,6 +1426,41 @@ void server_init()
 
 	// CoD2x: Command to get IP and port of this server
 	Cmd_AddCommand("getIp", server_cmd_getIp); 
+
+	// Connection-less commands, the rate limit is "<addrBurst> <addrPeriod> <prefixBurst> <prefixPeriod> <overallBurst> <overallPeriod>"
+	// The overall bucket is shared by all rate limited commands, the policy of the command only sets how fast it can use it
+	SVC_RegisterCommand("v", 				"SV_VoicePacket", 		SV_VoicePacket);
+	SVC_RegisterCommand("getstatus", 		"SV_Status", 			[](netaddr_s from, msg_t*) { query_cache_sendStatus(from); }, 	"10 1000 20 250 10 100");
+	SVC_RegisterCommand("getinfo", 			"SV_Info", 				[](netaddr_s from, msg_t*) { query_cache_sendInfo(from); }, 	"10 1000 20 250 10 100");
+	SVC_RegisterCommand("getchallenge", 	"SV_GetChallenge", 		[](netaddr_s from, msg_t*) { SV_GetChallenge(from); }, 		"10 1000 20 250 10 100");
+	SVC_RegisterCommand("connect", 			"SV_DirectConnect", 	[](netaddr_s from, msg_t*) { SV_DirectConnect(from); });
+	SVC_RegisterCommand("ipAuthorize", 		"SV_AuthorizeIpPacket", [](netaddr_s from, msg_t*) { SV_AuthorizeIpPacket(from); });
+	SVC_RegisterCommand("rcon", 			"SVC_RemoteCommand", 	[](netaddr_s from, msg_t*) { SVC_RemoteCommand(from); }, 	"10 1000 20 1000 10 1000");
+	// CoD2x: Auto-Updater
+	SVC_RegisterCommand("updateResponse", 	"updateResponse", 		[](netaddr_s from, msg_t*) { updater_updatePacketResponse(from); });
+	// CoD2x: Master server getIp
+	SVC_RegisterCommand("getIpResponse", 	"getIpResponse", 		[](netaddr_s from, msg_t*) {
+		nextIPTime = 0; // Stop asking for IP
+		if (server_isAddressMasterServer(from) && Cmd_Argc() == 2)
+		{
+			const char* ip = Cmd_Argv(1);
+			Com_Printf("Server IP: %s\n", ip);
+		}
+	});
+	// if a client starts up a local server, we may see some spurious
+	// server disconnect messages when their new server sees our final
+	// sequenced messages to the old client
+	SVC_RegisterCommand("disconnect", 		"disconnect", 			[](netaddr_s, msg_t*) { });
+
+	svcCommandStatsTime = ticks_ms();
+	Cmd_AddCommand("netstats", SVC_NetStats_f);
+
+	// Maximum bytes sent as replies to connection-less requests from single address in period, "<bytes> <period ms>"
+	sv_rl_outbound = Dvar_RegisterString("sv_rl_outbound", "32768 10000", (dvarFlags_e)(DVAR_CHANGEABLE_RESET));
+	sv_rl_outbound->modified = false;
+	SVC_UpdateOutboundPolicy();
+
+	Cmd_AddCommand("rateLimitStats", SVC_RateLimitStats_f);
 }
 
 
@@ -1288,6 +1507,9 @@ void server_patch()
     patch_call(ADDR(0x00454d12, 0x0808f6ee), (unsigned int)ADDR(SV_ClientBegin_Win32, SV_ClientBegin_Linux));
 
 
+	// Hook the Netchan_Process function
+	patch_call(ADDR(0x0045bd39, 0x08096236), (unsigned int)WL(Netchan_Process_Win32, Netchan_Process)); // SV_PacketEvent
+
 	// Hook the G_RunFrame function
     patch_call(ADDR(0x0045c1ff, 0x08096765), (unsigned int)ADDR(G_RunFrame_Win32, G_RunFrame)); // SV_RunFrame
     #if COD2X_WIN32
@@ -300,6 +300,23 @@ uint64_t ticks_ms(void) {
 #endif
 }
 
+/**
+ * Get a monotonic tick counter in microseconds.
+ * Same as ticks_ms, but with higher resolution for measuring short durations.
+ */
+uint64_t ticks_us(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((counter.QuadPart / freq.QuadPart) * 1000000ULL + (counter.QuadPart % freq.QuadPart) * 1000000ULL / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+#endif
+}
+
 
 /**
  * Convert a UTC timestamp (milliseconds since Unix epoch) into ISO8601 string.
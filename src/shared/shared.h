@@ -88,6 +88,7 @@ int base64_encode(const uint8_t* input, size_t len, char* output, size_t out_siz
 int base64_decode(const char* input, uint8_t* output, size_t out_size);
 uint64_t time_utc_ms(void);
 uint64_t ticks_ms(void);
+uint64_t ticks_us(void);
 char* time_to_iso8601(uint64_t ms_epoch, char* buf, size_t buf_size);
 #endif
 
@@ -0,0 +1,96 @@
+#include "userinfo.h"
+#include "shared.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "cod2_server.h"
+
+static userinfo_t userinfo_clients[MAX_CLIENTS];
+static bool userinfo_valid[MAX_CLIENTS];
+
+
+// Case insensitive compare as Q_stricmp used by Info_ValueForKey
+static bool userinfo_keyEquals(const char* a, const char* b) {
+    for (; *a && *b; a++, b++) {
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+            return false;
+    }
+    return *a == *b;
+}
+
+
+/**
+ * Split the userinfo string into keys and values.
+ * The result is the same as Info_ValueForKey called for each key, first occurrence of the key wins.
+ */
+void userinfo_parse(userinfo_t* info, const char* s) {
+    info->keyCount = 0;
+
+    size_t len = strnlen(s, USERINFO_LENGTH - 1);
+    memcpy(info->buffer, s, len);
+    info->buffer[len] = '\0';
+
+    char* p = info->buffer;
+    if (*p == '\\')
+        p++;
+
+    while (*p && info->keyCount < USERINFO_MAX_KEYS) {
+        char* key = p;
+        while (*p && *p != '\\')
+            p++;
+        if (!*p)
+            break; // key without value
+        *p++ = '\0';
+
+        while (*p && *p != '\\')
+            p++;
+        if (*p)
+            *p++ = '\0';
+
+        info->keys[info->keyCount++] = (uint16_t)(key - info->buffer);
+    }
+
+    info->name = userinfo_valueForKey(info, "name");
+    info->hwid2 = userinfo_valueForKey(info, "cl_hwid2");
+    info->matchLogin = userinfo_valueForKey(info, "match_login");
+
+    const char* rate = userinfo_valueForKey(info, "rate");
+    info->hasRate = rate[0] != '\0';
+    info->rate = atoi(rate);
+
+    const char* snaps = userinfo_valueForKey(info, "snaps");
+    info->hasSnaps = snaps[0] != '\0';
+    info->snaps = atoi(snaps);
+
+    info->protocol = atoi(userinfo_valueForKey(info, "protocol"));
+    info->protocolCod2x = atoi(userinfo_valueForKey(info, "protocol_cod2x"));
+    info->challenge = atoi(userinfo_valueForKey(info, "challenge"));
+    info->voice = atoi(userinfo_valueForKey(info, "cl_voice"));
+    info->wwwDownload = atoi(userinfo_valueForKey(info, "cl_wwwDownload"));
+}
+
+/** Get the value of key, empty string if the key is missing. */
+const char* userinfo_valueForKey(const userinfo_t* info, const char* key) {
+    for (int i = 0; i < info->keyCount; i++) {
+        const char* k = info->buffer + info->keys[i];
+        if (userinfo_keyEquals(k, key))
+            return k + strlen(k) + 1;
+    }
+    return "";
+}
+
+/** Parse the userinfo of client again, called when the userinfo is changed. */
+userinfo_t* userinfo_update(int clientNum) {
+    userinfo_parse(&userinfo_clients[clientNum], svs_clients[clientNum].userinfo);
+    userinfo_valid[clientNum] = true;
+    return &userinfo_clients[clientNum];
+}
+
+/** Get the parsed userinfo of client, it is parsed if it was not parsed yet. */
+userinfo_t* userinfo_get(int clientNum) {
+    if (!userinfo_valid[clientNum])
+        return userinfo_update(clientNum);
+    return &userinfo_clients[clientNum];
+}
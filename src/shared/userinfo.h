@@ -0,0 +1,38 @@
+#ifndef USERINFO_H
+#define USERINFO_H
+
+#include <stdint.h>
+
+#define USERINFO_LENGTH     1024    // size of client_t::userinfo
+#define USERINFO_MAX_KEYS   128
+
+// Userinfo string "\key\value\key\value" parsed in one pass
+// Values point into the buffer, so the structure must not be copied
+typedef struct {
+    char buffer[USERINFO_LENGTH];       // keys and values terminated by '\0'
+    uint16_t keys[USERINFO_MAX_KEYS];   // offset of key in buffer, its value follows after the '\0'
+    int keyCount;
+
+    // Frequently used values, empty string if the key is missing
+    const char* name;
+    const char* hwid2;
+    const char* matchLogin;
+
+    // Pre-converted integers, 0 if the key is missing
+    bool hasRate;
+    int rate;
+    bool hasSnaps;
+    int snaps;
+    int protocol;
+    int protocolCod2x;
+    int challenge;
+    int voice;
+    int wwwDownload;
+} userinfo_t;
+
+void userinfo_parse(userinfo_t* info, const char* s);
+const char* userinfo_valueForKey(const userinfo_t* info, const char* key);
+userinfo_t* userinfo_update(int clientNum);
+userinfo_t* userinfo_get(int clientNum);
+
+#endif
@@ -2,14 +2,17 @@
 #include <functional>
 #include <string>
 #include <cstdint>
+#include <atomic>
 #include "mongoose/mongoose.h"
+#include "reactor.h"
 #undef poll
 
 
 // Wrapper around a Mongoose WebSocket CLIENT
 // - Replies to incoming PING with PONG
 // - Auto-reconnect on errors/remote close (unless manually closed)
-// - Poll-driven: call poll(ms) regularly
+// - Connection is handled by the shared NetReactor that is polled once per frame
+// - Callbacks are called on the main thread, also when the reactor runs on the I/O thread
 
 class WebSocketClient {
   public:
@@ -25,31 +28,98 @@ class WebSocketClient {
 	 * @param ping_interval_ms Interval in milliseconds between sending PING frames to keep the connection alive. Default is 15000 ms.
 	 * @param pong_timeout_ms Max time to wait for a PONG after sending our PING. 0 = auto (ping_interval_ms / 2; disabled if ping is 0).
 	 */
-    WebSocketClient(std::string headers = "", unsigned reconnect_delay_ms = 2000, unsigned ping_interval_ms = 15000, unsigned pong_timeout_ms = 0) {
+    WebSocketClient(std::string headers = "", unsigned reconnect_delay_ms = 2000, unsigned ping_interval_ms = 15000, unsigned pong_timeout_ms = 0) : m_reactor(NetReactor::instance()) {
         m_headers = std::move(headers);
         m_reconnect_ms = reconnect_delay_ms;
         m_ping_interval_ms = ping_interval_ms;
         // Auto-timeout: half of ping interval if provided, else disabled
         m_pong_timeout_ms = pong_timeout_ms ? pong_timeout_ms : (ping_interval_ms ? ping_interval_ms / 2 : 0);
 
-        mg_log_set(MG_LL_NONE);
-        mg_mgr_init(&m_mgr);
+        m_reactor.run([this]() {
+            m_reactor.add_timer(this, [this]() { update(); return false; });
+        });
     }
 
     ~WebSocketClient() {
-        close(); // Manual close disables auto-reconnect
-        mg_mgr_free(&m_mgr);
+        m_reactor.run_sync([this]() {
+            m_reactor.remove_timer(this);
+            if (m_connected && m_onClose)
+                emit([cb = m_onClose]() { cb(false, true); }); // isClosedByRemote, isFullyDisconnected
+            close_now(); // Manual close disables auto-reconnect
+            // Connection is closed by the shared manager after this client is destroyed
+            mg_connection* c = m_conn;
+            if (c)
+                c->fn_data = nullptr;
+            m_conn = nullptr;
+            m_connected = false;
+        });
+        m_reactor.drain();
     }
 
     // Start (or replace) connection to ws:// or wss:// URL
     bool connect(const std::string& url) {
+        if (m_reactor.is_threaded()) {
+            m_reactor.run([this, url]() { connect_now(url); });
+            return true;
+        }
+        return connect_now(url);
+    }
+
+    // Poll the shared reactor, used when the reactor is not polled by the frame, e.g. on shutdown.
+    // With the I/O thread only the callbacks are called, waiting at most ms for them.
+    void poll(int ms = 0) {
+        m_reactor.poll(ms);
+    }
+
+    // Send a TEXT message. Returns false if not currently connected.
+    bool sendText(const std::string& text) {
+        if (!m_conn || !m_connected)
+            return false;
+        m_reactor.run([this, text]() {
+            if (m_conn && m_connected)
+                mg_ws_send(m_conn, text.c_str(), text.size(), WEBSOCKET_OP_TEXT);
+        });
+        return true;
+    }
+
+    // Close connection
+    // Politely request close; Mongoose will progress shutdown on next poll
+    // Disables auto-reconnect until connect(url) is called again
+    void close() {
+        m_reactor.run([this]() { close_now(); });
+    }
+
+    // Callbacks
+    void onOpen(OnOpen cb) { m_onOpen = std::move(cb); }
+    void onMessage(OnMessage cb) { m_onMessage = std::move(cb); }
+    void onClose(OnClose cb) { m_onClose = std::move(cb); }
+    void onError(OnError cb) { m_onError = std::move(cb); }
+
+    // State
+    bool isConnected() const { return m_connected; }
+    bool isClosing() const { return m_closing; }
+    bool isClosed() const { return !m_conn && !m_connected && !m_closing; }
+    bool isDisconnected() const { return !m_conn && !m_connected && !m_closing && m_disconnect; }
+
+  private:
+    bool connect_now(const std::string& url) {
         m_url = url;
         m_disconnect = false;
         return try_connect_now();
     }
 
-    // Drive networking. Call this from your main loop.
-    void poll(int ms = 0) {
+    void close_now() {
+        m_disconnect = true;
+        mg_connection* c = m_conn;
+        if (c) {
+            mg_ws_send(c, "", 0, WEBSOCKET_OP_CLOSE);
+            c->is_closing = 1;
+            m_closing = true;
+        }
+    }
+
+    // Reconnect and keepalive timers, called by the reactor before every poll of the manager
+    void update() {
         const uint64_t now = mg_millis();
 
         // Auto-reconnect timer
@@ -76,46 +146,16 @@ class WebSocketClient {
             m_closing = true;
             m_waitingPong = false; // avoid repeated triggers before MG_EV_CLOSE
         }
-
-        mg_mgr_poll(&m_mgr, ms);
     }
 
-    // Send a TEXT message. Returns false if not currently connected.
-    bool sendText(const std::string& text) {
-        if (!m_conn || !m_connected)
-            return false;
-        mg_ws_send(m_conn, text.c_str(), text.size(), WEBSOCKET_OP_TEXT);
-        return true;
-    }
-
-    // Close connection
-    // Politely request close; Mongoose will progress shutdown on next poll
-    // Disables auto-reconnect until connect(url) is called again
-    void close() {
-        m_disconnect = true;
-        if (m_conn) {
-            mg_ws_send(m_conn, "", 0, WEBSOCKET_OP_CLOSE);
-            m_conn->is_closing = 1;
-            m_closing = true;
-        }
+    // Call the callback on the main thread, copies of the arguments are passed from the I/O thread
+    void emit(std::function<void()> callback) {
+        m_reactor.post(std::move(callback));
     }
 
-    // Callbacks
-    void onOpen(OnOpen cb) { m_onOpen = std::move(cb); }
-    void onMessage(OnMessage cb) { m_onMessage = std::move(cb); }
-    void onClose(OnClose cb) { m_onClose = std::move(cb); }
-    void onError(OnError cb) { m_onError = std::move(cb); }
-
-    // State
-    bool isConnected() const { return m_connected; }
-    bool isClosing() const { return m_closing; }
-    bool isClosed() const { return !m_conn && !m_connected && !m_closing; }
-    bool isDisconnected() const { return !m_conn && !m_connected && !m_closing && m_disconnect; }
-
-  private:
     // Try immediate connection. On failure, schedule a retry.
     bool try_connect_now() {
-        m_conn = mg_ws_connect(&m_mgr, m_url.c_str(), &WebSocketClient::s_ev, this, "%s", m_headers.c_str());
+        m_conn = mg_ws_connect(m_reactor.get_mgr(), m_url.c_str(), &WebSocketClient::s_ev, this, "%s", m_headers.c_str());
         m_nextReconnect = mg_millis() + m_reconnect_ms;
         if (!m_conn) {
             return false;
@@ -142,7 +182,7 @@ class WebSocketClient {
             if (m_ping_interval_ms > 0)
                 m_nextPing = mg_millis() + m_ping_interval_ms;
             if (m_onOpen)
-                m_onOpen();
+                emit(m_onOpen);
             break;
         }
 
@@ -151,7 +191,7 @@ class WebSocketClient {
             auto* wm = static_cast<mg_ws_message*>(ev_data);
             const uint8_t opcode = (uint8_t)(wm->flags & 0x0F);
             if (opcode == WEBSOCKET_OP_TEXT && m_onMessage) {
-                m_onMessage(std::string(wm->data.buf, wm->data.len));
+                emit([cb = m_onMessage, message = std::string(wm->data.buf, wm->data.len)]() { cb(message); });
             }
             break;
         }
@@ -184,7 +224,7 @@ class WebSocketClient {
             if (c == m_conn)
                 m_conn = nullptr;
             if (m_connected && m_onClose)
-                m_onClose(m_closing == false, m_disconnect); // isClosedByRemote, isFullyDisconnected
+                emit([cb = m_onClose, remote = m_closing == false, full = m_disconnect.load()]() { cb(remote, full); }); // isClosedByRemote, isFullyDisconnected
             m_connected = false;
             m_closing = false;
             m_waitingPong = false;
@@ -204,7 +244,7 @@ class WebSocketClient {
                 m_nextReconnect = mg_millis() + m_reconnect_ms;
             }
             if (m_onError)
-                m_onError(error_message);
+                emit([cb = m_onError, error = std::string(error_message)]() { cb(error); });
             break;
         }
 
@@ -213,12 +253,12 @@ class WebSocketClient {
         }
     }
 
-    // State
-    mg_mgr m_mgr{};
-    mg_connection* m_conn{nullptr};
-    bool m_connected{false};
-    bool m_disconnect{false};
-    bool m_closing{false};
+    // State, written by the I/O thread if the reactor is threaded
+    NetReactor& m_reactor;
+    std::atomic<mg_connection*> m_conn{nullptr};
+    std::atomic<bool> m_connected{false};
+    std::atomic<bool> m_disconnect{false};
+    std::atomic<bool> m_closing{false};
     std::string m_url;
 
     // Timers & config